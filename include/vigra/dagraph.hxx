@@ -9,6 +9,8 @@
 #include <unordered_map>
 #include <list>
 #include <stack>
+#include <algorithm>
+#include <type_traits>
 
 #include <vigra/graphs.hxx>  // for lemon::INVALID
 
@@ -608,6 +610,84 @@ namespace detail
         Arc arc_;
     };
 
+    /// \brief Functor for SubItemIt to iterate over all children of a node, using the contiguous child range of the graph.
+    template <typename GRAPH>
+    struct ChildRangeItFunctor
+    {
+    public:
+
+        typedef GRAPH Graph;
+        typedef typename Graph::Node Node;
+        typedef Node Item;  // needed to be used by SubItemIt
+        typedef Node IterItem;  // needed to be used by SubItemIt
+
+        ChildRangeItFunctor(Graph const * graph)
+            : graph_(graph)
+        {}
+
+        ChildRangeItFunctor(Graph const & graph)
+            : graph_(&graph)
+        {}
+
+        void first(Node const & sourcenode, Node & childnode)
+        {
+            it_ = graph_->children_begin(sourcenode);
+            end_ = graph_->children_end(sourcenode);
+            childnode = (it_ != end_) ? *it_ : Node(lemon::INVALID);
+        }
+
+        void next(Node & childnode)
+        {
+            ++it_;
+            childnode = (it_ != end_) ? *it_ : Node(lemon::INVALID);
+        }
+
+    protected:
+
+        Graph const * graph_;
+        Node const * it_;
+        Node const * end_;
+    };
+
+    /// \brief Functor for SubItemIt to iterate over all parents of a node, using the contiguous parent range of the graph.
+    template <typename GRAPH>
+    struct ParentRangeItFunctor
+    {
+    public:
+
+        typedef GRAPH Graph;
+        typedef typename Graph::Node Node;
+        typedef Node Item;  // needed to be used by SubItemIt
+        typedef Node IterItem;  // needed to be used by SubItemIt
+
+        ParentRangeItFunctor(Graph const * graph)
+            : graph_(graph)
+        {}
+
+        ParentRangeItFunctor(Graph const & graph)
+            : graph_(&graph)
+        {}
+
+        void first(Node const & sourcenode, Node & parentnode)
+        {
+            it_ = graph_->parents_begin(sourcenode);
+            end_ = graph_->parents_end(sourcenode);
+            parentnode = (it_ != end_) ? *it_ : Node(lemon::INVALID);
+        }
+
+        void next(Node & parentnode)
+        {
+            ++it_;
+            parentnode = (it_ != end_) ? *it_ : Node(lemon::INVALID);
+        }
+
+    protected:
+
+        Graph const * graph_;
+        Node const * it_;
+        Node const * end_;
+    };
+
     /// \brief Hash functor for unordered_set<Node>.
     template <typename T>
     struct IdHash
@@ -622,36 +702,183 @@ namespace detail
         std::hash<index_type> h_;
     };
 
+    /// \brief Set of graph items with O(1) insert, erase and lookup.
+    ///
+    /// The items are stored in a contiguous vector, so iterating is a linear scan.
+    /// A dense vector indexed by the item id holds the position of each item in the vector (-1 if the item is not in the set).
+    template <typename ITEM>
+    class IndexSet
+    {
+    public:
+
+        typedef ITEM value_type;
+        typedef typename std::vector<ITEM>::const_iterator const_iterator;
+
+        /// \brief Return true if the set contains the given item.
+        bool contains(ITEM const & item) const
+        {
+            return item.id() >= 0 && static_cast<size_t>(item.id()) < pos_.size() && pos_[item.id()] != -1;
+        }
+
+        /// \brief Insert the given item (nothing happens if it is already in the set).
+        void insert(ITEM const & item)
+        {
+            size_t const id = item.id();
+            if (id >= pos_.size())
+                pos_.resize(id+1, -1);
+            if (pos_[id] != -1)
+                return;
+            pos_[id] = items_.size();
+            items_.push_back(item);
+        }
+
+        /// \brief Remove the given item (nothing happens if it is not in the set). The last item takes its place.
+        void erase(ITEM const & item)
+        {
+            if (!contains(item))
+                return;
+            int const p = pos_[item.id()];
+            ITEM const last = items_.back();
+            items_[p] = last;
+            pos_[last.id()] = p;
+            items_.pop_back();
+            pos_[item.id()] = -1;
+        }
+
+        void clear()
+        {
+            items_.clear();
+            pos_.clear();
+        }
+
+        size_t size() const
+        {
+            return items_.size();
+        }
+
+        const_iterator begin() const
+        {
+            return items_.cbegin();
+        }
+
+        const_iterator end() const
+        {
+            return items_.cend();
+        }
+
+        const_iterator cbegin() const
+        {
+            return items_.cbegin();
+        }
+
+        const_iterator cend() const
+        {
+            return items_.cend();
+        }
+
+    protected:
+
+        std::vector<ITEM> items_;
+        std::vector<int> pos_;
+    };
+
     /// \brief Basic property map class.
-    template <typename INDEX_TYPE, typename VALUE_TYPE, typename MAP = std::map<INDEX_TYPE, VALUE_TYPE> >
+    template <typename KEYTYPE, typename VALUETYPE, typename MAP = std::map<KEYTYPE, VALUETYPE> >
     class PropertyMap
     {
     public:
-        typedef INDEX_TYPE index_type;
-        typedef VALUE_TYPE value_type;
+        typedef KEYTYPE key_type;
+        typedef KEYTYPE index_type;
+        typedef VALUETYPE value_type;
         typedef value_type & reference;
         typedef value_type const & const_reference;
         typedef MAP Map;
-        reference at(index_type const & x)
+        typedef typename Map::iterator iterator;
+        typedef typename Map::const_iterator const_iterator;
+        reference at(key_type const & k)
         {
-            return map_.at(x);
+            return map_.at(k);
         }
-        const_reference at(index_type const & x) const
+        const_reference at(key_type const & k) const
         {
-            return map_.at(x);
+            return map_.at(k);
         }
-        reference operator[](index_type const & x)
+        reference operator[](key_type const & k)
         {
-            return map_[x];
+            return map_[k];
         }
+        iterator begin()
+        {
+            return map_.begin();
+        }
+        const_iterator begin() const
+        {
+            return map_.begin();
+        }
+        iterator end()
+        {
+            return map_.end();
+        }
+        const_iterator end() const
+        {
+            return map_.end();
+        }
+        void clear()
+        {
+            map_.clear();
+        }
+        template <typename... ARGS>
+        std::pair<iterator, bool> emplace(ARGS &&... args)
+        {
+            return map_.emplace(std::forward<ARGS>(args)...);
+        }
+
     protected:
         Map map_;
     };
 
+    /// \brief Replace the items of the index set by the items with the new ids (see DAGraph0::compact()), keeping their order.
+    template <typename ITEM, typename INDEX>
+    void remap_index_set(IndexSet<ITEM> & set, std::vector<INDEX> const & new_ids)
+    {
+        IndexSet<ITEM> remapped;
+        for (auto const & item : set)
+        {
+            INDEX const id = new_ids[item.id()];
+            if (id != -1)
+                remapped.insert(ITEM(id));
+        }
+        set = std::move(remapped);
+    }
+
 } // namespace detail
 
 
 
+/// \brief Replace the keys of the node map by the new node ids that were returned by compact().
+///
+/// Entries of nodes that were erased from the graph are removed.
+template <typename MAP, typename INDEX>
+void remap_node_map(MAP & map, std::vector<INDEX> const & new_ids)
+{
+    typedef typename MAP::key_type Key;
+    MAP remapped;
+    for (auto & p : map)
+    {
+        auto const old_id = p.first.id();
+        if (old_id < 0 || static_cast<size_t>(old_id) >= new_ids.size() || new_ids[old_id] == -1)
+            continue;
+        remapped.emplace(Key(new_ids[old_id]), std::move(p.second));
+    }
+    map = std::move(remapped);
+}
+
+
+
+class StaticDAGraph0;
+
+
+
 /// \brief Class for arbitrary graphs. Api and implementation is taken from lemon::ListDigraph.
 class DAGraph0
 {
@@ -661,9 +888,11 @@ public:
     typedef Int64 index_type;
     typedef detail::GenericGraphItem<index_type, 0> Node;
     typedef detail::GenericGraphItem<index_type, 1> Arc;
+    typedef detail::IndexSet<Node> ContainerType;
+    typedef ContainerType::const_iterator const_iterator;
     typedef detail::ItemIt<DAGraph0, detail::NodeItFunctor<DAGraph0> > NodeIt;
-    typedef detail::ItemIt<DAGraph0, detail::RootNodeItFunctor<DAGraph0> > RootNodeIt;
-    typedef detail::ItemIt<DAGraph0, detail::LeafNodeItFunctor<DAGraph0> > LeafNodeIt;
+    typedef detail::ItemIt<DAGraph0, detail::RootNodeVectorItFunctor<DAGraph0> > RootNodeIt;
+    typedef detail::ItemIt<DAGraph0, detail::LeafNodeVectorItFunctor<DAGraph0> > LeafNodeIt;
     typedef detail::ItemIt<DAGraph0, detail::ArcItFunctor<DAGraph0> > ArcIt;
     typedef detail::SubItemIt<DAGraph0, detail::OutArcItFunctor<DAGraph0> > OutArcIt;
     typedef detail::SubItemIt<DAGraph0, detail::InArcItFunctor<DAGraph0> > InArcIt;
@@ -779,6 +1008,28 @@ public:
     /// \brief Return true if the given node is a leaf node.
     bool isLeafNode(Node const & node) const;
 
+    /// \brief Return an immutable snapshot of the graph that stores the arcs in contiguous arrays.
+    StaticDAGraph0 freeze() const;
+
+    /// \brief Renumber nodes and arcs, so the erased items leave no holes and the free lists are empty.
+    ///
+    /// The nodes are numbered breadth-first from the root nodes and the arcs are numbered by their (new) source node,
+    /// so the out arcs of a node are adjacent. The order of the in and out arcs of each node is kept.
+    /// \param arc_ids[out]: maps each old arc id to the new id (-1 for erased arcs)
+    /// \return vector that maps each old node id to the new id (-1 for erased nodes), see remap_node_map()
+    virtual std::vector<int> compact(std::vector<int> & arc_ids);
+
+    /// \brief Renumber nodes and arcs (see above) and return the node id mapping.
+    std::vector<int> compact();
+
+    const_iterator roots_cbegin() const;
+
+    const_iterator roots_cend() const;
+
+    const_iterator leaves_cbegin() const;
+
+    const_iterator leaves_cend() const;
+
 protected:
 
     struct NodeT
@@ -805,6 +1056,12 @@ protected:
     int first_free_node_;
     int first_free_arc_;
 
+    /// \brief The root nodes.
+    ContainerType roots_;
+
+    /// \brief The leaf nodes.
+    ContainerType leaves_;
+
 };
 
 inline DAGraph0::DAGraph0()
@@ -812,7 +1069,9 @@ inline DAGraph0::DAGraph0()
       arcs_(),
       first_node_(-1),
       first_free_node_(-1),
-      first_free_arc_(-1)
+      first_free_arc_(-1),
+      roots_(),
+      leaves_()
 {}
 
 inline int DAGraph0::maxNodeId() const
@@ -993,6 +1252,8 @@ inline auto DAGraph0::addNode() -> Node
     nodes_[n].first_in = -1;
     nodes_[n].first_out = -1;
 
+    roots_.insert(Node(n));
+    leaves_.insert(Node(n));
     return Node(n);
 }
 
@@ -1027,6 +1288,9 @@ inline auto DAGraph0::addArc(
 
     arcs_[a].prev_in = arcs_[a].prev_out = -1;
     nodes_[u.id()].first_out = nodes_[v.id()].first_in = a;
+
+    leaves_.erase(u);
+    roots_.erase(v);
     return Arc(a);
 }
 
@@ -1064,6 +1328,9 @@ inline void DAGraph0::erase(
     nodes_[n].next = first_free_node_;
     first_free_node_ = n;
     nodes_[n].prev = -2;
+
+    roots_.erase(node);
+    leaves_.erase(node);
 }
 
 inline void DAGraph0::erase(
@@ -1090,118 +1357,807 @@ inline void DAGraph0::erase(
     arcs_[a].next_in = first_free_arc_;
     first_free_arc_ = a;
     arcs_[a].prev_in = -2;
+
+    if (nodes_[arcs_[a].source].first_out == -1)
+        leaves_.insert(Node(arcs_[a].source));
+    if (nodes_[arcs_[a].target].first_in == -1)
+        roots_.insert(Node(arcs_[a].target));
+}
+
+inline std::vector<int> DAGraph0::compact(
+        std::vector<int> & arc_ids
+){
+    // Find the new node order: breadth-first from each root node. Nodes that are only reachable
+    // from a cycle (which should not exist in a DAG) are appended in the order of the node list.
+    std::vector<int> node_ids(nodes_.size(), -1);
+    std::vector<int> order;
+    auto visit = [this, & node_ids, & order](int start)
+    {
+        if (node_ids[start] != -1)
+            return;
+        node_ids[start] = order.size();
+        order.push_back(start);
+        for (size_t k = order.size()-1; k < order.size(); ++k)
+        {
+            for (int a = nodes_[order[k]].first_out; a != -1; a = arcs_[a].next_out)
+            {
+                int const t = arcs_[a].target;
+                if (node_ids[t] == -1)
+                {
+                    node_ids[t] = order.size();
+                    order.push_back(t);
+                }
+            }
+        }
+    };
+    for (auto const & root : roots_)
+    {
+        visit(root.id());
+    }
+    for (int n = first_node_; n != -1; n = nodes_[n].next)
+    {
+        visit(n);
+    }
+
+    // Number the arcs by their source node.
+    arc_ids.assign(arcs_.size(), -1);
+    std::vector<int> arc_order;
+    for (int const n : order)
+    {
+        for (int a = nodes_[n].first_out; a != -1; a = arcs_[a].next_out)
+        {
+            arc_ids[a] = arc_order.size();
+            arc_order.push_back(a);
+        }
+    }
+
+    // Copy nodes and arcs to their new positions. The node list follows the new ids.
+    auto const new_node = [& node_ids](int id) { return (id == -1) ? -1 : node_ids[id]; };
+    auto const new_arc = [& arc_ids](int id) { return (id == -1) ? -1 : arc_ids[id]; };
+    std::vector<NodeT> nodes(order.size());
+    for (size_t k = 0; k < order.size(); ++k)
+    {
+        NodeT const & old_node = nodes_[order[k]];
+        NodeT & n = nodes[k];
+        n.prev = static_cast<int>(k)-1;
+        n.next = (k+1 < order.size()) ? static_cast<int>(k+1) : -1;
+        n.first_in = new_arc(old_node.first_in);
+        n.first_out = new_arc(old_node.first_out);
+    }
+    std::vector<ArcT> arcs(arc_order.size());
+    for (size_t k = 0; k < arc_order.size(); ++k)
+    {
+        ArcT const & old_arc = arcs_[arc_order[k]];
+        ArcT & a = arcs[k];
+        a.source = new_node(old_arc.source);
+        a.target = new_node(old_arc.target);
+        a.prev_in = new_arc(old_arc.prev_in);
+        a.next_in = new_arc(old_arc.next_in);
+        a.prev_out = new_arc(old_arc.prev_out);
+        a.next_out = new_arc(old_arc.next_out);
+    }
+    nodes_.swap(nodes);
+    arcs_.swap(arcs);
+    first_node_ = nodes_.empty() ? -1 : 0;
+    first_free_node_ = -1;
+    first_free_arc_ = -1;
+
+    // Renumber the roots and leaves, keeping their order.
+    detail::remap_index_set(roots_, node_ids);
+    detail::remap_index_set(leaves_, node_ids);
+    return node_ids;
+}
+
+inline std::vector<int> DAGraph0::compact()
+{
+    std::vector<int> arc_ids;
+    return compact(arc_ids);
 }
 
 inline bool DAGraph0::isRootNode(
         Node const & node
 ) const {
-    Arc tmp;
-    firstIn(tmp, node);
-    return !valid(tmp);
+    return roots_.contains(node);
 }
 
 inline bool DAGraph0::isLeafNode(
         Node const & node
 ) const {
-    Arc tmp;
-    firstOut(tmp, node);
-    return !valid(tmp);
+    return leaves_.contains(node);
 }
 
+inline auto DAGraph0::roots_cbegin() const -> const_iterator
+{
+    return roots_.cbegin();
+}
 
+inline auto DAGraph0::roots_cend() const -> const_iterator
+{
+    return roots_.cend();
+}
 
-/// \brief The Forest1 class extends a graph by some rootnode and parent functions. Building Forest1 is slower than building Forest0, but the Forest1 iterators are faster.
-template <typename GRAPH>
-class Forest1 : public GRAPH
+inline auto DAGraph0::leaves_cbegin() const -> const_iterator
 {
-public:
+    return leaves_.cbegin();
+}
 
-    typedef GRAPH Parent;
-    typedef typename Parent::Node Node;
-    typedef typename Parent::Arc Arc;
-    typedef typename Parent::ParentIt ParentIt;
-    typedef typename Parent::ChildIt ChildIt;
-    typedef std::unordered_set<Node, detail::IdHash<Node> > ContainerType;
-//    typedef std::set<Node> ContainerType;
-    typedef typename ContainerType::const_iterator const_iterator;
-    typedef detail::ItemIt<Forest1, detail::RootNodeVectorItFunctor<Forest1> > RootNodeIt;
-    typedef detail::ItemIt<Forest1, detail::LeafNodeVectorItFunctor<Forest1> > LeafNodeIt;
+inline auto DAGraph0::leaves_cend() const -> const_iterator
+{
+    return leaves_.cend();
+}
 
-    // TODO: These typedefs are not used within the class. Do they need to be made visible this way? Or are they visible by default (from the superclass)?
-    typedef typename Parent::index_type index_type;
-    typedef typename Parent::NodeIt NodeIt;
-    typedef typename Parent::ArcIt ArcIt;
-    typedef typename Parent::OutArcIt OutArcIt;
-    typedef typename Parent::InArcIt InArcIt;
 
-    Forest1() = default;
-    Forest1(Forest1 const &) = default;
-    Forest1(Forest1 &&) = default;
-    ~Forest1() = default;
-    Forest1 & operator=(Forest1 const &) = default;
-    Forest1 & operator=(Forest1 &&) = default;
 
-    /// \brief Construct the forest from the given graph.
-    Forest1(Parent const &);
+/// \brief Immutable snapshot of a DAGraph0 with the same api (without addNode, addArc and erase).
+///
+/// The outgoing and incoming arcs are stored in CSR / CSC arrays, so the children and the parents of a node
+/// are contiguous ranges and iterating over them does not chase linked lists. Node and arc ids are the ones
+/// of the original graph, so node maps and arc maps remain valid.
+class StaticDAGraph0
+{
 
-    virtual Node addNode() override;
+public:
 
-    virtual Arc addArc(Node const & u, Node const & v) override;
+    typedef DAGraph0::index_type index_type;
+    typedef DAGraph0::Node Node;
+    typedef DAGraph0::Arc Arc;
+    typedef std::vector<Node>::const_iterator const_iterator;
+    typedef detail::ItemIt<StaticDAGraph0, detail::NodeItFunctor<StaticDAGraph0> > NodeIt;
+    typedef detail::ItemIt<StaticDAGraph0, detail::RootNodeVectorItFunctor<StaticDAGraph0> > RootNodeIt;
+    typedef detail::ItemIt<StaticDAGraph0, detail::LeafNodeVectorItFunctor<StaticDAGraph0> > LeafNodeIt;
+    typedef detail::ItemIt<StaticDAGraph0, detail::ArcItFunctor<StaticDAGraph0> > ArcIt;
+    typedef detail::SubItemIt<StaticDAGraph0, detail::OutArcItFunctor<StaticDAGraph0> > OutArcIt;
+    typedef detail::SubItemIt<StaticDAGraph0, detail::InArcItFunctor<StaticDAGraph0> > InArcIt;
+    typedef detail::SubItemIt<StaticDAGraph0, detail::ParentRangeItFunctor<StaticDAGraph0> > ParentIt;
+    typedef detail::SubItemIt<StaticDAGraph0, detail::ChildRangeItFunctor<StaticDAGraph0> > ChildIt;
 
-    virtual void erase(Node const & node) override;
+    template <typename T>
+    using NodeMap = DAGraph0::NodeMap<T>;
 
-    virtual void erase(Arc const & arc) override;
+    template <typename T>
+    using ArcMap = DAGraph0::ArcMap<T>;
 
-    const_iterator roots_cbegin() const;
+    /// \brief Create an empty graph.
+    StaticDAGraph0();
 
-    const_iterator roots_cend() const;
+    /// \brief Create the snapshot of the given graph.
+    StaticDAGraph0(DAGraph0 const & graph);
 
-    const_iterator leaves_cbegin() const;
+    /// \brief Create the graph with the nodes 0, ..., num_nodes-1 and the arcs arcs[i] = (source, target) with arc id i.
+    StaticDAGraph0(size_t num_nodes, std::vector<std::pair<index_type, index_type> > const & arcs);
 
-    const_iterator leaves_cend() const;
+    StaticDAGraph0(StaticDAGraph0 const &) = default;
+    StaticDAGraph0(StaticDAGraph0 &&) = default;
+    ~StaticDAGraph0() = default;
+    StaticDAGraph0 & operator=(StaticDAGraph0 const &) = default;
+    StaticDAGraph0 & operator=(StaticDAGraph0 &&) = default;
 
-protected:
+    /// \brief Return the maximum of all node ids.
+    int maxNodeId() const;
 
-    /// \brief Unordered set with root nodes.
-    ContainerType roots_;
+    /// \brief Return the maximum of all arc ids.
+    int maxArcId() const;
 
-    /// \brief Unordered set with leaf nodes.
-    ContainerType leaves_;
-};
+    /// \brief Return the number of nodes.
+    size_t numNodes() const;
 
-template <typename GRAPH>
-Forest1<GRAPH>::Forest1(Parent const & other)
-    : Parent(other)
-{
-    for (typename Parent::RootNodeIt it(*this); it != lemon::INVALID; ++it)
-    {
-        roots_.insert(Node(*it));
-    }
-    for (typename Parent::LeafNodeIt it(*this); it != lemon::INVALID; ++it)
-    {
-        leaves_.insert(Node(*it));
-    }
-}
+    /// \brief Return the number of arcs.
+    size_t numArcs() const;
 
-template <typename GRAPH>
-auto Forest1<GRAPH>::addNode() -> Node
-{
-    Node node = Parent::addNode();
-    roots_.insert(node);
-    leaves_.insert(node);
-    return node;
-}
+    /// \brief Return the source node of the given arc.
+    Node source(Arc const & arc) const;
 
-template <typename GRAPH>
-auto Forest1<GRAPH>::addArc(
-        Node const & u,
-        Node const & v
-) -> Arc
-{
-    Arc tmp;
-    this->firstOut(tmp, u);
-    if (!this->valid(tmp))
-        leaves_.erase(u);
+    /// \brief Return the target node of the given arc.
+    Node target(Arc const & arc) const;
+
+    /// \brief Set node to the first valid node.
+    void first(Node & node) const;
+
+    /// \brief Set node to the next valid node.
+    void next(Node & node) const;
+
+    /// \brief Set arc to the first valid arc.
+    void first(Arc & arc) const;
+
+    /// \brief Set arc to the next valid arc.
+    void next(Arc & arc) const;
+
+    /// \brief Set arc to the first outgoing arc of node.
+    void firstOut(Arc & arc, Node const & node) const;
+
+    /// \brief Set arc to the next outgoing arc of node.
+    void nextOut(Arc & arc) const;
+
+    /// \brief Set arc to the first incoming arc of node.
+    void firstIn(Arc & arc, Node const & node) const;
+
+    /// \brief Set arc to the next incoming arc of node.
+    void nextIn(Arc & arc) const;
+
+    /// \brief Return one of the parents of the given node.
+    void parent(Node & node) const;
+
+    /// \brief Return one of the children of the given node.
+    void child(Node & node) const;
+
+    /// \brief Return the number of incoming arcs of the given node.
+    size_t inDegree(Node const & node) const;
+
+    /// \brief Return the number of outgoing arcs of the given node.
+    size_t outDegree(Node const & node) const;
+
+    /// \brief Return the begin of the contiguous range with the children of the given node.
+    Node const * children_begin(Node const & node) const;
+
+    /// \brief Return the end of the contiguous range with the children of the given node.
+    Node const * children_end(Node const & node) const;
+
+    /// \brief Return the begin of the contiguous range with the parents of the given node.
+    Node const * parents_begin(Node const & node) const;
+
+    /// \brief Return the end of the contiguous range with the parents of the given node.
+    Node const * parents_end(Node const & node) const;
+
+    /// \brief Return the id of the given node.
+    static int id(Node const & node);
+
+    /// \brief Return the id of the given arc.
+    static int id(Arc const & arc);
+
+    /// \brief Create a node object with the given id.
+    static Node nodeFromId(int id);
+
+    /// \brief Create an arc object with the given id.
+    static Arc arcFromId(int id);
+
+    /// \brief Return true if the graph contains the given node.
+    bool valid(Node const & n) const;
+
+    /// \brief Return true if the graph contains the given arc.
+    bool valid(Arc const & a) const;
+
+    /// \brief Return true if the given node is a root node.
+    bool isRootNode(Node const & node) const;
+
+    /// \brief Return true if the given node is a leaf node.
+    bool isLeafNode(Node const & node) const;
+
+    const_iterator roots_cbegin() const;
+
+    const_iterator roots_cend() const;
+
+    const_iterator leaves_cbegin() const;
+
+    const_iterator leaves_cend() const;
+
+protected:
+
+    struct ArcT
+    {
+        int source;
+        int target;
+        int out_pos;
+        int in_pos;
+    };
+
+    /// \brief Fill the CSR / CSC arrays with counting sorts of the given arc ids by their source and their target.
+    /// The outgoing arcs of each node keep their order in arc_order. Nodes with node_valid_[n] == false are ignored.
+    void build(std::vector<int> const & arc_order);
+
+    /// \brief Flag for each node id whether the node exists.
+    std::vector<bool> node_valid_;
+
+    /// \brief The arcs, indexed by the arc id.
+    std::vector<ArcT> arcs_;
+
+    /// \brief The outgoing arcs of node n are out_arcs_[out_offsets_[n]], ..., out_arcs_[out_offsets_[n+1]-1].
+    std::vector<int> out_offsets_;
+    std::vector<Arc> out_arcs_;
+    std::vector<Node> out_targets_;
+
+    /// \brief The incoming arcs of node n are in_arcs_[in_offsets_[n]], ..., in_arcs_[in_offsets_[n+1]-1].
+    std::vector<int> in_offsets_;
+    std::vector<Arc> in_arcs_;
+    std::vector<Node> in_sources_;
+
+    /// \brief The root nodes and the leaf nodes.
+    std::vector<Node> roots_;
+    std::vector<Node> leaves_;
+
+    size_t num_nodes_;
+
+};
+
+inline StaticDAGraph0::StaticDAGraph0()
+    : node_valid_(),
+      arcs_(),
+      out_offsets_(1, 0),
+      out_arcs_(),
+      out_targets_(),
+      in_offsets_(1, 0),
+      in_arcs_(),
+      in_sources_(),
+      roots_(),
+      leaves_(),
+      num_nodes_(0)
+{}
+
+inline StaticDAGraph0::StaticDAGraph0(
+        DAGraph0 const & graph
+)   : StaticDAGraph0()
+{
+    // Collect the nodes and the arcs (in the iteration order of the outgoing arcs of the graph).
+    node_valid_.resize(graph.maxNodeId()+1, false);
+    arcs_.resize(graph.maxArcId()+1, ArcT{-1, -1, -1, -1});
+    std::vector<int> arc_order;
+    arc_order.reserve(arcs_.size());
+    for (DAGraph0::NodeIt it(graph); it != lemon::INVALID; ++it)
+    {
+        node_valid_[it->id()] = true;
+        for (DAGraph0::OutArcIt ait(graph, *it); ait != lemon::INVALID; ++ait)
+        {
+            arcs_[ait->id()].source = graph.source(*ait).id();
+            arcs_[ait->id()].target = graph.target(*ait).id();
+            arc_order.push_back(ait->id());
+        }
+    }
+    build(arc_order);
+}
+
+inline StaticDAGraph0::StaticDAGraph0(
+        size_t const num_nodes,
+        std::vector<std::pair<index_type, index_type> > const & arcs
+)   : StaticDAGraph0()
+{
+    node_valid_.resize(num_nodes, true);
+    arcs_.resize(arcs.size());
+    std::vector<int> arc_order(arcs.size());
+    for (size_t i = 0; i < arcs.size(); ++i)
+    {
+        vigra_precondition(arcs[i].first >= 0 && arcs[i].first < static_cast<index_type>(num_nodes) &&
+                           arcs[i].second >= 0 && arcs[i].second < static_cast<index_type>(num_nodes),
+                           "StaticDAGraph0(): Node id out of range.");
+        arcs_[i] = ArcT{static_cast<int>(arcs[i].first), static_cast<int>(arcs[i].second), -1, -1};
+        arc_order[i] = static_cast<int>(i);
+    }
+    build(arc_order);
+}
+
+inline void StaticDAGraph0::build(
+        std::vector<int> const & arc_order
+){
+    size_t const num_ids = node_valid_.size();
+    num_nodes_ = std::count(node_valid_.begin(), node_valid_.end(), true);
+
+    // Fill the CSR arrays with a counting sort of the arcs by their source.
+    out_offsets_.assign(num_ids+1, 0);
+    for (int const a : arc_order)
+    {
+        ++out_offsets_[arcs_[a].source+1];
+    }
+    for (size_t n = 0; n < num_ids; ++n)
+    {
+        out_offsets_[n+1] += out_offsets_[n];
+    }
+    out_arcs_.resize(out_offsets_.back());
+    out_targets_.resize(out_offsets_.back());
+    std::vector<int> fill(out_offsets_.begin(), out_offsets_.end()-1);
+    for (int const a : arc_order)
+    {
+        ArcT & arc = arcs_[a];
+        int const pos = fill[arc.source]++;
+        arc.out_pos = pos;
+        out_arcs_[pos] = Arc(a);
+        out_targets_[pos] = Node(arc.target);
+    }
+
+    // Fill the CSC arrays with a counting sort of the arcs by their target.
+    in_offsets_.assign(num_ids+1, 0);
+    for (Arc const & a : out_arcs_)
+    {
+        ++in_offsets_[arcs_[a.id()].target+1];
+    }
+    for (size_t n = 0; n < num_ids; ++n)
+    {
+        in_offsets_[n+1] += in_offsets_[n];
+    }
+    in_arcs_.resize(in_offsets_.back());
+    in_sources_.resize(in_offsets_.back());
+    fill.assign(in_offsets_.begin(), in_offsets_.end()-1);
+    for (Arc const & a : out_arcs_)
+    {
+        ArcT & arc = arcs_[a.id()];
+        int const pos = fill[arc.target]++;
+        arc.in_pos = pos;
+        in_arcs_[pos] = a;
+        in_sources_[pos] = Node(arc.source);
+    }
+
+    // Find the root nodes and the leaf nodes.
+    roots_.clear();
+    leaves_.clear();
+    for (size_t n = 0; n < num_ids; ++n)
+    {
+        if (!node_valid_[n])
+            continue;
+        if (in_offsets_[n] == in_offsets_[n+1])
+            roots_.push_back(Node(n));
+        if (out_offsets_[n] == out_offsets_[n+1])
+            leaves_.push_back(Node(n));
+    }
+}
+
+inline int StaticDAGraph0::maxNodeId() const
+{
+    return static_cast<int>(node_valid_.size())-1;
+}
+
+inline int StaticDAGraph0::maxArcId() const
+{
+    return static_cast<int>(arcs_.size())-1;
+}
+
+inline size_t StaticDAGraph0::numNodes() const
+{
+    return num_nodes_;
+}
+
+inline size_t StaticDAGraph0::numArcs() const
+{
+    return out_arcs_.size();
+}
+
+inline auto StaticDAGraph0::source(
+        Arc const & arc
+) const -> Node
+{
+    return Node(arcs_[arc.id()].source);
+}
+
+inline auto StaticDAGraph0::target(
+        Arc const & arc
+) const -> Node
+{
+    return Node(arcs_[arc.id()].target);
+}
+
+inline void StaticDAGraph0::first(
+        Node & node
+) const {
+    node = lemon::INVALID;
+    for (size_t n = 0; n < node_valid_.size(); ++n)
+    {
+        if (node_valid_[n])
+        {
+            node.set_id(n);
+            return;
+        }
+    }
+}
+
+inline void StaticDAGraph0::next(
+        Node & node
+) const {
+    for (size_t n = node.id()+1; n < node_valid_.size(); ++n)
+    {
+        if (node_valid_[n])
+        {
+            node.set_id(n);
+            return;
+        }
+    }
+    node = lemon::INVALID;
+}
+
+inline void StaticDAGraph0::first(
+        Arc & arc
+) const {
+    if (out_arcs_.empty())
+        arc = lemon::INVALID;
+    else
+        arc = out_arcs_.front();
+}
+
+inline void StaticDAGraph0::next(
+        Arc & arc
+) const {
+    size_t const pos = arcs_[arc.id()].out_pos + 1;
+    if (pos < out_arcs_.size())
+        arc = out_arcs_[pos];
+    else
+        arc = lemon::INVALID;
+}
+
+inline void StaticDAGraph0::firstOut(
+        Arc & arc,
+        Node const & node
+) const {
+    int const pos = out_offsets_[node.id()];
+    if (pos < out_offsets_[node.id()+1])
+        arc = out_arcs_[pos];
+    else
+        arc = lemon::INVALID;
+}
+
+inline void StaticDAGraph0::nextOut(
+        Arc & arc
+) const {
+    ArcT const & a = arcs_[arc.id()];
+    int const pos = a.out_pos + 1;
+    if (pos < out_offsets_[a.source+1])
+        arc = out_arcs_[pos];
+    else
+        arc = lemon::INVALID;
+}
+
+inline void StaticDAGraph0::firstIn(
+        Arc & arc,
+        Node const & node
+) const {
+    int const pos = in_offsets_[node.id()];
+    if (pos < in_offsets_[node.id()+1])
+        arc = in_arcs_[pos];
+    else
+        arc = lemon::INVALID;
+}
+
+inline void StaticDAGraph0::nextIn(
+        Arc & arc
+) const {
+    ArcT const & a = arcs_[arc.id()];
+    int const pos = a.in_pos + 1;
+    if (pos < in_offsets_[a.target+1])
+        arc = in_arcs_[pos];
+    else
+        arc = lemon::INVALID;
+}
+
+inline void StaticDAGraph0::parent(
+        Node & node
+) const {
+    if (inDegree(node) > 0)
+        node = *parents_begin(node);
+    else
+        node = lemon::INVALID;
+}
+
+inline void StaticDAGraph0::child(
+        Node & node
+) const {
+    if (outDegree(node) > 0)
+        node = *children_begin(node);
+    else
+        node = lemon::INVALID;
+}
+
+inline size_t StaticDAGraph0::inDegree(
+        Node const & node
+) const {
+    return in_offsets_[node.id()+1] - in_offsets_[node.id()];
+}
+
+inline size_t StaticDAGraph0::outDegree(
+        Node const & node
+) const {
+    return out_offsets_[node.id()+1] - out_offsets_[node.id()];
+}
+
+inline auto StaticDAGraph0::children_begin(
+        Node const & node
+) const -> Node const *
+{
+    return out_targets_.data() + out_offsets_[node.id()];
+}
+
+inline auto StaticDAGraph0::children_end(
+        Node const & node
+) const -> Node const *
+{
+    return out_targets_.data() + out_offsets_[node.id()+1];
+}
+
+inline auto StaticDAGraph0::parents_begin(
+        Node const & node
+) const -> Node const *
+{
+    return in_sources_.data() + in_offsets_[node.id()];
+}
+
+inline auto StaticDAGraph0::parents_end(
+        Node const & node
+) const -> Node const *
+{
+    return in_sources_.data() + in_offsets_[node.id()+1];
+}
+
+inline int StaticDAGraph0::id(
+        Node const & node
+){
+    return node.id();
+}
+
+inline int StaticDAGraph0::id(
+        Arc const & arc
+){
+    return arc.id();
+}
+
+inline auto StaticDAGraph0::nodeFromId(
+        int id
+) -> Node
+{
+    return Node(id);
+}
+
+inline auto StaticDAGraph0::arcFromId(
+        int id
+) -> Arc
+{
+    return Arc(id);
+}
+
+inline bool StaticDAGraph0::valid(
+        Node const & n
+) const {
+    return n.id() >= 0 && n.id() < static_cast<int>(node_valid_.size()) && node_valid_[n.id()];
+}
+
+inline bool StaticDAGraph0::valid(
+        Arc const & a
+) const {
+    return a.id() >= 0 && a.id() < static_cast<int>(arcs_.size()) && arcs_[a.id()].source != -1;
+}
+
+inline bool StaticDAGraph0::isRootNode(
+        Node const & node
+) const {
+    return inDegree(node) == 0;
+}
+
+inline bool StaticDAGraph0::isLeafNode(
+        Node const & node
+) const {
+    return outDegree(node) == 0;
+}
+
+inline auto StaticDAGraph0::roots_cbegin() const -> const_iterator
+{
+    return roots_.cbegin();
+}
+
+inline auto StaticDAGraph0::roots_cend() const -> const_iterator
+{
+    return roots_.cend();
+}
+
+inline auto StaticDAGraph0::leaves_cbegin() const -> const_iterator
+{
+    return leaves_.cbegin();
+}
+
+inline auto StaticDAGraph0::leaves_cend() const -> const_iterator
+{
+    return leaves_.cend();
+}
+
+inline StaticDAGraph0 DAGraph0::freeze() const
+{
+    return StaticDAGraph0(*this);
+}
+
+
+
+namespace detail
+{
+
+    /// \brief GraphMaintainsRootsAndLeaves<GRAPH>::value is true if GRAPH keeps its root and leaf nodes in index sets itself.
+    template <typename GRAPH>
+    struct GraphMaintainsRootsAndLeaves : public std::false_type
+    {};
+
+    template <>
+    struct GraphMaintainsRootsAndLeaves<DAGraph0> : public std::true_type
+    {};
+
+} // namespace detail
+
+/// \brief The Forest1 class extends a graph by some rootnode and parent functions. The root and leaf nodes are kept in index sets, so they are updated in O(1) and the RootNodeIt and LeafNodeIt iterators walk over contiguous arrays.
+///
+/// If the graph already maintains such sets (see detail::GraphMaintainsRootsAndLeaves), the sets of the graph are used.
+template <typename GRAPH, bool MAINTAINED = detail::GraphMaintainsRootsAndLeaves<GRAPH>::value>
+class Forest1 : public GRAPH
+{
+public:
+
+    typedef GRAPH Parent;
+    typedef typename Parent::Node Node;
+    typedef typename Parent::Arc Arc;
+    typedef typename Parent::ParentIt ParentIt;
+    typedef typename Parent::ChildIt ChildIt;
+    typedef detail::IndexSet<Node> ContainerType;
+    typedef typename ContainerType::const_iterator const_iterator;
+    typedef detail::ItemIt<Forest1, detail::RootNodeVectorItFunctor<Forest1> > RootNodeIt;
+    typedef detail::ItemIt<Forest1, detail::LeafNodeVectorItFunctor<Forest1> > LeafNodeIt;
+
+    // TODO: These typedefs are not used within the class. Do they need to be made visible this way? Or are they visible by default (from the superclass)?
+    typedef typename Parent::index_type index_type;
+    typedef typename Parent::NodeIt NodeIt;
+    typedef typename Parent::ArcIt ArcIt;
+    typedef typename Parent::OutArcIt OutArcIt;
+    typedef typename Parent::InArcIt InArcIt;
+
+    Forest1() = default;
+    Forest1(Forest1 const &) = default;
+    Forest1(Forest1 &&) = default;
+    ~Forest1() = default;
+    Forest1 & operator=(Forest1 const &) = default;
+    Forest1 & operator=(Forest1 &&) = default;
+
+    /// \brief Construct the forest from the given graph.
+    Forest1(Parent const &);
+
+    virtual Node addNode() override;
+
+    virtual Arc addArc(Node const & u, Node const & v) override;
+
+    virtual void erase(Node const & node) override;
+
+    virtual void erase(Arc const & arc) override;
+
+    using Parent::compact;
+
+    virtual std::vector<int> compact(std::vector<int> & arc_ids) override;
+
+    const_iterator roots_cbegin() const;
+
+    const_iterator roots_cend() const;
+
+    const_iterator leaves_cbegin() const;
+
+    const_iterator leaves_cend() const;
+
+protected:
+
+    /// \brief Index set with root nodes.
+    ContainerType roots_;
+
+    /// \brief Index set with leaf nodes.
+    ContainerType leaves_;
+};
+
+template <typename GRAPH, bool MAINTAINED>
+Forest1<GRAPH, MAINTAINED>::Forest1(Parent const & other)
+    : Parent(other)
+{
+    for (typename Parent::RootNodeIt it(*this); it != lemon::INVALID; ++it)
+    {
+        roots_.insert(Node(*it));
+    }
+    for (typename Parent::LeafNodeIt it(*this); it != lemon::INVALID; ++it)
+    {
+        leaves_.insert(Node(*it));
+    }
+}
+
+template <typename GRAPH, bool MAINTAINED>
+auto Forest1<GRAPH, MAINTAINED>::addNode() -> Node
+{
+    Node node = Parent::addNode();
+    roots_.insert(node);
+    leaves_.insert(node);
+    return node;
+}
+
+template <typename GRAPH, bool MAINTAINED>
+auto Forest1<GRAPH, MAINTAINED>::addArc(
+        Node const & u,
+        Node const & v
+) -> Arc
+{
+    Arc tmp;
+    this->firstOut(tmp, u);
+    if (!this->valid(tmp))
+        leaves_.erase(u);
     this->firstIn(tmp, v);
     if (!this->valid(tmp))
         roots_.erase(v);
@@ -1209,8 +2165,8 @@ auto Forest1<GRAPH>::addArc(
     return Parent::addArc(u, v);
 }
 
-template <typename GRAPH>
-void Forest1<GRAPH>::erase(
+template <typename GRAPH, bool MAINTAINED>
+void Forest1<GRAPH, MAINTAINED>::erase(
         Node const & node
 ){
     Parent::erase(node);
@@ -1218,8 +2174,8 @@ void Forest1<GRAPH>::erase(
     leaves_.erase(node);
 }
 
-template <typename GRAPH>
-void Forest1<GRAPH>::erase(
+template <typename GRAPH, bool MAINTAINED>
+void Forest1<GRAPH, MAINTAINED>::erase(
         Arc const & arc
 ){
     Node src = this->source(arc);
@@ -1237,32 +2193,78 @@ void Forest1<GRAPH>::erase(
         roots_.insert(tar);
 }
 
-template <typename GRAPH>
-auto Forest1<GRAPH>::roots_cbegin() const -> const_iterator
+template <typename GRAPH, bool MAINTAINED>
+std::vector<int> Forest1<GRAPH, MAINTAINED>::compact(
+        std::vector<int> & arc_ids
+){
+    std::vector<int> node_ids = Parent::compact(arc_ids);
+    detail::remap_index_set(roots_, node_ids);
+    detail::remap_index_set(leaves_, node_ids);
+    return node_ids;
+}
+
+template <typename GRAPH, bool MAINTAINED>
+auto Forest1<GRAPH, MAINTAINED>::roots_cbegin() const -> const_iterator
 {
     return roots_.cbegin();
 }
 
-template <typename GRAPH>
-auto Forest1<GRAPH>::roots_cend() const -> const_iterator
+template <typename GRAPH, bool MAINTAINED>
+auto Forest1<GRAPH, MAINTAINED>::roots_cend() const -> const_iterator
 {
     return roots_.cend();
 }
 
-template <typename GRAPH>
-auto Forest1<GRAPH>::leaves_cbegin() const -> const_iterator
+template <typename GRAPH, bool MAINTAINED>
+auto Forest1<GRAPH, MAINTAINED>::leaves_cbegin() const -> const_iterator
 {
     return leaves_.cbegin();
 }
 
-template <typename GRAPH>
-auto Forest1<GRAPH>::leaves_cend() const -> const_iterator
+template <typename GRAPH, bool MAINTAINED>
+auto Forest1<GRAPH, MAINTAINED>::leaves_cend() const -> const_iterator
 {
     return leaves_.cend();
 }
 
 
 
+/// \brief Forest1 on a graph that maintains its root and leaf nodes itself: The sets of the graph are used, so nothing is stored twice.
+template <typename GRAPH>
+class Forest1<GRAPH, true> : public GRAPH
+{
+public:
+
+    typedef GRAPH Parent;
+    typedef typename Parent::Node Node;
+    typedef typename Parent::Arc Arc;
+    typedef typename Parent::ParentIt ParentIt;
+    typedef typename Parent::ChildIt ChildIt;
+    typedef typename Parent::ContainerType ContainerType;
+    typedef typename Parent::const_iterator const_iterator;
+    typedef typename Parent::RootNodeIt RootNodeIt;
+    typedef typename Parent::LeafNodeIt LeafNodeIt;
+    typedef typename Parent::index_type index_type;
+    typedef typename Parent::NodeIt NodeIt;
+    typedef typename Parent::ArcIt ArcIt;
+    typedef typename Parent::OutArcIt OutArcIt;
+    typedef typename Parent::InArcIt InArcIt;
+
+    Forest1() = default;
+    Forest1(Forest1 const &) = default;
+    Forest1(Forest1 &&) = default;
+    ~Forest1() = default;
+    Forest1 & operator=(Forest1 const &) = default;
+    Forest1 & operator=(Forest1 &&) = default;
+
+    /// \brief Construct the forest from the given graph.
+    Forest1(Parent const & other)
+        : Parent(other)
+    {}
+};
+
+
+
 } // namespace vigra
 
 #endif // VIGRA_DAGRAPH_HXX
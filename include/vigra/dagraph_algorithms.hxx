@@ -0,0 +1,704 @@
+#ifndef VIGRA_DAGRAPH_ALGORITHMS_HXX
+#define VIGRA_DAGRAPH_ALGORITHMS_HXX
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <exception>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+
+#include <vigra/graphs.hxx>  // for lemon::INVALID
+#include <vigra/sized_int.hxx>
+
+#include "parallel.hxx"
+
+namespace vigra
+{
+
+namespace detail
+{
+
+    /// \brief Task queue of a worker in a work-stealing pool. The owner pushes and pops at the back, other workers steal at the front.
+    template <typename T>
+    class StealingQueue
+    {
+    public:
+
+        void push(T const & x)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(x);
+        }
+
+        bool pop(T & x)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (queue_.empty())
+                return false;
+            x = queue_.back();
+            queue_.pop_back();
+            return true;
+        }
+
+        bool steal(T & x)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (queue_.empty())
+                return false;
+            x = queue_.front();
+            queue_.pop_front();
+            return true;
+        }
+
+    protected:
+
+        std::deque<T> queue_;
+        std::mutex mutex_;
+    };
+
+} // namespace detail
+
+
+
+/// \brief Return the nodes of the graph in topological order (each node comes after all of its parents).
+/// \note GRAPH must provide the IterDAG api (NodeIt, ParentIt, ChildIt and maxNodeId).
+template <typename GRAPH>
+std::vector<typename GRAPH::Node> topological_sort(
+        GRAPH const & g
+){
+    typedef typename GRAPH::Node Node;
+
+    // Count the parents of each node and start with the root nodes.
+    std::vector<size_t> pending(g.maxNodeId()+1, 0);
+    std::vector<Node> order;
+    for (typename GRAPH::NodeIt it(g); it != lemon::INVALID; ++it)
+    {
+        Node const node(*it);
+        for (typename GRAPH::ParentIt pit(g, node); pit != lemon::INVALID; ++pit)
+        {
+            ++pending[g.id(node)];
+        }
+        if (pending[g.id(node)] == 0)
+            order.push_back(node);
+    }
+
+    // Append a node as soon as all of its parents were appended.
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        for (typename GRAPH::ChildIt it(g, order[i]); it != lemon::INVALID; ++it)
+        {
+            Node const child(*it);
+            if (--pending[g.id(child)] == 0)
+                order.push_back(child);
+        }
+    }
+
+    vigra_precondition(std::all_of(pending.begin(), pending.end(), [](size_t k){ return k == 0; }),
+                       "topological_sort(): The graph contains a cycle.");
+    return order;
+}
+
+/// \brief Compute the level of each node and return the number of levels.
+///
+/// Root nodes have level 0, every other node has one level more than its deepest parent,
+/// so all nodes of one level can be processed independently.
+template <typename GRAPH, typename NODEMAP>
+size_t topological_levels(
+        GRAPH const & g,
+        NODEMAP & levels
+){
+    typedef typename GRAPH::Node Node;
+
+    size_t num_levels = 0;
+    for (Node const & node : topological_sort(g))
+    {
+        size_t level = 0;
+        for (typename GRAPH::ParentIt it(g, node); it != lemon::INVALID; ++it)
+        {
+            level = std::max(level, static_cast<size_t>(levels.at(Node(*it))) + 1);
+        }
+        levels[node] = level;
+        num_levels = std::max(num_levels, level + 1);
+    }
+    return num_levels;
+}
+
+/// \brief Call f(node) for each node of the graph, where a node is processed only after all of its parents were processed.
+///
+/// Each node has an atomic counter with the number of unprocessed parents. A node becomes ready when the counter
+/// reaches zero and is put in the queue of the worker that finished its last parent. Idle workers steal from the others.
+/// If f throws, the remaining nodes are skipped and the first exception is rethrown.
+template <typename GRAPH, typename FUNCTOR>
+void parallel_topological_for_each(
+        GRAPH const & g,
+        FUNCTOR const & f,
+        int num_threads = -1
+){
+    typedef typename GRAPH::Node Node;
+
+    vigra_precondition(num_threads == -1 || num_threads > 0,
+                       "parallel_topological_for_each(): num_threads must be -1 or greater than zero.");
+    size_t const num_workers = detail::num_workers(num_threads);
+
+    // Initialize the parent counters and distribute the root nodes.
+    std::vector<std::atomic<size_t> > pending(g.maxNodeId()+1);
+    std::vector<detail::StealingQueue<Node> > queues(num_workers);
+    size_t num_nodes = 0;
+    size_t num_roots = 0;
+    for (typename GRAPH::NodeIt it(g); it != lemon::INVALID; ++it)
+    {
+        Node const node(*it);
+        size_t num_parents = 0;
+        for (typename GRAPH::ParentIt pit(g, node); pit != lemon::INVALID; ++pit)
+        {
+            ++num_parents;
+        }
+        pending[g.id(node)].store(num_parents);
+        if (num_parents == 0)
+        {
+            queues[num_roots % num_workers].push(node);
+            ++num_roots;
+        }
+        ++num_nodes;
+    }
+
+    // remaining: nodes that were not processed yet, in_flight: nodes that are queued or being processed.
+    // If in_flight drops to zero while nodes remain, the rest of the graph is part of a cycle.
+    std::atomic<size_t> remaining(num_nodes);
+    std::atomic<size_t> in_flight(num_roots);
+    std::atomic<bool> abort(false);
+    bool cycle = false;
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto work = [&](size_t w) {
+        Node node;
+        while (remaining.load() > 0 && !abort.load())
+        {
+            // Get a node from the own queue or steal one from the others.
+            bool found = queues[w].pop(node);
+            for (size_t k = 1; !found && k < num_workers; ++k)
+            {
+                found = queues[(w+k) % num_workers].steal(node);
+            }
+            if (!found)
+            {
+                if (in_flight.load() == 0 && remaining.load() > 0)
+                {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    cycle = true;
+                    abort.store(true);
+                }
+                std::this_thread::yield();
+                continue;
+            }
+
+            // Process the node and release the children whose parents are all done.
+            try
+            {
+                f(node);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error)
+                    error = std::current_exception();
+                abort.store(true);
+            }
+            for (typename GRAPH::ChildIt it(g, node); it != lemon::INVALID; ++it)
+            {
+                Node const child(*it);
+                if (pending[g.id(child)].fetch_sub(1) == 1)
+                {
+                    ++in_flight;
+                    queues[w].push(child);
+                }
+            }
+            --remaining;
+            --in_flight;
+        }
+    };
+
+    if (num_workers == 1)
+    {
+        work(0);
+    }
+    else
+    {
+        std::vector<std::thread> workers;
+        for (size_t w = 0; w < num_workers; ++w)
+        {
+            workers.push_back(std::thread(work, w));
+        }
+        for (auto & t : workers)
+        {
+            t.join();
+        }
+    }
+
+    if (error)
+        std::rethrow_exception(error);
+    vigra_precondition(!cycle, "parallel_topological_for_each(): The graph contains a cycle.");
+}
+
+/// \brief Compute results[node] = f(node, results) for each node in topological order, using multiple threads.
+///
+/// f may read the results of the parents of the given node. The entries of all nodes are created before the
+/// threads start, so the workers only assign existing entries and the map is never restructured concurrently.
+template <typename GRAPH, typename NODEMAP, typename FUNCTOR>
+void parallel_topological_evaluate(
+        GRAPH const & g,
+        NODEMAP & results,
+        FUNCTOR const & f,
+        int num_threads = -1
+){
+    typedef typename GRAPH::Node Node;
+
+    for (typename GRAPH::NodeIt it(g); it != lemon::INVALID; ++it)
+    {
+        results[Node(*it)];
+    }
+    NODEMAP const & const_results = results;
+    parallel_topological_for_each(
+            g,
+            [& results, & const_results, & f](Node const & node)
+            {
+                results.at(node) = f(node, const_results);
+            },
+            num_threads
+    );
+}
+
+
+
+/// \brief Reachability index of a DAG for fast ancestor and descendant queries.
+///
+/// Each node gets labels that decide most queries in O(1):
+/// - its position in a topological order (a node only reaches nodes at a larger position),
+/// - the pre-order interval of its subtree in a DFS spanning forest (a node reaches all nodes in that interval),
+/// - the range of the DFS post-order numbers of its descendants (a node only reaches nodes with a contained range),
+/// - bit-parallel labels with the hub nodes (the 64 nodes with the largest degree) that reach the node and that it reaches.
+///
+/// On forests, the intervals alone decide every query. The remaining queries are answered by a DFS that is pruned
+/// with the labels. After an arc was added to the graph, insert_arc() updates the labels. If nodes or arcs are
+/// removed, the index must be rebuilt.
+/// \note GRAPH must provide the IterDAG api (NodeIt, ParentIt, ChildIt and maxNodeId).
+/// \note Queries may run concurrently, but not while insert_arc() or rebuild() is running.
+template <typename GRAPH>
+class ReachabilityIndex
+{
+public:
+
+    typedef GRAPH Graph;
+    typedef typename Graph::Node Node;
+
+    explicit ReachabilityIndex(Graph const & g)
+        : g_(g)
+    {
+        rebuild();
+    }
+
+    /// \brief Compute the labels of the current graph.
+    void rebuild();
+
+    /// \brief Return true if there is a directed path from u to v (also if u == v).
+    bool reachable(Node const & u, Node const & v) const;
+
+    /// \brief Return true if u is a proper ancestor of v.
+    bool is_ancestor(Node const & u, Node const & v) const
+    {
+        return g_.id(u) != g_.id(v) && reachable(u, v);
+    }
+
+    /// \brief Return all proper descendants of u.
+    std::vector<Node> descendants(Node const & u) const
+    {
+        return collect<typename Graph::ChildIt>(u, [](size_t){ return true; });
+    }
+
+    /// \brief Return all proper ancestors of u.
+    std::vector<Node> ancestors(Node const & u) const
+    {
+        return collect<typename Graph::ParentIt>(u, [](size_t){ return true; });
+    }
+
+    /// \brief Update the labels after the arc (u, v) was added to the graph, u and v may be new nodes.
+    ///
+    /// If the topological order is violated, only the nodes between u and v in the order are moved (Pearce and Kelly).
+    /// The post-order ranges and the hub labels are propagated as long as they change.
+    /// If the arc closes a cycle, the function fails and the labels are not changed.
+    void insert_arc(Node const & u, Node const & v);
+
+protected:
+
+    /// \brief Return false if the labels show that a cannot reach b.
+    bool may_reach(size_t const a, size_t const b) const
+    {
+        return order_[a] < order_[b] &&
+               low_[a] <= low_[b] && high_[b] <= high_[a] &&
+               (hubs_reaching_[a] & ~hubs_reaching_[b]) == 0 &&
+               (hubs_reached_[b] & ~hubs_reached_[a]) == 0;
+    }
+
+    /// \brief Return true if the labels show that a reaches b.
+    bool surely_reaches(size_t const a, size_t const b) const
+    {
+        return (pre_[a] < pre_[b] && pre_[b] <= pre_last_[a]) ||
+               (hubs_reached_[a] & hubs_reaching_[b]) != 0;
+    }
+
+    /// \brief Append labels for the ids up to the given one, they are unconnected until insert_arc() is called.
+    void add_ids(size_t const id);
+
+    /// \brief Return the nodes that are found by a DFS from start along ITER, where only neighbors with expand(id) are visited.
+    template <typename ITER, typename PRED>
+    std::vector<Node> collect(Node const & start, PRED const & expand) const;
+
+    Graph const & g_;
+
+    /// \brief Position in the topological order.
+    std::vector<size_t> order_;
+
+    /// \brief Pre-order number and largest pre-order number in the subtree of the DFS spanning forest.
+    std::vector<size_t> pre_;
+    std::vector<size_t> pre_last_;
+
+    /// \brief Smallest and largest post-order number of the descendants (and the node itself).
+    std::vector<size_t> low_;
+    std::vector<size_t> high_;
+
+    /// \brief Bit k is set if the node reaches hub k (hubs_reached_) or if hub k reaches the node (hubs_reaching_).
+    std::vector<UInt64> hubs_reached_;
+    std::vector<UInt64> hubs_reaching_;
+
+    size_t next_order_;
+    size_t next_post_;
+};
+
+template <typename GRAPH>
+void ReachabilityIndex<GRAPH>::rebuild()
+{
+    static constexpr size_t num_hubs = 64;
+
+    order_.clear();
+    pre_.clear();
+    pre_last_.clear();
+    low_.clear();
+    high_.clear();
+    hubs_reached_.clear();
+    hubs_reaching_.clear();
+    next_order_ = 0;
+    next_post_ = 0;
+
+    // Find the topological order and save the children of each node.
+    std::vector<Node> const topo = topological_sort(g_);
+    size_t const n = g_.maxNodeId()+1;
+    std::vector<size_t> child_begins(n+1, 0);
+    for (Node const & node : topo)
+    {
+        for (typename GRAPH::ChildIt it(g_, node); it != lemon::INVALID; ++it)
+        {
+            ++child_begins[g_.id(node)+1];
+        }
+    }
+    std::partial_sum(child_begins.begin(), child_begins.end(), child_begins.begin());
+    std::vector<size_t> children(child_begins.back());
+    for (Node const & node : topo)
+    {
+        size_t k = child_begins[g_.id(node)];
+        for (typename GRAPH::ChildIt it(g_, node); it != lemon::INVALID; ++it)
+        {
+            children[k++] = g_.id(Node(*it));
+        }
+    }
+
+    // The ids without node get the labels of unconnected nodes, the nodes are overwritten below.
+    std::vector<size_t> topo_ids(topo.size());
+    for (size_t i = 0; i < topo.size(); ++i)
+    {
+        topo_ids[i] = g_.id(topo[i]);
+    }
+    next_order_ = topo.size();
+    if (n > 0)
+        add_ids(n-1);
+    for (size_t i = 0; i < topo_ids.size(); ++i)
+    {
+        order_[topo_ids[i]] = i;
+    }
+
+    // Number the nodes with an iterative DFS, started at the nodes in topological order.
+    size_t pre = 0;
+    size_t post = 0;
+    std::vector<bool> visited(n, false);
+    std::vector<std::pair<size_t, size_t> > stack; // (node, position of the next child)
+    for (size_t const r : topo_ids)
+    {
+        if (visited[r])
+            continue;
+        visited[r] = true;
+        pre_[r] = pre++;
+        stack.push_back({r, child_begins[r]});
+        while (!stack.empty())
+        {
+            size_t const a = stack.back().first;
+            size_t & next_child = stack.back().second;
+            if (next_child < child_begins[a+1])
+            {
+                size_t const c = children[next_child++];
+                if (!visited[c])
+                {
+                    visited[c] = true;
+                    pre_[c] = pre++;
+                    stack.push_back({c, child_begins[c]});
+                }
+            }
+            else
+            {
+                pre_last_[a] = pre-1;
+                low_[a] = high_[a] = post++;
+                stack.pop_back();
+            }
+        }
+    }
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (!visited[i])
+            low_[i] = high_[i] = post++;
+    }
+    next_post_ = post;
+
+    // Select the hubs by the product of in- and out-degree.
+    std::vector<size_t> degrees(n, 1);
+    for (size_t const a : topo_ids)
+    {
+        degrees[a] = child_begins[a+1] - child_begins[a] + 1;
+    }
+    std::vector<size_t> in_degrees(n, 1);
+    for (size_t const c : children)
+    {
+        ++in_degrees[c];
+    }
+    for (size_t const a : topo_ids)
+    {
+        degrees[a] *= in_degrees[a];
+    }
+    std::vector<size_t> hubs(topo_ids);
+    size_t const num_selected = std::min(num_hubs, hubs.size());
+    std::partial_sort(hubs.begin(), hubs.begin() + num_selected, hubs.end(),
+            [& degrees](size_t a, size_t b)
+            {
+                return degrees[a] > degrees[b] || (degrees[a] == degrees[b] && a < b);
+            }
+    );
+    for (size_t k = 0; k < num_selected; ++k)
+    {
+        hubs_reached_[hubs[k]] |= UInt64(1) << k;
+        hubs_reaching_[hubs[k]] |= UInt64(1) << k;
+    }
+
+    // Propagate the post-order ranges and the hubs that are reached against the topological order,
+    // and the hubs that reach a node along the topological order.
+    for (auto it = topo_ids.rbegin(); it != topo_ids.rend(); ++it)
+    {
+        size_t const a = *it;
+        for (size_t k = child_begins[a]; k < child_begins[a+1]; ++k)
+        {
+            size_t const c = children[k];
+            low_[a] = std::min(low_[a], low_[c]);
+            high_[a] = std::max(high_[a], high_[c]);
+            hubs_reached_[a] |= hubs_reached_[c];
+        }
+    }
+    for (size_t const a : topo_ids)
+    {
+        for (size_t k = child_begins[a]; k < child_begins[a+1]; ++k)
+        {
+            hubs_reaching_[children[k]] |= hubs_reaching_[a];
+        }
+    }
+}
+
+template <typename GRAPH>
+bool ReachabilityIndex<GRAPH>::reachable(
+        Node const & u,
+        Node const & v
+) const {
+    size_t const a = g_.id(u);
+    size_t const b = g_.id(v);
+    vigra_precondition(a < order_.size() && b < order_.size(),
+                       "ReachabilityIndex::reachable(): Unknown node, call insert_arc() or rebuild() first.");
+    if (a == b)
+        return true;
+    if (!may_reach(a, b))
+        return false;
+    if (surely_reaches(a, b))
+        return true;
+
+    // Search v, but only visit the nodes that may reach it.
+    bool found = false;
+    collect<typename Graph::ChildIt>(u,
+            [this, b, & found](size_t c)
+            {
+                if (found || c == b || surely_reaches(c, b))
+                {
+                    found = true;
+                    return false;
+                }
+                return may_reach(c, b);
+            }
+    );
+    return found;
+}
+
+template <typename GRAPH>
+void ReachabilityIndex<GRAPH>::insert_arc(
+        Node const & u,
+        Node const & v
+){
+    size_t const a = g_.id(u);
+    size_t const b = g_.id(v);
+    vigra_precondition(a != b, "ReachabilityIndex::insert_arc(): The arc closes a cycle.");
+    add_ids(std::max(a, b));
+
+    // Restore the topological order: The descendants of v that are before u are moved behind the ancestors
+    // of u that are behind v, the freed positions are reused in the same order.
+    if (order_[a] > order_[b])
+    {
+        size_t const lower = order_[b];
+        size_t const upper = order_[a];
+        std::vector<Node> forward = collect<typename Graph::ChildIt>(v,
+                [this, upper](size_t c)
+                {
+                    return order_[c] <= upper;
+                }
+        );
+        for (Node const & node : forward)
+        {
+            vigra_precondition(static_cast<size_t>(g_.id(node)) != a, "ReachabilityIndex::insert_arc(): The arc closes a cycle.");
+        }
+        forward.push_back(v);
+        std::vector<Node> backward = collect<typename Graph::ParentIt>(u,
+                [this, lower](size_t p)
+                {
+                    return order_[p] > lower;
+                }
+        );
+        backward.push_back(u);
+
+        auto const by_order = [this](Node const & x, Node const & y)
+        {
+            return order_[g_.id(x)] < order_[g_.id(y)];
+        };
+        std::sort(forward.begin(), forward.end(), by_order);
+        std::sort(backward.begin(), backward.end(), by_order);
+        std::vector<size_t> positions;
+        for (Node const & node : backward)
+        {
+            positions.push_back(order_[g_.id(node)]);
+        }
+        for (Node const & node : forward)
+        {
+            positions.push_back(order_[g_.id(node)]);
+        }
+        std::sort(positions.begin(), positions.end());
+        size_t k = 0;
+        for (Node const & node : backward)
+        {
+            order_[g_.id(node)] = positions[k++];
+        }
+        for (Node const & node : forward)
+        {
+            order_[g_.id(node)] = positions[k++];
+        }
+    }
+
+    // u and its ancestors now also reach the descendants of v. The pre-order intervals stay valid,
+    // since they only show reachability that still exists.
+    size_t const low = low_[b];
+    size_t const high = high_[b];
+    UInt64 const reached = hubs_reached_[b];
+    auto const update_ancestor = [this, low, high, reached](size_t p)
+    {
+        bool const changed = low < low_[p] || high > high_[p] || (reached & ~hubs_reached_[p]) != 0;
+        low_[p] = std::min(low_[p], low);
+        high_[p] = std::max(high_[p], high);
+        hubs_reached_[p] |= reached;
+        return changed;
+    };
+    if (update_ancestor(a))
+        collect<typename Graph::ParentIt>(u, update_ancestor);
+
+    // v and its descendants are now also reached by the hubs that reach u.
+    UInt64 const reaching = hubs_reaching_[a];
+    auto const update_descendant = [this, reaching](size_t c)
+    {
+        bool const changed = (reaching & ~hubs_reaching_[c]) != 0;
+        hubs_reaching_[c] |= reaching;
+        return changed;
+    };
+    if (update_descendant(b))
+        collect<typename Graph::ChildIt>(v, update_descendant);
+}
+
+template <typename GRAPH>
+void ReachabilityIndex<GRAPH>::add_ids(
+        size_t const id
+){
+    while (order_.size() <= id)
+    {
+        order_.push_back(next_order_++);
+        pre_.push_back(std::numeric_limits<size_t>::max());
+        pre_last_.push_back(0);
+        low_.push_back(next_post_);
+        high_.push_back(next_post_++);
+        hubs_reached_.push_back(0);
+        hubs_reaching_.push_back(0);
+    }
+}
+
+template <typename GRAPH>
+template <typename ITER, typename PRED>
+auto ReachabilityIndex<GRAPH>::collect(
+        Node const & start,
+        PRED const & expand
+) const -> std::vector<Node>
+{
+    // The visited nodes are marked with a new stamp, so the marks need not be cleared.
+    static thread_local std::vector<size_t> marks;
+    static thread_local size_t stamp = 0;
+    if (marks.size() < order_.size())
+        marks.resize(order_.size(), 0);
+    ++stamp;
+    marks[g_.id(start)] = stamp;
+
+    std::vector<Node> found;
+    std::vector<Node> stack {start};
+    while (!stack.empty())
+    {
+        Node const node = stack.back();
+        stack.pop_back();
+        for (ITER it(g_, node); it != lemon::INVALID; ++it)
+        {
+            Node const next(*it);
+            size_t const id = g_.id(next);
+            vigra_assert(id < marks.size(), "ReachabilityIndex: Unknown node, call insert_arc() or rebuild() first.");
+            if (marks[id] != stamp && expand(id))
+            {
+                marks[id] = stamp;
+                found.push_back(next);
+                stack.push_back(next);
+            }
+        }
+    }
+    return found;
+}
+
+
+
+} // namespace vigra
+
+#endif // VIGRA_DAGRAPH_ALGORITHMS_HXX
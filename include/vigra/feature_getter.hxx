@@ -4,6 +4,9 @@
 #include <vigra/multi_array.hxx>
 #include <vector>
 #include <utility>
+#include <limits>
+#include <algorithm>
+#include <numeric>
 
 namespace vigra
 {
@@ -161,6 +164,7 @@ namespace detail
         SparseFeatureGetterConstNonZeroIter & operator++()
         {
             ++current_;
+            return *this;
         }
 
         std::pair<size_t, value_type> operator*() const
@@ -218,7 +222,7 @@ namespace detail
         SparseFeatureGetterConstIter & operator++()
         {
             ++current_;
-            if (current_ == indices_[next_index_])
+            if (next_index_ < indices_.size() && current_ == indices_[next_index_])
             {
                 is_zero_ = false;
                 ++next_index_;
@@ -227,6 +231,7 @@ namespace detail
             {
                 is_zero_ = true;
             }
+            return *this;
         }
 
         value_type operator*() const
@@ -256,6 +261,41 @@ namespace detail
         size_t const i_;
     };
 
+    /// \brief Iterator for the non zero elements of a single instance of a BinarySparseFeatureGetter (all values are 1).
+    template <typename FEATURES>
+    class BinarySparseFeatureGetterConstNonZeroIter
+    {
+    public:
+
+        typedef FEATURES Features;
+        typedef typename Features::value_type value_type;
+
+        explicit BinarySparseFeatureGetterConstNonZeroIter(
+                std::vector<UInt32>::const_iterator const & it
+        )   : it_(it)
+        {}
+
+        BinarySparseFeatureGetterConstNonZeroIter & operator++()
+        {
+            ++it_;
+            return *this;
+        }
+
+        std::pair<size_t, value_type> operator*() const
+        {
+            return std::pair<size_t, value_type>(*it_, 1);
+        }
+
+        bool operator!=(BinarySparseFeatureGetterConstNonZeroIter const & other) const
+        {
+            return it_ != other.it_;
+        }
+
+    protected:
+
+        std::vector<UInt32>::const_iterator it_;
+    };
+
 
 } // namespace detail
 
@@ -472,6 +512,244 @@ protected:
 
 
 
+/// \brief Sparse features where all non-zero values are 1 (a binary pattern).
+///
+/// Only the 32 bit column indices of the non-zero entries are saved, in one array for all instances,
+/// together with the position where each instance starts. The instances are appended one after another.
+template <typename T>
+class BinarySparseFeatureGetter
+{
+public:
+
+    typedef T value_type;
+    typedef std::vector<UInt32>::const_iterator ConstIndexIter;
+    typedef detail::BinarySparseFeatureGetterConstNonZeroIter<BinarySparseFeatureGetter> ConstNonZeroIter;
+
+    BinarySparseFeatureGetter(Shape2 const & shape = Shape2(0, 0))
+        : shape_(shape),
+          instance_begins_(1, 0),
+          indices_()
+    {
+        vigra_precondition(shape_[1] <= std::numeric_limits<UInt32>::max(),
+                           "BinarySparseFeatureGetter(): Too many features.");
+    }
+
+    Shape2 const & shape() const
+    {
+        return shape_;
+    }
+
+    size_t size() const
+    {
+        return shape_[0]*shape_[1];
+    }
+
+    /// \brief Reserve memory for the given total number of non-zero entries.
+    void reserve(size_t num_nonzero)
+    {
+        instance_begins_.reserve(shape_[0]+1);
+        indices_.reserve(num_nonzero);
+    }
+
+    /// \brief Append the next instance, given by the strictly increasing indices of its non-zero features.
+    template <typename ITER>
+    void append_instance(ITER begin, ITER end)
+    {
+        vigra_precondition(num_instances() < static_cast<size_t>(shape_[0]),
+                           "BinarySparseFeatureGetter::append_instance(): All instances were already appended.");
+        for (; begin != end; ++begin)
+        {
+            size_t const j = *begin;
+            vigra_assert(j < static_cast<size_t>(shape_[1]) && (indices_.size() == instance_begins_.back() || indices_.back() < j),
+                         "BinarySparseFeatureGetter::append_instance(): The indices must be strictly increasing.");
+            indices_.push_back(j);
+        }
+        instance_begins_.push_back(indices_.size());
+    }
+
+    /// \brief Return the number of instances that were appended so far.
+    size_t num_instances() const
+    {
+        return instance_begins_.size()-1;
+    }
+
+    value_type operator()(size_t const i, size_t const j) const
+    {
+        auto const begin = begin_instance_indices(i);
+        auto const end = end_instance_indices(i);
+        auto const lower = std::lower_bound(begin, end, j);
+        return (lower != end && *lower == j) ? 1 : 0;
+    }
+
+    size_t count_nonzero() const
+    {
+        return indices_.size();
+    }
+
+    /// \brief Return the number of non-zero features of instance i.
+    size_t count_nonzero(size_t const i) const
+    {
+        return instance_begins_[i+1] - instance_begins_[i];
+    }
+
+    ConstIndexIter begin_instance_indices(size_t const i) const
+    {
+        return indices_.begin() + instance_begins_[i];
+    }
+
+    ConstIndexIter end_instance_indices(size_t const i) const
+    {
+        return indices_.begin() + instance_begins_[i+1];
+    }
+
+    ConstNonZeroIter begin_instance_nonzero(size_t const i) const
+    {
+        return ConstNonZeroIter(begin_instance_indices(i));
+    }
+
+    ConstNonZeroIter end_instance_nonzero(size_t const i) const
+    {
+        return ConstNonZeroIter(end_instance_indices(i));
+    }
+
+protected:
+
+    Shape2 shape_;
+    std::vector<size_t> instance_begins_;
+    std::vector<UInt32> indices_;
+};
+
+
+
+/// \brief Column-oriented sparse features (compressed sparse columns) for the training of decision trees.
+///
+/// The non-zero values of each feature are saved in one array for all features, ordered by feature and
+/// then by instance, together with the instance indices and the position where each feature starts.
+/// The split search can thus visit the non-zero values of a single feature without touching the zeros.
+template <typename T>
+class SparseColumnFeatureGetter
+{
+public:
+
+    typedef T value_type;
+    typedef std::vector<size_t>::const_iterator ConstIndexIter;
+    typedef typename std::vector<value_type>::const_iterator ConstValueIter;
+
+    SparseColumnFeatureGetter(SparseFeatureGetter<value_type> const & features)
+        : shape_(features.shape()),
+          column_begins_(features.shape()[1]+1, 0)
+    {
+        // Count the non-zero values of each feature, then fill the columns instance by instance.
+        size_t const num_instances = shape_[0];
+        for (size_t i = 0; i < num_instances; ++i)
+        {
+            for (auto it = features.begin_instance_nonzero(i); it != features.end_instance_nonzero(i); ++it)
+            {
+                ++column_begins_[(*it).first+1];
+            }
+        }
+        std::partial_sum(column_begins_.begin(), column_begins_.end(), column_begins_.begin());
+        instances_.resize(column_begins_.back());
+        values_.resize(column_begins_.back());
+        std::vector<size_t> next(column_begins_.begin(), column_begins_.end()-1);
+        for (size_t i = 0; i < num_instances; ++i)
+        {
+            for (auto it = features.begin_instance_nonzero(i); it != features.end_instance_nonzero(i); ++it)
+            {
+                auto const p = *it;
+                instances_[next[p.first]] = i;
+                values_[next[p.first]] = p.second;
+                ++next[p.first];
+            }
+        }
+    }
+
+    SparseColumnFeatureGetter(MultiArrayView<2, value_type> const & arr)
+        : shape_(arr.shape()),
+          column_begins_(1, 0)
+    {
+        size_t const num_instances = shape_[0];
+        size_t const num_features = shape_[1];
+        column_begins_.reserve(num_features+1);
+        for (size_t j = 0; j < num_features; ++j)
+        {
+            for (size_t i = 0; i < num_instances; ++i)
+            {
+                if (arr(i, j) != 0)
+                {
+                    instances_.push_back(i);
+                    values_.push_back(arr(i, j));
+                }
+            }
+            column_begins_.push_back(instances_.size());
+        }
+    }
+
+    Shape2 const & shape() const
+    {
+        return shape_;
+    }
+
+    size_t size() const
+    {
+        return shape_[0]*shape_[1];
+    }
+
+    /// \brief Return the value of feature j of instance i (binary search in the column).
+    value_type operator()(size_t const i, size_t const j) const
+    {
+        auto const begin = begin_column_instances(j);
+        auto const end = end_column_instances(j);
+        auto const lower = std::lower_bound(begin, end, i);
+        if (lower == end || *lower != i)
+            return 0;
+        else
+            return values_[std::distance(instances_.begin(), lower)];
+    }
+
+    size_t count_nonzero() const
+    {
+        return instances_.size();
+    }
+
+    /// \brief Return the number of non-zero values of feature j.
+    size_t count_nonzero(size_t const j) const
+    {
+        return column_begins_[j+1] - column_begins_[j];
+    }
+
+    /// \brief Return the (increasing) indices of the instances with a non-zero value of feature j.
+    ConstIndexIter begin_column_instances(size_t const j) const
+    {
+        return instances_.begin() + column_begins_[j];
+    }
+
+    ConstIndexIter end_column_instances(size_t const j) const
+    {
+        return instances_.begin() + column_begins_[j+1];
+    }
+
+    /// \brief Return the non-zero values of feature j (in the order of begin_column_instances).
+    ConstValueIter begin_column_values(size_t const j) const
+    {
+        return values_.begin() + column_begins_[j];
+    }
+
+    ConstValueIter end_column_values(size_t const j) const
+    {
+        return values_.begin() + column_begins_[j+1];
+    }
+
+protected:
+
+    Shape2 shape_;
+    std::vector<size_t> column_begins_;
+    std::vector<size_t> instances_;
+    std::vector<value_type> values_;
+};
+
+
+
 template <typename T>
 class LabelGetter
 {
@@ -2,6 +2,7 @@
 #define VIGRA_JUNGLE_HXX
 
 #include <vigra/graphs.hxx> // for lemon::Invalid
+#include "dagraph.hxx" // for detail::PropertyMap
 #include <vector>
 #include <utility>
 #include <algorithm>
@@ -88,59 +89,6 @@ namespace detail
         return os << item.id();
     }
 
-    template <typename KEYTYPE, typename VALUETYPE, typename MAP = std::map<KEYTYPE, VALUETYPE> >
-    class PropertyMap
-    {
-    public:
-        typedef KEYTYPE key_type;
-        typedef VALUETYPE value_type;
-        typedef value_type & reference;
-        typedef value_type const & const_reference;
-        typedef MAP Map;
-        typedef typename Map::iterator iterator;
-        typedef typename Map::const_iterator const_iterator;
-        reference at(key_type const & k)
-        {
-            return map_.at(k);
-        }
-        const_reference at(key_type const & k) const
-        {
-            return map_.at(k);
-        }
-        reference operator[](key_type const & k)
-        {
-            return map_[k];
-        }
-        iterator begin()
-        {
-            return map_.begin();
-        }
-        const_iterator begin() const
-        {
-            return map_.begin();
-        }
-        iterator end()
-        {
-            return map_.end();
-        }
-        const_iterator end() const
-        {
-            return map_.end();
-        }
-        void clear()
-        {
-            map_.clear();
-        }
-        template <typename... ARGS>
-        std::pair<iterator, bool> emplace(ARGS &&... args)
-        {
-            return map_.emplace(std::forward<ARGS>(args)...);
-        }
-
-    protected:
-        Map map_;
-    };
-
     template <typename NODETYPE>
     class ForestIndexNode
     {
@@ -269,6 +217,12 @@ public:
     /// \brief Return the other child of the parent. Returns lemon::INVALID if node is a root node or if the parent only has one child.
     Node neighbor(Node const & node) const;
 
+    /// \brief Renumber the nodes breadth-first from the roots, so the erased nodes leave no holes and the nodes of one level are adjacent.
+    ///
+    /// Return a vector that maps each old node id to the new id (-1 for erased nodes). The arc ids follow the new node ids.
+    /// Node maps can be updated with remap_node_map().
+    std::vector<index_type> compact();
+
 protected:
 
     void makeLeaves() const;
@@ -700,6 +654,58 @@ inline BinaryTree::Node BinaryTree::neighbor(Node const & node) const
         return Node(left_id);
 }
 
+inline std::vector<BinaryTree::index_type> BinaryTree::compact()
+{
+    // Find the new order: breadth-first from each root (the roots in the order of their old ids).
+    std::vector<index_type> new_ids(nodes_.size(), -1);
+    std::vector<index_type> order;
+    order.reserve(num_nodes_);
+    for (size_t i = 0; i < nodes_.size(); ++i)
+    {
+        if (!valid(Node(i)) || nodes_[i].parent != -1)
+            continue;
+        new_ids[i] = order.size();
+        order.push_back(i);
+        for (size_t k = order.size()-1; k < order.size(); ++k)
+        {
+            NodeT const & n = nodes_[order[k]];
+            for (index_type const child : {n.left_child, n.right_child})
+            {
+                if (child != -1)
+                {
+                    new_ids[child] = order.size();
+                    order.push_back(child);
+                }
+            }
+        }
+    }
+    vigra_assert(order.size() == num_nodes_, "BinaryTree::compact(): Some nodes are not reachable from a root.");
+
+    // Copy the nodes to their new positions. The node list follows the new ids.
+    auto const new_id = [&new_ids](index_type id) -> index_type
+    {
+        return (id == -1) ? -1 : new_ids[id];
+    };
+    std::vector<NodeT> nodes(order.size());
+    for (size_t k = 0; k < order.size(); ++k)
+    {
+        NodeT const & old_node = nodes_[order[k]];
+        NodeT & n = nodes[k];
+        n.prev = static_cast<index_type>(k)-1;
+        n.next = (k+1 < order.size()) ? static_cast<index_type>(k+1) : -1;
+        n.parent = new_id(old_node.parent);
+        n.left_child = new_id(old_node.left_child);
+        n.right_child = new_id(old_node.right_child);
+        n.leaf_index = 0;
+    }
+    nodes_.swap(nodes);
+    first_node_ = nodes_.empty() ? -1 : 0;
+    first_free_node_ = -1;
+    root_changed_ = true;
+    leaves_changed_ = true;
+    return new_ids;
+}
+
 
 
 /// \brief Takes a vector of trees and provides the graph api.
@@ -4,6 +4,7 @@
 #include <vigra/multi_array.hxx>
 #include <vigra/random.hxx>
 #include <type_traits>
+#include <iterator>
 
 namespace vigra
 {
@@ -19,6 +20,10 @@ namespace detail
 
         typedef ARRAY Array;
         typedef typename Array::value_type value_type;
+        typedef std::input_iterator_tag iterator_category;
+        typedef std::ptrdiff_t difference_type;
+        typedef value_type const * pointer;
+        typedef value_type const & reference;
 
         LineView1DIter(
                 Array const & arr,
@@ -31,6 +36,7 @@ namespace detail
         LineView1DIter & operator++()
         {
             ++i_;
+            return *this;
         }
 
         value_type const & operator*() const
@@ -64,6 +70,10 @@ namespace detail
 
         typedef ARRAY Array;
         typedef typename Array::value_type value_type;
+        typedef std::input_iterator_tag iterator_category;
+        typedef std::ptrdiff_t difference_type;
+        typedef value_type const * pointer;
+        typedef value_type const & reference;
 
         LineView2DIter(
                 Array const & arr,
@@ -82,6 +92,7 @@ namespace detail
                 i_ = 0;
                 ++j_;
             }
+            return *this;
         }
 
         value_type const & operator*() const
@@ -0,0 +1,282 @@
+#ifndef VIGRA_MULTIPROCESS_HXX
+#define VIGRA_MULTIPROCESS_HXX
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <functional>
+#include <cerrno>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <vigra/error.hxx>
+
+namespace vigra
+{
+
+namespace detail
+{
+
+    /// \brief Write all bytes to the file descriptor.
+    inline bool write_all(int fd, char const * data, size_t n)
+    {
+        while (n > 0)
+        {
+            ssize_t const k = ::write(fd, data, n);
+            if (k < 0 && errno == EINTR)
+                continue;
+            if (k <= 0)
+                return false;
+            data += k;
+            n -= k;
+        }
+        return true;
+    }
+
+    /// \brief Read from the file descriptor until the end of file.
+    inline bool read_all(int fd, std::string & data)
+    {
+        char buffer[65536];
+        while (true)
+        {
+            ssize_t const k = ::read(fd, buffer, sizeof(buffer));
+            if (k < 0 && errno == EINTR)
+                continue;
+            if (k < 0)
+                return false;
+            if (k == 0)
+                return true;
+            data.append(buffer, k);
+        }
+    }
+
+} // namespace detail
+
+
+
+/// \brief File-backed memory segment that can be mapped by several processes.
+///
+/// The creator writes the data and removes the file when the segment is destroyed,
+/// other processes open the file by its path and map it read-only.
+/// Put the file in /dev/shm to keep the segment in memory.
+class SharedMemorySegment
+{
+public:
+
+    SharedMemorySegment()
+        : data_(nullptr),
+          size_(0),
+          owner_(false)
+    {}
+
+    SharedMemorySegment(SharedMemorySegment const &) = delete;
+    SharedMemorySegment & operator=(SharedMemorySegment const &) = delete;
+
+    ~SharedMemorySegment()
+    {
+        close();
+    }
+
+    /// \brief Create a new file with a unique name from the given directory and map it writable.
+    void create(std::string const & directory, size_t size);
+
+    /// \brief Map an existing segment read-only.
+    void open(std::string const & path);
+
+    /// \brief Unmap the segment (and remove the file if it was created by this object).
+    void close();
+
+    /// \brief Return the path of the file.
+    std::string const & path() const
+    {
+        return path_;
+    }
+
+    /// \brief Return a pointer to the mapped memory.
+    char * data()
+    {
+        return data_;
+    }
+
+    /// \brief Return a pointer to the mapped memory (const version).
+    char const * data() const
+    {
+        return data_;
+    }
+
+    /// \brief Return the size of the segment in bytes.
+    size_t size() const
+    {
+        return size_;
+    }
+
+protected:
+
+    /// \brief Map the file with the given protection.
+    void map(int fd, int protection);
+
+    std::string path_;
+    char * data_;
+    size_t size_;
+    bool owner_;
+};
+
+inline void SharedMemorySegment::create(
+        std::string const & directory,
+        size_t const size
+){
+    close();
+    std::vector<char> path(directory.begin(), directory.end());
+    std::string const name = "/vigra_segment_XXXXXX";
+    path.insert(path.end(), name.begin(), name.end());
+    path.push_back('\0');
+    int const fd = ::mkstemp(path.data());
+    vigra_precondition(fd != -1, "SharedMemorySegment::create(): Could not create the file.");
+    path_ = path.data();
+    owner_ = true;
+    if (::ftruncate(fd, size) != 0)
+    {
+        ::close(fd);
+        close();
+        vigra_fail("SharedMemorySegment::create(): Could not resize the file.");
+    }
+    size_ = size;
+    map(fd, PROT_READ | PROT_WRITE);
+}
+
+inline void SharedMemorySegment::open(
+        std::string const & path
+){
+    close();
+    int const fd = ::open(path.c_str(), O_RDONLY);
+    vigra_precondition(fd != -1, "SharedMemorySegment::open(): Could not open the file.");
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        vigra_fail("SharedMemorySegment::open(): Could not read the file size.");
+    }
+    path_ = path;
+    size_ = st.st_size;
+    map(fd, PROT_READ);
+}
+
+inline void SharedMemorySegment::close()
+{
+    if (data_ != nullptr)
+        ::munmap(data_, size_);
+    if (owner_)
+        ::unlink(path_.c_str());
+    path_.clear();
+    data_ = nullptr;
+    size_ = 0;
+    owner_ = false;
+}
+
+inline void SharedMemorySegment::map(
+        int const fd,
+        int const protection
+){
+    if (size_ > 0)
+    {
+        void * const p = ::mmap(nullptr, size_, protection, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            ::close(fd);
+            close();
+            vigra_fail("SharedMemorySegment::map(): Could not map the file.");
+        }
+        data_ = static_cast<char *>(p);
+    }
+    ::close(fd);
+}
+
+
+
+/// \brief Fork num_processes local worker processes, call f(p, os) in worker p and return the data that each worker wrote to os.
+///
+/// The output of each worker is sent back through a pipe. The coordinator waits for all workers,
+/// and if a worker throws or dies, the function fails after all workers were collected.
+/// \note The workers are forked from the calling thread, so f must not rely on other threads of the coordinator.
+inline std::vector<std::string> run_worker_processes(
+        size_t const num_processes,
+        std::function<void(size_t, std::ostream &)> const & f
+){
+    std::vector<pid_t> pids(num_processes, -1);
+    std::vector<int> fds(num_processes, -1);
+    bool ok = true;
+    for (size_t p = 0; p < num_processes && ok; ++p)
+    {
+        int pipe_fds[2];
+        if (::pipe(pipe_fds) != 0)
+        {
+            ok = false;
+            break;
+        }
+        pid_t const pid = ::fork();
+        if (pid == 0)
+        {
+            // Worker: Run the task and write the result to the pipe. Never return to the caller.
+            ::close(pipe_fds[0]);
+            int status = EXIT_SUCCESS;
+            try
+            {
+                std::ostringstream os;
+                f(p, os);
+                std::string const data = os.str();
+                if (!detail::write_all(pipe_fds[1], data.data(), data.size()))
+                    status = EXIT_FAILURE;
+            }
+            catch (...)
+            {
+                status = EXIT_FAILURE;
+            }
+            ::close(pipe_fds[1]);
+            ::_exit(status);
+        }
+        ::close(pipe_fds[1]);
+        if (pid < 0)
+        {
+            ::close(pipe_fds[0]);
+            ok = false;
+            break;
+        }
+        pids[p] = pid;
+        fds[p] = pipe_fds[0];
+    }
+
+    // Collect the results. Reading the pipes one after another is fine, since a blocked worker only waits for the coordinator.
+    std::vector<std::string> results(num_processes);
+    for (size_t p = 0; p < num_processes; ++p)
+    {
+        if (pids[p] < 0)
+            continue;
+        if (!detail::read_all(fds[p], results[p]))
+            ok = false;
+        ::close(fds[p]);
+        int status;
+        while (::waitpid(pids[p], &status, 0) < 0)
+        {
+            if (errno != EINTR)
+            {
+                status = -1;
+                break;
+            }
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+            ok = false;
+    }
+    vigra_precondition(ok, "run_worker_processes(): A worker process failed.");
+    return results;
+}
+
+
+
+} // namespace vigra
+
+#endif // VIGRA_MULTIPROCESS_HXX
@@ -0,0 +1,64 @@
+#ifndef VIGRA_PARALLEL_HXX
+#define VIGRA_PARALLEL_HXX
+
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+namespace vigra
+{
+
+namespace detail
+{
+
+    /// \brief Return the number of workers for the given number of threads (-1: use all cores).
+    inline size_t num_workers(int num_threads)
+    {
+        if (num_threads == -1)
+            num_threads = std::thread::hardware_concurrency(); // might return 0 if the value is not computable
+        return std::max(1, num_threads);
+    }
+
+    /// \brief Call f(k) for all k in [0, n), distributed over num_threads threads (-1: use all cores).
+    template <typename FUNCTOR>
+    void parallel_for(size_t const n, int num_threads, FUNCTOR const & f)
+    {
+        if (num_threads == -1)
+            num_threads = std::thread::hardware_concurrency(); // might return 0 if the value is not computable
+        if (num_threads <= 1 || n <= 1)
+        {
+            // Single thread.
+            for (size_t k = 0; k < n; ++k)
+            {
+                f(k);
+            }
+            return;
+        }
+
+        // Create one worker per thread and let each worker handle every num_threads-th index.
+        size_t const num_workers = std::min(static_cast<size_t>(num_threads), n);
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < num_workers; ++t)
+        {
+            workers.push_back(std::thread(
+                    [& f, n, num_workers](size_t t)
+                    {
+                        for (size_t k = t; k < n; k += num_workers)
+                        {
+                            f(k);
+                        }
+                    },
+                    t
+            ));
+        }
+        for (auto & w : workers)
+        {
+            w.join();
+        }
+    }
+
+} // namespace detail
+
+} // namespace vigra
+
+#endif // VIGRA_PARALLEL_HXX
@@ -10,10 +10,20 @@
 #include <stack>
 #include <fstream>
 #include <queue>
-
-//#include "dagraph.hxx"
+#include <numeric>
+#include <cmath>
+#include <algorithm>
+#include <tuple>
+#include <array>
+#include <cstring>
+#include <sstream>
+#include <bitset>
+#include <iterator>
+
+#include "dagraph.hxx"
 #include "jungle.hxx"
 #include "feature_getter.hxx"
+#include "parallel.hxx"
 #include "svm.hxx"
 
 
@@ -40,6 +50,106 @@ namespace detail
         FeatureType thresh;
     };
 
+    /// \brief The best split of one node of a level (see LevelwiseSplit).
+    template <typename FEATURETYPE>
+    struct LevelSplitResult
+    {
+    public:
+        typedef FEATURETYPE FeatureType;
+        bool split_found;
+        Split<FeatureType> split;
+        double impurity_decrease;
+    };
+
+    /// \brief Map a floating point value to an unsigned integer with the same order (for radix sort).
+    inline UInt32 radix_key(float const v)
+    {
+        UInt32 u;
+        std::memcpy(&u, &v, sizeof(u));
+        return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+    }
+
+    /// \brief Map a floating point value to an unsigned integer with the same order (for radix sort).
+    inline UInt64 radix_key(double const v)
+    {
+        UInt64 u;
+        std::memcpy(&u, &v, sizeof(u));
+        return (u & 0x8000000000000000ull) ? ~u : (u | 0x8000000000000000ull);
+    }
+
+    /// \brief Map an integer to an unsigned integer with the same order (for radix sort).
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value, UInt64>::type radix_key(T const v)
+    {
+        return std::is_signed<T>::value ? static_cast<UInt64>(static_cast<Int64>(v)) ^ 0x8000000000000000ull
+                                        : static_cast<UInt64>(v);
+    }
+
+    /// \brief Feature value, label and weight of an instance in the split search buffer.
+    template <typename FEATURETYPE>
+    struct SplitBufferItem
+    {
+        typedef decltype(radix_key(FEATURETYPE())) KeyType;
+        KeyType key;
+        FEATURETYPE value;
+        size_t label;
+        double weight;
+    };
+
+    /// \brief Sort the items by their key using a stable LSD radix sort on the bytes of the key.
+    ///
+    /// Bytes that are equal for all items are skipped, small inputs are sorted with std::stable_sort.
+    /// \param tmp: buffer of the same item type, it is resized as needed
+    template <typename ITEM>
+    void radix_sort(std::vector<ITEM> & items, std::vector<ITEM> & tmp)
+    {
+        typedef typename ITEM::KeyType KeyType;
+        size_t const num_bytes = sizeof(KeyType);
+        size_t const n = items.size();
+        if (n < 64)
+        {
+            std::stable_sort(items.begin(), items.end(),
+                    [](ITEM const & a, ITEM const & b)
+                    {
+                        return a.key < b.key;
+                    }
+            );
+            return;
+        }
+
+        // Count the values of all bytes in a single pass.
+        std::array<size_t, 256*sizeof(KeyType)> counts;
+        counts.fill(0);
+        for (auto const & item : items)
+        {
+            for (size_t b = 0; b < num_bytes; ++b)
+            {
+                ++counts[b*256 + ((item.key >> (8*b)) & 0xFF)];
+            }
+        }
+
+        // Scatter the items byte by byte.
+        tmp.resize(n);
+        for (size_t b = 0; b < num_bytes; ++b)
+        {
+            size_t * const c = &counts[b*256];
+            if (std::any_of(c, c+256, [n](size_t x) { return x == n; }))
+                continue;
+            size_t offset = 0;
+            for (size_t v = 0; v < 256; ++v)
+            {
+                size_t const count = c[v];
+                c[v] = offset;
+                offset += count;
+            }
+            for (auto const & item : items)
+            {
+                tmp[c[(item.key >> (8*b)) & 0xFF]++] = item;
+            }
+            items.swap(tmp);
+        }
+    }
+
     /// \brief Draw n samples from [begin, end) with replacement.
     template <typename ITER, typename OUTITER>
     void sample_with_replacement(size_t n, ITER begin, ITER end, OUTITER out)
@@ -72,6 +182,43 @@ namespace detail
         }
     }
 
+    /// \brief Draw a Poisson distributed number with the given mean (Knuth's method, meant for small means).
+    template <typename RANDENGINE>
+    size_t poisson_sample(double const mean, RANDENGINE const & randengine)
+    {
+        double const l = std::exp(-mean);
+        size_t k = 0;
+        double p = randengine.uniform();
+        while (p > l)
+        {
+            ++k;
+            p *= randengine.uniform();
+        }
+        return k;
+    }
+
+    /// \brief Draw a random number from a binomial distribution with n trials and success probability p.
+    ///
+    /// The cumulative distribution is walked by inversion, so the expected number of steps is the mean n*p.
+    template <typename RANDENGINE>
+    size_t binomial_sample(size_t const n, double const p, RANDENGINE const & randengine)
+    {
+        if (p >= 1.)
+            return n;
+        double const q = p / (1.-p);
+        double prob = std::pow(1.-p, static_cast<double>(n));
+        double cdf = prob;
+        double const u = randengine.uniform();
+        size_t k = 0;
+        while (u > cdf && k < n)
+        {
+            prob *= q * (n-k) / (k+1);
+            ++k;
+            cdf += prob;
+        }
+        return k;
+    }
+
 //    /// \brief Compute the gini impurity.
 //    /// \param labels_left: Label counts of the left child.
 //    /// \param label_priors: Total label count.
@@ -106,10 +253,167 @@ namespace detail
 //        return n_left*gini_left + n_right*gini_right;
 //    }
 
+    /// \brief Write the raw bytes of a trivially copyable value to the stream.
+    template <typename T>
+    void write_binary(std::ostream & os, T const & value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "write_binary(): The type must be trivially copyable.");
+        os.write(reinterpret_cast<char const *>(&value), sizeof(T));
+    }
+
+    /// \brief Read the raw bytes of a trivially copyable value from the stream.
+    template <typename T>
+    void read_binary(std::istream & is, T & value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "read_binary(): The type must be trivially copyable.");
+        is.read(reinterpret_cast<char *>(&value), sizeof(T));
+        vigra_precondition(static_cast<bool>(is), "read_binary(): Unexpected end of stream.");
+    }
+
+    /// \brief Write the size and the elements of a vector to the stream.
+    template <typename T>
+    void write_binary(std::ostream & os, std::vector<T> const & v)
+    {
+        write_binary(os, static_cast<UInt64>(v.size()));
+        for (auto const & x : v)
+        {
+            write_binary(os, static_cast<T>(x));
+        }
+    }
+
+    /// \brief Read a vector that was written with write_binary.
+    template <typename T>
+    void read_binary(std::istream & is, std::vector<T> & v)
+    {
+        UInt64 n;
+        read_binary(is, n);
+        v.resize(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            T x;
+            read_binary(is, x);
+            v[i] = x;
+        }
+    }
+
+    /// \brief Write the number of entries and the (node id, value) pairs of a node map to the stream.
+    template <typename NODEMAP>
+    void write_node_map(std::ostream & os, NODEMAP const & m)
+    {
+        write_binary(os, static_cast<UInt64>(std::distance(m.begin(), m.end())));
+        for (auto const & p : m)
+        {
+            write_binary(os, static_cast<Int64>(p.first.id()));
+            write_binary(os, p.second);
+        }
+    }
+
+    /// \brief Read a node map that was written with write_node_map.
+    template <typename NODEMAP>
+    void read_node_map(std::istream & is, NODEMAP & m)
+    {
+        typedef typename NODEMAP::key_type Node;
+        m.clear();
+        UInt64 n;
+        read_binary(is, n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            Int64 id;
+            read_binary(is, id);
+            read_binary(is, m[Node(id)]);
+        }
+    }
+
 } // namespace detail
 
 
 
+/// \brief The instance weights of a bootstrap sample.
+///
+/// The bootstrap counts are stored as integers in the order of the (sorted) in-bag instances. A bitset of the in-bag
+/// instances with a rank directory finds the count of an instance in constant time, so the sample takes four bytes
+/// per in-bag instance (and a quarter byte per instance) instead of a double per instance.
+/// The weight of an instance (its count times its optional sample weight) is only computed when it is looked up.
+class BootstrapWeights
+{
+public:
+
+    typedef UInt32 CountType;
+
+    BootstrapWeights()
+        : sample_weights_(nullptr)
+    {}
+
+    /// \brief Remove all in-bag instances.
+    /// \param sample_weights: optional sample weights (one per instance), they are not copied and must outlive this object
+    void reset(size_t const num_instances, std::vector<double> const * sample_weights = nullptr)
+    {
+        vigra_precondition(sample_weights == nullptr || sample_weights->size() == num_instances,
+                           "BootstrapWeights::reset(): Wrong number of sample weights.");
+        bits_.assign((num_instances + 63) / 64, 0);
+        ranks_.assign(bits_.size(), 0);
+        counts_.clear();
+        sample_weights_ = sample_weights;
+    }
+
+    /// \brief Add an in-bag instance with the given (non-zero) count. The instances must be added in increasing order.
+    void push_back(size_t const instance, CountType const count)
+    {
+        size_t const block = instance / 64;
+        vigra_assert(count > 0 && block < bits_.size() && (bits_[block] >> (instance % 64)) == 0,
+                     "BootstrapWeights::push_back(): The instances must be added in increasing order.");
+        if (bits_[block] == 0)
+            ranks_[block] = counts_.size();
+        bits_[block] |= UInt64(1) << (instance % 64);
+        counts_.push_back(count);
+    }
+
+    /// \brief Return the bootstrap count of the given instance (zero for out-of-bag instances).
+    CountType count(size_t const instance) const
+    {
+        size_t const block = instance / 64;
+        UInt64 const bit = UInt64(1) << (instance % 64);
+        if ((bits_[block] & bit) == 0)
+            return 0;
+        return counts_[ranks_[block] + std::bitset<64>(bits_[block] & (bit-1)).count()];
+    }
+
+    /// \brief Return the weight of the given instance (zero for out-of-bag instances).
+    double operator[](size_t const instance) const
+    {
+        double const c = count(instance);
+        return sample_weights_ == nullptr ? c : c * (*sample_weights_)[instance];
+    }
+
+    /// \brief Return the number of in-bag instances.
+    size_t num_inbag() const
+    {
+        return counts_.size();
+    }
+
+protected:
+
+    /// \brief Bit i is set if instance i is in-bag.
+    std::vector<UInt64> bits_;
+
+    /// \brief The number of in-bag instances before each block of the bitset.
+    std::vector<size_t> ranks_;
+
+    /// \brief The bootstrap counts of the in-bag instances.
+    std::vector<CountType> counts_;
+
+    /// \brief The optional sample weights.
+    std::vector<double> const * sample_weights_;
+};
+
+
+
+/// \brief Draws the bootstrap sample of a tree as per-instance integer counts instead of a vector with duplicate indices.
+///
+/// Multinomial: Draw ratio*num_instances instances with replacement (the classic bootstrap). The count of each instance
+/// is drawn in order from the binomial distribution of the remaining draws, so no per-instance count array is needed.
+/// Poisson: Draw the count of each instance independently from a Poisson distribution with mean ratio.
+/// The counts are multiplied with the (optional, non-negative) sample weights.
 class BootstrapSampler
 {
 
@@ -118,15 +422,60 @@ public:
     typedef std::vector<size_t>::iterator iterator;
     typedef std::vector<size_t>::const_iterator const_iterator;
 
+    enum Mode
+    {
+        Multinomial,
+        Poisson
+    };
+
+    BootstrapSampler(
+            Mode const mode = Multinomial,
+            double const ratio = 1.,
+            std::vector<double> const & sample_weights = std::vector<double>()
+    )   : mode_(mode),
+          ratio_(ratio),
+          sample_weights_(sample_weights)
+    {
+        vigra_precondition(ratio_ > 0, "BootstrapSampler(): The sample ratio must be greater than zero.");
+        for (double const w : sample_weights_)
+            vigra_precondition(w >= 0, "BootstrapSampler(): The sample weights must not be negative.");
+    }
+
     /// \brief Create a bootstrap sample.
+    /// \param instances[out]: the (sorted) instances with non-zero weight
+    /// \param weights[out]: the weight of each instance (zero for out-of-bag instances), it refers to the sample weights of this sampler
     template <typename RANDENGINE>
-    std::vector<size_t> bootstrap_sample(size_t num_instances, RANDENGINE const & randengine) const
-    {
-        UniformIntRandomFunctor<RANDENGINE> rand(randengine);
-        std::vector<size_t> v(num_instances);
-        for (size_t i = 0; i < v.size(); ++i)
-            v[i] = rand(num_instances);
-        return v;
+    void bootstrap_sample(
+            size_t const num_instances,
+            RANDENGINE const & randengine,
+            std::vector<size_t> & instances,
+            BootstrapWeights & weights
+    ) const {
+        vigra_precondition(sample_weights_.empty() || sample_weights_.size() == num_instances,
+                           "BootstrapSampler::bootstrap_sample(): Wrong number of sample weights.");
+
+        // Draw the count of each instance and keep the instances with non-zero weight.
+        instances.clear();
+        weights.reset(num_instances, sample_weights_.empty() ? nullptr : &sample_weights_);
+        size_t remaining = std::max(static_cast<size_t>(1), static_cast<size_t>(std::round(ratio_ * num_instances)));
+        for (size_t i = 0; i < num_instances; ++i)
+        {
+            size_t count;
+            if (mode_ == Multinomial)
+            {
+                count = detail::binomial_sample(remaining, 1. / (num_instances-i), randengine);
+                remaining -= count;
+            }
+            else
+            {
+                count = detail::poisson_sample(ratio_, randengine);
+            }
+            if (count > 0 && (sample_weights_.empty() || sample_weights_[i] > 0))
+            {
+                instances.push_back(i);
+                weights.push_back(i, static_cast<BootstrapWeights::CountType>(count));
+            }
+        }
     }
 
     /// \brief Return all of the given instances (hence do nothing).
@@ -137,22 +486,72 @@ public:
 
 protected:
 
-    std::vector<size_t> instances_;
+    Mode mode_;
+
+    double ratio_;
+
+    std::vector<double> sample_weights_;
+
+};
+
+
 
+/// \brief Base class for the termination criteria. It never stops and accepts every split.
+///
+/// The termination criterion is queried while a tree is grown:
+/// stop() is called before the split search of a node, min_leaf_size() restricts the
+/// split search and reject_split() is called with the best split that was found.
+/// If max_leaves() is restricted, the tree is grown best-first, so the nodes with the
+/// largest impurity decrease are split first.
+/// Instance numbers refer to the distinct instances of a node, regardless of their bootstrap weights.
+class TerminationBase
+{
+public:
+    /// \brief Return true if the node with the given instances must not be split.
+    template <typename ITER, typename LABELS>
+    bool stop(ITER /*begin*/, ITER /*end*/, LABELS const & /*labels*/, size_t /*depth*/) const
+    {
+        return false;
+    }
+
+    /// \brief Return true if the split that was found for a node must not be applied.
+    bool reject_split(size_t /*depth*/, size_t /*num_left*/, size_t /*num_right*/, double /*impurity_decrease*/) const
+    {
+        return false;
+    }
+
+    /// \brief Return the minimum number of instances in each child of a split.
+    size_t min_leaf_size() const
+    {
+        return 1;
+    }
+
+    /// \brief Return the maximum number of leaves of a tree.
+    size_t max_leaves() const
+    {
+        return std::numeric_limits<size_t>::max();
+    }
+
+    /// \brief Return the maximum depth of a tree (the root node has depth 0).
+    size_t max_depth() const
+    {
+        return std::numeric_limits<size_t>::max();
+    }
 };
 
 
 
-class PurityTermination
+/// \brief Stop if all instances of the node have the same label.
+class PurityTermination : public TerminationBase
 {
 public:
     template <typename ITER, typename LABELS>
-    bool stop(ITER begin, ITER end, LABELS const & labels, typename LABELS::value_type & first_label) const
+    bool stop(ITER begin, ITER end, LABELS const & labels, size_t /*depth*/) const
     {
         if (std::distance(begin, end) < 2)
             return true;
 
-        first_label = labels(*begin);
+        auto const first_label = labels(*begin);
         ++begin;
         while (begin != end)
         {
@@ -166,15 +565,179 @@ public:
 
 
 
+/// \brief Stop if the node has reached the given depth (the root node has depth 0).
+class MaxDepthTermination : public TerminationBase
+{
+public:
+    MaxDepthTermination(size_t const max_depth = std::numeric_limits<size_t>::max())
+        : max_depth_(max_depth)
+    {}
+
+    template <typename ITER, typename LABELS>
+    bool stop(ITER /*begin*/, ITER /*end*/, LABELS const & /*labels*/, size_t depth) const
+    {
+        return depth >= max_depth_;
+    }
+
+    size_t max_depth() const
+    {
+        return max_depth_;
+    }
+
+protected:
+    size_t max_depth_;
+};
+
+
+
+/// \brief Stop if the node has less than min_split_size instances and only consider splits with at least min_leaf_size instances per child.
+class MinSamplesTermination : public TerminationBase
+{
+public:
+    MinSamplesTermination(size_t const min_split_size = 2, size_t const min_leaf_size = 1)
+        : min_split_size_(min_split_size),
+          min_leaf_size_(min_leaf_size)
+    {
+        vigra_precondition(min_leaf_size_ > 0,
+                           "MinSamplesTermination(): The minimum leaf size must be greater than zero.");
+    }
+
+    template <typename ITER, typename LABELS>
+    bool stop(ITER begin, ITER end, LABELS const & /*labels*/, size_t /*depth*/) const
+    {
+        size_t const num_instances = std::distance(begin, end);
+        return num_instances < min_split_size_ || num_instances < 2*min_leaf_size_;
+    }
+
+    bool reject_split(size_t /*depth*/, size_t num_left, size_t num_right, double /*impurity_decrease*/) const
+    {
+        return num_left < min_leaf_size_ || num_right < min_leaf_size_;
+    }
+
+    size_t min_leaf_size() const
+    {
+        return min_leaf_size_;
+    }
+
+protected:
+    size_t min_split_size_;
+    size_t min_leaf_size_;
+};
+
+
+
+/// \brief Reject splits whose weighted impurity decrease is less than the given value.
+///
+/// The decrease is N_t/N * (node impurity minus the instance-weighted child impurities), where N_t is the weight
+/// of the node and N the weight of the root node, so a large node needs a smaller impurity decrease than a small one.
+class MinImpurityDecreaseTermination : public TerminationBase
+{
+public:
+    MinImpurityDecreaseTermination(double const min_decrease = 0.)
+        : min_decrease_(min_decrease)
+    {}
+
+    bool reject_split(size_t /*depth*/, size_t /*num_left*/, size_t /*num_right*/, double impurity_decrease) const
+    {
+        return impurity_decrease < min_decrease_;
+    }
+
+protected:
+    double min_decrease_;
+};
+
+
+
+/// \brief Restrict the number of leaves. The tree is grown best-first until the number of leaves is reached.
+class MaxLeavesTermination : public TerminationBase
+{
+public:
+    MaxLeavesTermination(size_t const max_leaves = std::numeric_limits<size_t>::max())
+        : max_leaves_(max_leaves)
+    {
+        vigra_precondition(max_leaves_ > 0,
+                           "MaxLeavesTermination(): The maximum number of leaves must be greater than zero.");
+    }
+
+    size_t max_leaves() const
+    {
+        return max_leaves_;
+    }
+
+protected:
+    size_t max_leaves_;
+};
+
+
+
+/// \brief Combination of termination criteria. A node is terminal if any of the criteria says so.
+///
+/// Example: CombinedTermination<PurityTermination, MaxDepthTermination> term(PurityTermination(), MaxDepthTermination(10));
+template <typename... TERMINATIONS>
+class CombinedTermination;
+
+template <>
+class CombinedTermination<> : public TerminationBase
+{};
+
+template <typename FIRST, typename... REST>
+class CombinedTermination<FIRST, REST...>
+{
+public:
+    CombinedTermination()
+        : first_(),
+          rest_()
+    {}
+
+    CombinedTermination(FIRST const & first, REST const &... rest)
+        : first_(first),
+          rest_(rest...)
+    {}
+
+    template <typename ITER, typename LABELS>
+    bool stop(ITER begin, ITER end, LABELS const & labels, size_t depth) const
+    {
+        return first_.stop(begin, end, labels, depth) || rest_.stop(begin, end, labels, depth);
+    }
+
+    bool reject_split(size_t depth, size_t num_left, size_t num_right, double impurity_decrease) const
+    {
+        return first_.reject_split(depth, num_left, num_right, impurity_decrease) ||
+               rest_.reject_split(depth, num_left, num_right, impurity_decrease);
+    }
+
+    size_t min_leaf_size() const
+    {
+        return std::max(first_.min_leaf_size(), rest_.min_leaf_size());
+    }
+
+    size_t max_leaves() const
+    {
+        return std::min(first_.max_leaves(), rest_.max_leaves());
+    }
+
+    size_t max_depth() const
+    {
+        return std::min(first_.max_depth(), rest_.max_depth());
+    }
+
+protected:
+    FIRST first_;
+    CombinedTermination<REST...> rest_;
+};
+
+
+
 class GiniScorer
 {
 public:
 
-    template <typename LABELS, typename ITER>
-    GiniScorer(LABELS const & labels, size_t const num_labels, ITER begin, ITER end)
+    /// \brief Initialize the prior label counts, where each instance i is counted with weights[i].
+    template <typename LABELS, typename WEIGHTS, typename ITER>
+    GiniScorer(LABELS const & labels, WEIGHTS const & weights, size_t const num_labels, ITER begin, ITER end)
         : labels_prior_(num_labels),
           labels_left_(num_labels),
-          n_total_(std::distance(begin, end)),
+          n_total_(0),
           n_left_(0)
     {
         for (auto it = begin; it != end; ++it)
@@ -182,16 +745,17 @@ public:
             size_t label = labels(*it);
             if (label >= labels_prior_.size())
                 vigra_fail("GiniScorer(): Max label is larger than expected.");
-            ++labels_prior_[label];
+            labels_prior_[label] += weights[*it];
+            n_total_ += weights[*it];
         }
     }
 
-    void add_left(size_t label)
+    void add_left(size_t label, double weight = 1.)
     {
         if (label >= labels_left_.size())
             vigra_fail("GiniScorer::add_left(): Label is larger than expected.");
-        ++labels_left_[label];
-        ++n_left_;
+        labels_left_[label] += weight;
+        n_left_ += weight;
     }
 
     void clear_left()
@@ -200,9 +764,15 @@ public:
         n_left_ = 0;
     }
 
+    /// \brief Return the total weight of the instances.
+    double total_weight() const
+    {
+        return n_total_;
+    }
+
     double operator()() const {
-        double const n_left = static_cast<double>(n_left_);
-        double const n_right = static_cast<double>(n_total_ - n_left_);
+        double const n_left = n_left_;
+        double const n_right = n_total_ - n_left_;
         double gini_left = 1;
         double gini_right = 1;
         for (size_t i = 0; i < labels_left_.size(); ++i)
@@ -215,87 +785,327 @@ public:
         return n_left*gini_left + n_right*gini_right;
     }
 
-protected:
+    /// \brief Return the score of a node with the given (weighted) label counts, in the same scale as operator().
+    static double node_score(std::vector<double> const & counts)
+    {
+        double const n_total = std::accumulate(counts.begin(), counts.end(), 0.);
+        if (n_total <= 0)
+            return 0.;
+        double gini = 1;
+        for (size_t i = 0; i < counts.size(); ++i)
+        {
+            double const p = counts[i] / n_total;
+            gini -= (p*p);
+        }
+        return n_total*gini;
+    }
+
+    /// \brief Return the score of the unsplit node (so the impurity decrease of a split is prior_score()-operator()).
+    double prior_score() const {
+        double const n_total = n_total_;
+        double gini = 1;
+        for (size_t i = 0; i < labels_prior_.size(); ++i)
+        {
+            double const p = labels_prior_[i] / n_total;
+            gini -= (p*p);
+        }
+        return n_total*gini;
+    }
 
-    std::vector<size_t> labels_prior_;
-    std::vector<size_t> labels_left_;
-    size_t const n_total_;
-    size_t n_left_;
+protected:
+
+    std::vector<double> labels_prior_;
+    std::vector<double> labels_left_;
+    double n_total_;
+    double n_left_;
 };
 
 
 
+namespace detail
+{
+
+    /// \brief Base class of the split functors that search a random subset of the features.
+    class FeatureSubsetSplitBase
+    {
+    public:
+
+        /// \param num_candidates: number of random features that are considered per split (0: ceil(sqrt(num_features)))
+        FeatureSubsetSplitBase(size_t const num_candidates = 0)
+            : num_candidates_(num_candidates)
+        {}
+
+        /// \brief Return the number of random features that are considered per split.
+        size_t num_candidate_features(size_t const num_features) const
+        {
+            if (num_candidates_ == 0)
+                return std::ceil(std::sqrt(num_features));
+            else
+                return std::min(num_candidates_, num_features);
+        }
+
+    protected:
+
+        /// \brief Draw a random feature subset by a partial Fisher-Yates shuffle of 0, 1, ..., num_features-1.
+        /// \param feat_indices[out]: the first num_candidate_features(num_features) entries are the candidate features
+        /// \return the number of candidate features
+        template <typename RANDENGINE>
+        size_t draw_candidate_features(
+                size_t const num_features,
+                RANDENGINE const & randengine,
+                std::vector<size_t> & feat_indices
+        ) const {
+            UniformIntRandomFunctor<RANDENGINE> rand(randengine);
+            size_t const num_feats = num_candidate_features(num_features);
+            feat_indices.resize(num_features);
+            std::iota(feat_indices.begin(), feat_indices.end(), 0);
+            for (size_t i = 0; i < num_feats; ++i)
+            {
+                size_t j = i + (rand(num_features-i));
+                std::swap(feat_indices[i], feat_indices[j]);
+            }
+            return num_feats;
+        }
+
+        size_t num_candidates_;
+    };
+
+} // namespace detail
+
+
+
 template <typename SCORER>
-class RandomSplit
+class RandomSplit : public detail::FeatureSubsetSplitBase
 {
 public:
 
-    /// \todo Add doc comment.
-    template <typename ITER, typename FEATURES, typename LABELS, typename RANDENGINE>
+    /// \param num_candidates: number of random features that are considered per split (0: ceil(sqrt(num_features)))
+    RandomSplit(size_t const num_candidates = 0)
+        : detail::FeatureSubsetSplitBase(num_candidates)
+    {}
+
+    /// \brief Find the best split of the given instances on a random feature subset and partition the instances accordingly.
+    /// \param weights: weights[i] is the (bootstrap) weight of instance i
+    /// \param impurity_decrease[out]: weighted impurity decrease (node weight times node impurity minus the weighted child impurities),
+    /// so the decreases of different nodes are comparable
+    /// \param min_leaf_size: only consider splits with at least this number of (distinct) instances on both sides
+    template <typename ITER, typename FEATURES, typename LABELS, typename WEIGHTS, typename RANDENGINE>
     bool split(
             ITER const inst_begin,
             ITER const inst_end,
             FEATURES const & features,
             LABELS const & labels,
+            WEIGHTS const & weights,
             size_t const num_labels,
             RANDENGINE const & randengine,
             size_t & best_feat,
             typename FEATURES::value_type & best_split,
-            ITER & split_iter
+            ITER & split_iter,
+            double & impurity_decrease,
+            size_t const min_leaf_size = 1
     ) const {
-        auto const num_instances = std::distance(inst_begin, inst_end);
+        size_t const num_instances = std::distance(inst_begin, inst_end);
         auto const num_features = features.shape()[1];
 
         // Get a random subset of the features.
-        UniformIntRandomFunctor<RANDENGINE> rand(randengine);
-        size_t const num_feats = std::ceil(std::sqrt(num_features));
-        std::vector<size_t> all_feat_indices(num_features);
-        std::iota(all_feat_indices.begin(), all_feat_indices.end(), 0);
-        for (size_t i = 0; i < num_feats; ++i)
-        {
-            size_t j = i + (rand(num_features-i));
-            std::swap(all_feat_indices[i], all_feat_indices[j]);
-        }
+        std::vector<size_t> all_feat_indices;
+        size_t const num_feats = draw_candidate_features(num_features, randengine, all_feat_indices);
 
         // Initialize the scorer with the labels.
-        SCORER scorer(labels, num_labels, inst_begin, inst_end);
+        SCORER scorer(labels, weights, num_labels, inst_begin, inst_end);
 
         // On small sets, it might happen that all features on the random
         // feature subset are equal. In that case, no split was considered
         // at all and the function returns false.
         bool split_found = false;
 
-        // Find the best split.
+        // Find the best split. The values of each feature are gathered once into a contiguous buffer (together
+        // with the labels and weights), sorted there and swept sequentially.
+        typedef typename FEATURES::value_type FeatureType;
+        typedef detail::SplitBufferItem<FeatureType> Item;
+        static thread_local std::vector<Item> buffer;
+        static thread_local std::vector<Item> tmp;
+        buffer.resize(num_instances);
         double best_score = std::numeric_limits<double>::max();
         for (size_t k = 0; k < num_feats; ++k)
         {
             auto const feat = all_feat_indices[k];
 
-            // Sort the instances according to the current feature.
-            std::sort(inst_begin, inst_end,
-                    [& features, & feat](size_t i, size_t j)
-                    {
-                        return features(i, feat) < features(j, feat);
-                    }
-            );
+            // Gather the instances and sort them according to the current feature.
+            for (size_t i = 0; i < num_instances; ++i)
+            {
+                size_t const instance = inst_begin[i];
+                FeatureType const value = features(instance, feat);
+                buffer[i] = {detail::radix_key(value), value, static_cast<size_t>(labels(instance)), weights[instance]};
+            }
+            detail::radix_sort(buffer, tmp);
 
             // Compute the score of each split.
             scorer.clear_left();
             for (size_t i = 0; i+1 < num_instances; ++i)
             {
-                // Compute the split.
-                size_t const left_instance = inst_begin[i];
-                size_t const right_instance = inst_begin[i+1];
-
                 // Add the label to the left child.
-                size_t const label = static_cast<size_t>(labels(left_instance));
-                scorer.add_left(label);
+                scorer.add_left(buffer[i].label, buffer[i].weight);
+
+                // Skip if there is no new split or if a child would be too small.
+                auto const left = buffer[i].value;
+                auto const right = buffer[i+1].value;
+                if (left == right)
+                    continue;
+                if (i+1 < min_leaf_size || num_instances-i-1 < min_leaf_size)
+                    continue;
+
+                // Update the best score.
+                split_found = true;
+                double const score = scorer();
+                if (score < best_score)
+                {
+                    best_score = score;
+                    best_split = 0.5*(left+right);
+                    best_feat = feat;
+                }
+            }
+        }
+
+        if (!split_found)
+            return false;
+        impurity_decrease = scorer.prior_score() - best_score;
+
+        // Separate the data according to the best split.
+        split_iter = std::partition(inst_begin, inst_end,
+                [& features, & best_feat, & best_split](size_t instance_index)
+                {
+                    return features(instance_index, best_feat) < best_split;
+                }
+        );
+        return true;
+    }
+
+    /// \brief Find the best split on column-oriented sparse features.
+    ///
+    /// Only the non-zero values of the node are gathered and sorted for each candidate feature. The implicit
+    /// zeros of the node form a single block in the sweep, whose label weights are the node totals minus the
+    /// weights of the non-zero values. The thresholds are the same as on the equivalent dense features.
+    template <typename ITER, typename T, typename LABELS, typename WEIGHTS, typename RANDENGINE>
+    bool split(
+            ITER const inst_begin,
+            ITER const inst_end,
+            SparseColumnFeatureGetter<T> const & features,
+            LABELS const & labels,
+            WEIGHTS const & weights,
+            size_t const num_labels,
+            RANDENGINE const & randengine,
+            size_t & best_feat,
+            T & best_split,
+            ITER & split_iter,
+            double & impurity_decrease,
+            size_t const min_leaf_size = 1
+    ) const {
+        size_t const num_instances = std::distance(inst_begin, inst_end);
+        auto const num_features = features.shape()[1];
+
+        // Get a random subset of the features.
+        std::vector<size_t> all_feat_indices;
+        size_t const num_feats = draw_candidate_features(num_features, randengine, all_feat_indices);
+
+        // Initialize the scorer with the labels.
+        SCORER scorer(labels, weights, num_labels, inst_begin, inst_end);
+
+        // Mark the instances of the node with a new stamp, so the non-zero values of a feature can be filtered
+        // without clearing the marks between the nodes. Also sum the label weights of the node.
+        static thread_local std::vector<size_t> stamps;
+        static thread_local size_t stamp = 0;
+        size_t const num_rows = features.shape()[0];
+        if (stamps.size() < num_rows)
+            stamps.resize(num_rows, 0);
+        ++stamp;
+        std::vector<double> node_weights(num_labels, 0.);
+        for (auto it = inst_begin; it != inst_end; ++it)
+        {
+            stamps[*it] = stamp;
+            node_weights[labels(*it)] += weights[*it];
+        }
+
+        bool split_found = false;
+        typedef detail::SplitBufferItem<T> Item;
+        static thread_local std::vector<Item> buffer;
+        static thread_local std::vector<Item> tmp;
+        std::vector<double> zero_weights(num_labels);
+        double best_score = std::numeric_limits<double>::max();
+        for (size_t k = 0; k < num_feats; ++k)
+        {
+            auto const feat = all_feat_indices[k];
+
+            // Gather the non-zero values of the node. If the column is much longer than the node, the values
+            // are looked up by binary search, otherwise the column is scanned.
+            buffer.clear();
+            auto const col_begin = features.begin_column_instances(feat);
+            auto const col_end = features.end_column_instances(feat);
+            auto const val_begin = features.begin_column_values(feat);
+            size_t const col_size = std::distance(col_begin, col_end);
+            auto const add_item = [&](size_t instance, T value)
+            {
+                buffer.push_back({detail::radix_key(value), value, static_cast<size_t>(labels(instance)), weights[instance]});
+            };
+            if (num_instances * 16 < col_size)
+            {
+                for (auto it = inst_begin; it != inst_end; ++it)
+                {
+                    auto const lower = std::lower_bound(col_begin, col_end, static_cast<size_t>(*it));
+                    if (lower != col_end && *lower == static_cast<size_t>(*it))
+                        add_item(*it, val_begin[std::distance(col_begin, lower)]);
+                }
+            }
+            else
+            {
+                for (auto it = col_begin; it != col_end; ++it)
+                {
+                    if (stamps[*it] == stamp)
+                        add_item(*it, val_begin[std::distance(col_begin, it)]);
+                }
+            }
+
+            // Add the block of zeros as a single item with an invalid label.
+            size_t const num_zeros = num_instances - buffer.size();
+            if (num_zeros > 0)
+            {
+                zero_weights = node_weights;
+                for (auto const & item : buffer)
+                {
+                    zero_weights[item.label] -= item.weight;
+                }
+                T const zero = 0;
+                buffer.push_back({detail::radix_key(zero), zero, num_labels, 0.});
+            }
+            detail::radix_sort(buffer, tmp);
+
+            // Compute the score of each split.
+            scorer.clear_left();
+            size_t num_left = 0;
+            for (size_t i = 0; i+1 < buffer.size(); ++i)
+            {
+                // Add the label (or the label weights of the zeros) to the left child.
+                if (buffer[i].label == num_labels)
+                {
+                    for (size_t l = 0; l < num_labels; ++l)
+                    {
+                        scorer.add_left(l, zero_weights[l]);
+                    }
+                    num_left += num_zeros;
+                }
+                else
+                {
+                    scorer.add_left(buffer[i].label, buffer[i].weight);
+                    ++num_left;
+                }
 
-                // Skip if there is no new split.
-                auto const left = features(left_instance, feat);
-                auto const right = features(right_instance, feat);
+                // Skip if there is no new split or if a child would be too small.
+                auto const left = buffer[i].value;
+                auto const right = buffer[i+1].value;
                 if (left == right)
                     continue;
+                if (num_left < min_leaf_size || num_instances-num_left < min_leaf_size)
+                    continue;
 
                 // Update the best score.
                 split_found = true;
@@ -311,6 +1121,7 @@ public:
 
         if (!split_found)
             return false;
+        impurity_decrease = scorer.prior_score() - best_score;
 
         // Separate the data according to the best split.
         split_iter = std::partition(inst_begin, inst_end,
@@ -325,118 +1136,520 @@ public:
 
 
 
-/// \brief Simple decision tree class.
-template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE = MersenneTwister>
-class DecisionTree0
+/// \brief Split functor for extremely randomized trees [Geurts et al. 2006].
+///
+/// Instead of searching all thresholds of the candidate features, a single random threshold between the minimum
+/// and the maximum value of the node is drawn for each candidate feature. The values are gathered (and the minimum
+/// and maximum found) in one linear pass, a second pass over the gathered values scores the threshold, so the
+/// split search is linear in the number of instances and needs no sorting.
+template <typename SCORER>
+class ExtraTreesSplit : public detail::FeatureSubsetSplitBase
 {
 public:
 
-    typedef BinaryTree Graph;
-    typedef typename Graph::Node Node;
-    typedef FEATURETYPE FeatureType;
-    typedef LABELTYPE LabelType;
-    typedef detail::Split<FeatureType> Split;
-    typedef RANDENGINE Randengine;
+    /// \param num_candidates: number of random features that are considered per split (0: ceil(sqrt(num_features)))
+    ExtraTreesSplit(size_t const num_candidates = 0)
+        : detail::FeatureSubsetSplitBase(num_candidates)
+    {}
 
-    template <typename T>
-    using NodeMap = typename Graph::template NodeMap<T>;
+    /// \brief Find the best random split of the given instances on a random feature subset and partition the instances accordingly.
+    ///
+    /// The parameters are the same as in RandomSplit::split.
+    template <typename ITER, typename FEATURES, typename LABELS, typename WEIGHTS, typename RANDENGINE>
+    bool split(
+            ITER const inst_begin,
+            ITER const inst_end,
+            FEATURES const & features,
+            LABELS const & labels,
+            WEIGHTS const & weights,
+            size_t const num_labels,
+            RANDENGINE const & randengine,
+            size_t & best_feat,
+            typename FEATURES::value_type & best_split,
+            ITER & split_iter,
+            double & impurity_decrease,
+            size_t const min_leaf_size = 1
+    ) const {
+        typedef typename FEATURES::value_type FeatureType;
+        size_t const num_instances = std::distance(inst_begin, inst_end);
+        auto const num_features = features.shape()[1];
+        if (num_instances < 2)
+            return false;
 
-    DecisionTree0(size_t const seed)
-        : tree_(),
-          node_main_label_(),
-          node_splits_(),
-          num_labels_(0),
-          randengine_(seed),
-          instance_ranges_()
-    {}
+        // Get a random subset of the features.
+        std::vector<size_t> all_feat_indices;
+        size_t const num_feats = draw_candidate_features(num_features, randengine, all_feat_indices);
 
-    DecisionTree0(DecisionTree0 const &) = default;
-    DecisionTree0(DecisionTree0 &&) = default;
-    ~DecisionTree0() = default;
-    DecisionTree0 & operator=(DecisionTree0 const &) = default;
-    DecisionTree0 & operator=(DecisionTree0 &&) = default;
+        // Initialize the scorer with the labels.
+        SCORER scorer(labels, weights, num_labels, inst_begin, inst_end);
 
-    /// \brief Train the decision tree.
-    ///
-    /// \note Before calling train, you must call set_num_labels with a value larger than the maximum value in data_y.
-    template <typename FEATURES, typename LABELS, typename SAMPLER, typename TERMINATION, typename SPLITFUNCTOR>
-    void train(
-            FEATURES const & data_x,
-            LABELS const & data_y
-    );
+        // Score one random threshold per feature. Features that are constant on the node or
+        // whose threshold leaves a child smaller than min_leaf_size are skipped.
+        bool split_found = false;
+        static thread_local std::vector<FeatureType> values;
+        values.resize(num_instances);
+        double best_score = std::numeric_limits<double>::max();
+        for (size_t k = 0; k < num_feats; ++k)
+        {
+            auto const feat = all_feat_indices[k];
 
-    /// \brief Predict new data using the forest.
-    template <typename FEATURES, typename LABELS>
-    void predict(
-            FEATURES const & test_x,
-            LABELS & pred_y
-    ) const;
+            // Gather the values and find the minimum and the maximum.
+            FeatureType lo = features(inst_begin[0], feat);
+            FeatureType hi = lo;
+            for (size_t i = 0; i < num_instances; ++i)
+            {
+                FeatureType const v = features(inst_begin[i], feat);
+                values[i] = v;
+                lo = std::min(lo, v);
+                hi = std::max(hi, v);
+            }
+            if (!(lo < hi))
+                continue;
 
-    /// \brief Return the number of labels.
-    void get_num_labels() const
-    {
-        return num_labels_;
-    }
+            // Draw the threshold from (lo, hi], so both children are non-empty.
+            FeatureType thresh;
+            if (std::is_integral<FeatureType>::value)
+            {
+                thresh = static_cast<FeatureType>(lo + 1 + randengine.uniformInt(static_cast<UInt32>(hi - lo)));
+            }
+            else
+            {
+                thresh = static_cast<FeatureType>(lo + randengine.uniform() * (hi - lo));
+                if (!(lo < thresh))
+                    thresh = hi;
+            }
 
-    /// \brief Set the number of labels.
-    void set_num_labels(size_t num_labels)
-    {
-        num_labels_ = num_labels;
-    }
+            // Compute the score of the split.
+            scorer.clear_left();
+            size_t num_left = 0;
+            for (size_t i = 0; i < num_instances; ++i)
+            {
+                if (values[i] < thresh)
+                {
+                    size_t const instance = inst_begin[i];
+                    scorer.add_left(labels(instance), weights[instance]);
+                    ++num_left;
+                }
+            }
+            if (num_left < min_leaf_size || num_instances - num_left < min_leaf_size)
+                continue;
+            split_found = true;
+            double const score = scorer();
+            if (score < best_score)
+            {
+                best_score = score;
+                best_split = thresh;
+                best_feat = feat;
+            }
+        }
 
-    /// \brief Return the number of leaves.
-    size_t num_leaves() const
-    {
-        return tree_.numLeaves();
-    }
+        if (!split_found)
+            return false;
+        impurity_decrease = scorer.prior_score() - best_score;
 
-    /// \brief Return the label of the leaf with the given index.
-    LabelType leaf_main_label(size_t leaf_index) const
-    {
-        return node_main_label_.at(tree_.getLeafNode(leaf_index));
+        // Separate the data according to the best split.
+        split_iter = std::partition(inst_begin, inst_end,
+                [& features, & best_feat, & best_split](size_t instance_index)
+                {
+                    return features(instance_index, best_feat) < best_split;
+                }
+        );
+        return true;
     }
+};
 
-    /// \brief Return the graph structure.
-    Graph & get_graph()
-    {
-        return tree_;
-    }
 
-    /// \brief Return the graph structure.
-    Graph const & get_graph() const
-    {
-        return tree_;
-    }
 
-    /// \brief Return the node splits.
-    NodeMap<Split> const & node_splits() const
+/// \brief Split functor for DecisionJungle0.
+///
+/// The initial split of each node is found as in RandomSplit. The jungle then optimizes the splits and the
+/// child assignments of each level jointly, using SCORER::node_score on the merged children.
+template <typename SCORER>
+class JungleSplit : public RandomSplit<SCORER>
+{
+public:
+
+    typedef SCORER Scorer;
+
+    /// \param max_width: the maximum number of nodes per level
+    /// \param num_iterations: the maximum number of alternating split and child optimizations per level
+    /// \param num_candidates: number of random features that are considered per split (0: ceil(sqrt(num_features)))
+    JungleSplit(size_t const max_width = 64, size_t const num_iterations = 10, size_t const num_candidates = 0)
+        : RandomSplit<SCORER>(num_candidates),
+          max_width_(max_width),
+          num_iterations_(num_iterations)
     {
-        return node_splits_;
+        vigra_precondition(max_width >= 2, "JungleSplit(): The width must be at least 2.");
     }
 
-    /// \brief Return the node labels.
-    NodeMap<LabelType> const & node_main_label() const
+    size_t max_width() const
     {
-        return node_main_label_;
+        return max_width_;
     }
 
-    /// \brief Return the class probabilities.
-    NodeMap<std::vector<double> > const & label_probs() const
+    size_t num_iterations() const
     {
-        return label_probs_;
+        return num_iterations_;
     }
 
-    /// \brief Return the node ids of the leaves that contain the given instances.
-    template <typename FEATURES>
-    void leaf_ids(
-            FEATURES const & features,
-            MultiArrayView<1, size_t> & indices
-    ) const;
-
 protected:
 
-    /// \brief The graph structure.
-    Graph tree_;
+    size_t max_width_;
+    size_t num_iterations_;
+};
+
+
+
+/// \brief Split functor that makes DecisionTree0 grow level by level (breadth-first).
+///
+/// All open nodes of one depth are split together: The instances are assigned to their nodes (ordered by the
+/// instance id) and each sampled feature column is read in a single sequential pass that gathers the values
+/// into per-node buffers. The buffers are then sorted and swept as in RandomSplit, in parallel over the nodes.
+/// The number of leaves (see MaxLeavesTermination) is enforced per level, the best splits of a level are applied first.
+template <typename SCORER>
+class LevelwiseSplit : public RandomSplit<SCORER>
+{
+public:
+
+    typedef SCORER Scorer;
+
+    /// \param num_threads: number of threads for the split search of the nodes of one level (-1: use all cores)
+    /// \param num_candidates: number of random features that are considered per split (0: ceil(sqrt(num_features)))
+    LevelwiseSplit(int const num_threads = 1, size_t const num_candidates = 0)
+        : RandomSplit<SCORER>(num_candidates),
+          num_threads_(num_threads)
+    {
+        vigra_precondition(num_threads == -1 || num_threads > 0,
+                           "LevelwiseSplit(): num_threads must be -1 or greater than zero.");
+    }
+
+    /// \brief Find the best split of each node of a level on a random feature subset (the instances are not partitioned).
+    /// \param ranges: the instances of each node
+    /// \param weights: weights[i] is the (bootstrap) weight of instance i
+    /// \param results[out]: the best split of each node and the decrease of the impurity, normalized by the total weight
+    /// \param min_leaf_size: only consider splits with at least this number of (distinct) instances on both sides
+    template <typename ITER, typename FEATURES, typename LABELS, typename WEIGHTS, typename RANDENGINE>
+    void split_level(
+            std::vector<detail::IterRange<ITER> > const & ranges,
+            FEATURES const & features,
+            LABELS const & labels,
+            WEIGHTS const & weights,
+            size_t const num_labels,
+            RANDENGINE const & randengine,
+            std::vector<detail::LevelSplitResult<typename FEATURES::value_type> > & results,
+            size_t const min_leaf_size = 1
+    ) const {
+        typedef typename FEATURES::value_type FeatureType;
+        typedef detail::SplitBufferItem<FeatureType> Item;
+        size_t const num_nodes = ranges.size();
+        size_t const num_features = features.shape()[1];
+
+        // Draw the random feature subset of each node and collect the nodes that use each feature.
+        std::vector<std::vector<size_t> > feature_nodes(num_features);
+        std::vector<size_t> all_feat_indices;
+        for (size_t k = 0; k < num_nodes; ++k)
+        {
+            size_t const num_feats = this->draw_candidate_features(num_features, randengine, all_feat_indices);
+            for (size_t i = 0; i < num_feats; ++i)
+            {
+                feature_nodes[all_feat_indices[i]].push_back(k);
+            }
+        }
+
+        // Assign the instances to their nodes and initialize the scorer of each node with the labels.
+        std::vector<std::pair<size_t, size_t> > assignment;
+        std::vector<SCORER> scorers;
+        scorers.reserve(num_nodes);
+        for (size_t k = 0; k < num_nodes; ++k)
+        {
+            for (auto it = ranges[k].begin; it != ranges[k].end; ++it)
+            {
+                assignment.push_back(std::make_pair(static_cast<size_t>(*it), k));
+            }
+            scorers.emplace_back(labels, weights, num_labels, ranges[k].begin, ranges[k].end);
+        }
+        std::sort(assignment.begin(), assignment.end());
+
+        // Find the best split of each node, one feature after another.
+        results.assign(num_nodes, {false, {0, FeatureType()}, 0.});
+        std::vector<double> best_scores(num_nodes, std::numeric_limits<double>::max());
+        std::vector<std::vector<Item> > buffers(num_nodes);
+        std::vector<UInt8> active(num_nodes, 0);
+        for (size_t feat = 0; feat < num_features; ++feat)
+        {
+            auto const & nodes = feature_nodes[feat];
+            if (nodes.empty())
+                continue;
+
+            // Gather the values of the nodes that use the feature in one pass over the column.
+            for (size_t k : nodes)
+            {
+                active[k] = 1;
+                buffers[k].clear();
+            }
+            for (auto const & a : assignment)
+            {
+                if (active[a.second])
+                {
+                    FeatureType const value = features(a.first, feat);
+                    buffers[a.second].push_back({detail::radix_key(value), value, static_cast<size_t>(labels(a.first)), weights[a.first]});
+                }
+            }
+            for (size_t k : nodes)
+            {
+                active[k] = 0;
+            }
+
+            // Sort the buffer of each node and compute the score of each split.
+            detail::parallel_for(nodes.size(), num_threads_,
+                    [& nodes, & buffers, & scorers, & best_scores, & results, feat, min_leaf_size](size_t m)
+                    {
+                        static thread_local std::vector<Item> tmp;
+                        size_t const k = nodes[m];
+                        auto & buffer = buffers[k];
+                        auto & scorer = scorers[k];
+                        size_t const n = buffer.size();
+                        detail::radix_sort(buffer, tmp);
+                        scorer.clear_left();
+                        for (size_t i = 0; i+1 < n; ++i)
+                        {
+                            scorer.add_left(buffer[i].label, buffer[i].weight);
+                            auto const left = buffer[i].value;
+                            auto const right = buffer[i+1].value;
+                            if (left == right)
+                                continue;
+                            if (i+1 < min_leaf_size || n-i-1 < min_leaf_size)
+                                continue;
+                            results[k].split_found = true;
+                            double const score = scorer();
+                            if (score < best_scores[k])
+                            {
+                                best_scores[k] = score;
+                                results[k].split.thresh = 0.5*(left+right);
+                                results[k].split.feature_index = feat;
+                            }
+                        }
+                    }
+            );
+        }
+
+        for (size_t k = 0; k < num_nodes; ++k)
+        {
+            if (results[k].split_found)
+                results[k].impurity_decrease = scorers[k].prior_score() - best_scores[k];
+        }
+    }
+
+    int num_threads() const
+    {
+        return num_threads_;
+    }
+
+protected:
+
+    int num_threads_;
+};
+
+namespace detail
+{
+
+    /// \brief True if the split functor grows the tree level by level.
+    template <typename SPLITFUNCTOR>
+    struct IsLevelwiseSplit : public std::false_type
+    {};
+
+    template <typename SCORER>
+    struct IsLevelwiseSplit<LevelwiseSplit<SCORER> > : public std::true_type
+    {};
+
+} // namespace detail
+
+
+
+/// \brief Simple decision tree class.
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE = MersenneTwister>
+class DecisionTree0
+{
+public:
+
+    typedef BinaryTree Graph;
+    typedef typename Graph::Node Node;
+    typedef FEATURETYPE FeatureType;
+    typedef LABELTYPE LabelType;
+    typedef detail::Split<FeatureType> Split;
+    typedef RANDENGINE Randengine;
+
+    template <typename T>
+    using NodeMap = typename Graph::template NodeMap<T>;
+
+    DecisionTree0(size_t const seed)
+        : tree_(),
+          node_main_label_(),
+          node_splits_(),
+          num_labels_(0),
+          num_features_(0),
+          randengine_(seed),
+          instance_ranges_()
+    {}
+
+    DecisionTree0(DecisionTree0 const &) = default;
+    DecisionTree0(DecisionTree0 &&) = default;
+    ~DecisionTree0() = default;
+    DecisionTree0 & operator=(DecisionTree0 const &) = default;
+    DecisionTree0 & operator=(DecisionTree0 &&) = default;
+
+    /// \brief Train the decision tree.
+    ///
+    /// The tree is grown depth-first, best-first if the number of leaves is restricted,
+    /// or level by level if the split functor is a LevelwiseSplit.
+    /// \note Before calling train, you must call set_num_labels with a value larger than the maximum value in data_y.
+    template <typename FEATURES, typename LABELS, typename SAMPLER, typename TERMINATION, typename SPLITFUNCTOR>
+    void train(
+            FEATURES const & data_x,
+            LABELS const & data_y,
+            SAMPLER const & sampler = SAMPLER(),
+            TERMINATION const & termination = TERMINATION(),
+            SPLITFUNCTOR const & functor = SPLITFUNCTOR()
+    );
+
+    /// \brief Predict new data using the forest.
+    template <typename FEATURES, typename LABELS>
+    void predict(
+            FEATURES const & test_x,
+            LABELS & pred_y
+    ) const;
+
+    /// \brief Return the number of labels.
+    size_t get_num_labels() const
+    {
+        return num_labels_;
+    }
+
+    /// \brief Set the number of labels.
+    void set_num_labels(size_t num_labels)
+    {
+        num_labels_ = num_labels;
+    }
+
+    /// \brief Return the number of leaves.
+    size_t num_leaves() const
+    {
+        return tree_.numLeaves();
+    }
+
+    /// \brief Return the number of features of the training data.
+    size_t num_features() const
+    {
+        return num_features_;
+    }
+
+    /// \brief Return the label of the leaf with the given index.
+    LabelType leaf_main_label(size_t leaf_index) const
+    {
+        return node_main_label_.at(tree_.getLeafNode(leaf_index));
+    }
+
+    /// \brief Return the graph structure.
+    Graph & get_graph()
+    {
+        return tree_;
+    }
+
+    /// \brief Return the graph structure.
+    Graph const & get_graph() const
+    {
+        return tree_;
+    }
+
+    /// \brief Return the root node.
+    Node get_root() const
+    {
+        return tree_.getRoot();
+    }
+
+    /// \brief Return true if the node is a leaf.
+    bool is_leaf(Node const & node) const
+    {
+        return tree_.outDegree(node) == 0;
+    }
+
+    /// \brief Return the left and the right child of an inner node.
+    std::pair<Node, Node> children(Node const & node) const
+    {
+        return {tree_.getChild(node, 0), tree_.getChild(node, 1)};
+    }
+
+    /// \brief Return the node splits.
+    NodeMap<Split> const & node_splits() const
+    {
+        return node_splits_;
+    }
+
+    /// \brief Return the node labels.
+    NodeMap<LabelType> const & node_main_label() const
+    {
+        return node_main_label_;
+    }
+
+    /// \brief Return the class probabilities.
+    NodeMap<std::vector<double> > const & label_probs() const
+    {
+        return label_probs_;
+    }
+
+    /// \brief Return the number of instances in each leaf.
+    NodeMap<size_t> const & instance_count() const
+    {
+        return instance_count_;
+    }
+
+    /// \brief Return the node ids of the leaves that contain the given instances.
+    template <typename FEATURES>
+    void leaf_ids(
+            FEATURES const & features,
+            MultiArrayView<1, size_t> & indices
+    ) const;
+
+    /// \brief Return the leaf that is reached by an instance, where feats(j) returns the j-th feature of the instance.
+    template <typename ACCESSOR>
+    Node leaf_node(ACCESSOR const & feats) const;
+
+    /// \brief Return true if the given training instance was not part of the bootstrap sample (out-of-bag).
+    bool is_oob(size_t instance) const
+    {
+        return is_oob_[instance];
+    }
+
+    /// \brief Return the out-of-bag flag of each training instance.
+    std::vector<bool> const & oob_instances() const
+    {
+        return is_oob_;
+    }
+
+    /// \brief Return the impurity decrease (weighted with the number of instances) of all splits on each feature.
+    std::vector<double> const & gini_importance() const
+    {
+        return gini_importance_;
+    }
+
+    /// \brief Write the trained tree to a binary stream.
+    ///
+    /// The node ids are preserved, so node maps of other objects (e.g. leaf weights) stay valid for the restored tree.
+    void serialize(std::ostream & os) const;
+
+    /// \brief Read a tree that was written with serialize.
+    void deserialize(std::istream & is);
+
+    /// \brief Renumber the nodes without holes (see BinaryTree::compact()) and update the node maps.
+    ///
+    /// Entries of erased nodes (e.g. after pruning) are removed from the node maps.
+    /// \return vector that maps each old node id to the new id (-1 for erased nodes)
+    std::vector<typename Graph::index_type> compact();
+
+protected:
+
+    /// \brief The graph structure.
+    Graph tree_;
 
     /// \brief The node labels that were found in training.
     NodeMap<LabelType> node_main_label_;
@@ -450,9 +1663,18 @@ protected:
     /// \brief The split of each node.
     NodeMap<Split> node_splits_;
 
+    /// \brief Bitset that is true for the training instances that were not in the bootstrap sample.
+    std::vector<bool> is_oob_;
+
+    /// \brief The summed impurity decrease of the splits on each feature.
+    std::vector<double> gini_importance_;
+
     /// \brief The number of distinct labels.
     size_t num_labels_;
 
+    /// \brief The number of features of the training data.
+    size_t num_features_;
+
     /// \brief The random engine.
     Randengine randengine_;
 
@@ -460,16 +1682,76 @@ private:
 
     typedef detail::IterRange<std::vector<size_t>::iterator > Range;
 
+    /// \brief A node that waits to be split, together with its depth and the best split that was found for it.
+    struct SplitCandidate
+    {
+        Node node;
+        size_t depth;
+        bool split_found;
+        Split split;
+        std::vector<size_t>::iterator split_iter;
+        double impurity_decrease;
+    };
+
     /// \brief The instances of each node (begin and end iterator in the vector instance_indices_).
     NodeMap<Range> instance_ranges_;
 
+    /// \brief Grow the tree from the root node, one node after another (depth-first or best-first).
+    template <typename FEATURES, typename LABELS, typename SAMPLER, typename TERMINATION, typename SPLITFUNCTOR>
+    void grow(
+            FEATURES const & features,
+            LABELS const & labels,
+            SAMPLER const & sampler,
+            TERMINATION const & termination,
+            SPLITFUNCTOR const & functor,
+            BootstrapWeights const & instance_weights,
+            std::false_type
+    );
+
+    /// \brief Grow the tree from the root node, one level after another (with a LevelwiseSplit).
+    template <typename FEATURES, typename LABELS, typename SAMPLER, typename TERMINATION, typename SPLITFUNCTOR>
+    void grow(
+            FEATURES const & features,
+            LABELS const & labels,
+            SAMPLER const & sampler,
+            TERMINATION const & termination,
+            SPLITFUNCTOR const & functor,
+            BootstrapWeights const & instance_weights,
+            std::true_type
+    );
+
+    /// \brief Add the two children of the split node and add the weighted impurity decrease to the gini importance.
+    std::pair<Node, Node> split_node(
+            Node const & node,
+            Split const & split,
+            std::vector<size_t>::iterator split_iter,
+            double impurity_decrease
+    );
+
+    /// \brief Return the summed weight of the instances of the node.
+    double node_weight(
+            Node const & node,
+            BootstrapWeights const & instance_weights
+    ) const;
+
+    /// \brief Make the node terminal: Save the (weighted) class probabilities, the instance count and the main label.
+    template <typename LABELS>
+    void make_leaf(
+            Node const & node,
+            LABELS const & labels,
+            BootstrapWeights const & instance_weights
+    );
+
 };
 
 template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
 template <typename FEATURES, typename LABELS, typename SAMPLER, typename TERMINATION, typename SPLITFUNCTOR>
 void DecisionTree0<FEATURETYPE, LABELTYPE, RANDENGINE>::train(
         FEATURES const & features,
-        LABELS const & labels
+        LABELS const & labels,
+        SAMPLER const & sampler,
+        TERMINATION const & termination,
+        SPLITFUNCTOR const & functor
 ){
     static_assert(std::is_convertible<typename FEATURES::value_type, FeatureType>(),
                   "DecisionTree0::train(): Wrong feature type.");
@@ -478,424 +1760,2511 @@ void DecisionTree0<FEATURETYPE, LABELTYPE, RANDENGINE>::train(
 
     vigra_precondition(num_labels_ > 0, "DecisionTree::train(): The number of distinct labels must be set before training.");
 
-    // Create the bootstrap indices.
-    SAMPLER sampler;
-    std::vector<size_t> instance_indices = sampler.bootstrap_sample(labels.size(), randengine_);
+    // Create the bootstrap sample (distinct instances with weights) and remember the out-of-bag instances.
+    std::vector<size_t> instance_indices;
+    BootstrapWeights instance_weights;
+    sampler.bootstrap_sample(labels.size(), randengine_, instance_indices, instance_weights);
+    vigra_precondition(!instance_indices.empty(), "DecisionTree0::train(): The bootstrap sample is empty.");
+    is_oob_.assign(labels.size(), true);
+    for (size_t i : instance_indices)
+    {
+        is_oob_[i] = false;
+    }
+    num_features_ = features.shape()[1];
+    gini_importance_.assign(num_features_, 0.);
 
-    // Create the queue with the nodes to be split and place the root node with all instances inside.
-    std::stack<Node> node_stack;
+    // Place the root node with all instances in the tree and grow it.
     auto const rootnode = tree_.addNode();
     instance_ranges_[rootnode] = {instance_indices.begin(), instance_indices.end()};
-    node_stack.push(rootnode);
+    grow(features, labels, sampler, termination, functor, instance_weights,
+         typename detail::IsLevelwiseSplit<SPLITFUNCTOR>::type());
+}
 
-    // Initialize the split functor with a random engine.
-    SPLITFUNCTOR functor;
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
+template <typename FEATURES, typename LABELS, typename SAMPLER, typename TERMINATION, typename SPLITFUNCTOR>
+void DecisionTree0<FEATURETYPE, LABELTYPE, RANDENGINE>::grow(
+        FEATURES const & features,
+        LABELS const & labels,
+        SAMPLER const & sampler,
+        TERMINATION const & termination,
+        SPLITFUNCTOR const & functor,
+        BootstrapWeights const & instance_weights,
+        std::false_type
+){
+    // If the number of leaves is restricted, the tree is grown best-first, else depth-first.
+    size_t const max_leaves = termination.max_leaves();
+    size_t const min_leaf_size = termination.min_leaf_size();
+    bool const best_first = max_leaves != std::numeric_limits<size_t>::max();
+    double const root_weight = node_weight(tree_.getRoot(), instance_weights);
+    auto const candidate_less = [](SplitCandidate const & a, SplitCandidate const & b) {
+        return a.impurity_decrease < b.impurity_decrease;
+    };
 
-    // Split the nodes.
-    while (!node_stack.empty())
-    {
-        auto const node = node_stack.top();
-        node_stack.pop();
+    // Create a named lambda that checks the termination criterion and finds the best split of a node.
+    auto find_split = [&](Node const & node, size_t const depth) {
+        SplitCandidate c;
+        c.node = node;
+        c.depth = depth;
+        c.split_found = false;
+        c.impurity_decrease = std::numeric_limits<double>::lowest();
 
         // Draw a random sample of the instances.
         auto const instances = instance_ranges_[node];
         sampler.split_sample(instances.begin, instances.end);
 
-        // Check the termination criterion.
-        TERMINATION termination_crit;
-        LabelType first_label;
-        bool const do_split = !termination_crit.stop(instances.begin, instances.end, labels, first_label);
-        bool split_found = false;
-        if (do_split)
+        // Check the termination criterion and split the node.
+        if (!termination.stop(instances.begin, instances.end, labels, depth))
         {
-            // Split the node.
-            size_t best_feat;
-            FeatureType best_split;
-            std::vector<size_t>::iterator split_iter;
-            split_found = functor.split(instances.begin, instances.end, features, labels, num_labels_, randengine_, best_feat, best_split, split_iter);
-            if (split_found)
+            c.split_found = functor.split(instances.begin, instances.end, features, labels, instance_weights, num_labels_, randengine_,
+                                          c.split.feature_index, c.split.thresh, c.split_iter, c.impurity_decrease,
+                                          min_leaf_size);
+            if (c.split_found)
             {
-                // Add the child nodes to the graph.
-                Node const n0 = tree_.addNode();
-                Node const n1 = tree_.addNode();
-                tree_.addArc(node, n0);
-                tree_.addArc(node, n1);
-                instance_ranges_[n0] = {instances.begin, split_iter};
-                instance_ranges_[n1] = {split_iter, instances.end};
-                node_splits_[node] = {best_feat, best_split};
-                node_stack.push(n0);
-                node_stack.push(n1);
+                size_t const num_left = std::distance(instances.begin, c.split_iter);
+                size_t const num_right = std::distance(c.split_iter, instances.end);
+                c.split_found = !termination.reject_split(depth, num_left, num_right, c.impurity_decrease / root_weight);
             }
         }
+        return c;
+    };
+
+    // Create the stack with the nodes to be split and place the root node inside.
+    // In best-first mode, the stack is kept as a heap with the largest weighted impurity decrease on top.
+    std::vector<SplitCandidate> node_stack;
+    node_stack.push_back(find_split(tree_.getRoot(), 0));
+    size_t num_leaves = 1;
+
+    // Split the nodes.
+    while (!node_stack.empty())
+    {
+        if (best_first)
+            std::pop_heap(node_stack.begin(), node_stack.end(), candidate_less);
+        SplitCandidate const c = node_stack.back();
+        node_stack.pop_back();
 
-        if (!do_split || !split_found)
+        if (c.split_found && num_leaves < max_leaves)
         {
-            // Make the node terminal.
+            // Add the child nodes to the graph.
+            auto const children = split_node(c.node, c.split, c.split_iter, c.impurity_decrease);
+            ++num_leaves;
 
-            // Count the instances and get the probabilities of each class.
-            size_t count = 0;
-            std::vector<double> probs(num_labels_);
-            for (auto it = instances.begin; it != instances.end; ++it)
+            // Find the splits of the children and put them on the stack.
+            for (Node const & n : {children.first, children.second})
             {
-                ++count;
-                ++probs[labels(*it)];
+                node_stack.push_back(find_split(n, c.depth+1));
+                if (best_first)
+                    std::push_heap(node_stack.begin(), node_stack.end(), candidate_less);
             }
-            for (size_t i = 0; i < probs.size(); ++i)
-            {
-                probs[i] /= count;
-            }
-
-            // Save the data in the node maps.
-            label_probs_.emplace(node, probs);
-            instance_count_[node] = count;
-            node_main_label_[node] = first_label;
+        }
+        else
+        {
+            make_leaf(c.node, labels, instance_weights);
         }
     }
 }
 
 template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
-template <typename FEATURES, typename LABELS>
-void DecisionTree0<FEATURETYPE, LABELTYPE, RANDENGINE>::predict(
+template <typename FEATURES, typename LABELS, typename SAMPLER, typename TERMINATION, typename SPLITFUNCTOR>
+void DecisionTree0<FEATURETYPE, LABELTYPE, RANDENGINE>::grow(
+        FEATURES const & features,
+        LABELS const & labels,
+        SAMPLER const & sampler,
+        TERMINATION const & termination,
+        SPLITFUNCTOR const & functor,
+        BootstrapWeights const & instance_weights,
+        std::true_type
+){
+    typedef std::vector<size_t>::iterator Iter;
+
+    size_t const max_leaves = termination.max_leaves();
+    size_t const min_leaf_size = termination.min_leaf_size();
+    double const root_weight = node_weight(tree_.getRoot(), instance_weights);
+    size_t num_leaves = 1;
+    std::vector<Node> level_nodes {tree_.getRoot()};
+    for (size_t depth = 0; !level_nodes.empty(); ++depth)
+    {
+        // Check the termination criterion of each node, the remaining nodes are open.
+        std::vector<Node> open_nodes;
+        std::vector<detail::IterRange<Iter> > open_ranges;
+        for (Node const & node : level_nodes)
+        {
+            auto const instances = instance_ranges_[node];
+            sampler.split_sample(instances.begin, instances.end);
+            if (num_leaves < max_leaves && !termination.stop(instances.begin, instances.end, labels, depth))
+            {
+                open_nodes.push_back(node);
+                open_ranges.push_back(instances);
+            }
+            else
+            {
+                make_leaf(node, labels, instance_weights);
+            }
+        }
+
+        // Find the splits of all open nodes together.
+        std::vector<detail::LevelSplitResult<typename FEATURES::value_type> > results;
+        functor.split_level(open_ranges, features, labels, instance_weights, num_labels_, randengine_, results, min_leaf_size);
+
+        // Partition the instances of each node and check the splits.
+        std::vector<Iter> split_iters(open_nodes.size());
+        std::vector<size_t> candidates;
+        for (size_t k = 0; k < open_nodes.size(); ++k)
+        {
+            auto const & r = results[k];
+            if (!r.split_found)
+                continue;
+            split_iters[k] = std::partition(open_ranges[k].begin, open_ranges[k].end,
+                    [& features, & r](size_t instance_index)
+                    {
+                        return features(instance_index, r.split.feature_index) < r.split.thresh;
+                    }
+            );
+            size_t const num_left = std::distance(open_ranges[k].begin, split_iters[k]);
+            size_t const num_right = std::distance(split_iters[k], open_ranges[k].end);
+            if (!termination.reject_split(depth, num_left, num_right, r.impurity_decrease / root_weight))
+                candidates.push_back(k);
+        }
+
+        // Apply the splits (the ones with the largest weighted impurity decrease first, if the number of leaves is restricted).
+        if (num_leaves + candidates.size() > max_leaves)
+        {
+            std::stable_sort(candidates.begin(), candidates.end(),
+                    [& results](size_t a, size_t b)
+                    {
+                        return results[a].impurity_decrease > results[b].impurity_decrease;
+                    }
+            );
+            candidates.resize(max_leaves - num_leaves);
+        }
+        std::vector<bool> is_split(open_nodes.size(), false);
+        std::vector<Node> next_level;
+        for (size_t k : candidates)
+        {
+            Split const split {results[k].split.feature_index, static_cast<FeatureType>(results[k].split.thresh)};
+            auto const children = split_node(open_nodes[k], split, split_iters[k], results[k].impurity_decrease);
+            next_level.push_back(children.first);
+            next_level.push_back(children.second);
+            is_split[k] = true;
+            ++num_leaves;
+        }
+        for (size_t k = 0; k < open_nodes.size(); ++k)
+        {
+            if (!is_split[k])
+                make_leaf(open_nodes[k], labels, instance_weights);
+        }
+        level_nodes.swap(next_level);
+    }
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
+auto DecisionTree0<FEATURETYPE, LABELTYPE, RANDENGINE>::split_node(
+        Node const & node,
+        Split const & split,
+        std::vector<size_t>::iterator split_iter,
+        double const impurity_decrease
+) -> std::pair<Node, Node>
+{
+    auto const instances = instance_ranges_[node];
+    Node const n0 = tree_.addNode();
+    Node const n1 = tree_.addNode();
+    tree_.addArc(node, n0);
+    tree_.addArc(node, n1);
+    instance_ranges_[n0] = {instances.begin, split_iter};
+    instance_ranges_[n1] = {split_iter, instances.end};
+    node_splits_[node] = split;
+    gini_importance_[split.feature_index] += impurity_decrease;
+    return std::make_pair(n0, n1);
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
+double DecisionTree0<FEATURETYPE, LABELTYPE, RANDENGINE>::node_weight(
+        Node const & node,
+        BootstrapWeights const & instance_weights
+) const {
+    auto const instances = instance_ranges_.at(node);
+    double weight = 0.;
+    for (auto it = instances.begin; it != instances.end; ++it)
+    {
+        weight += instance_weights[*it];
+    }
+    return weight;
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
+template <typename LABELS>
+void DecisionTree0<FEATURETYPE, LABELTYPE, RANDENGINE>::make_leaf(
+        Node const & node,
+        LABELS const & labels,
+        BootstrapWeights const & instance_weights
+){
+    auto const instances = instance_ranges_[node];
+
+    // Count the instances and get the (weighted) probabilities of each class.
+    size_t count = 0;
+    double total_weight = 0.;
+    std::vector<double> probs(num_labels_);
+    for (auto it = instances.begin; it != instances.end; ++it)
+    {
+        ++count;
+        total_weight += instance_weights[*it];
+        probs[labels(*it)] += instance_weights[*it];
+    }
+    size_t const main_label = std::distance(probs.begin(), std::max_element(probs.begin(), probs.end()));
+    for (size_t i = 0; i < probs.size(); ++i)
+    {
+        probs[i] /= total_weight;
+    }
+
+    // Save the data in the node maps.
+    label_probs_.emplace(node, probs);
+    instance_count_[node] = count;
+    node_main_label_[node] = static_cast<LabelType>(main_label);
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
+template <typename FEATURES, typename LABELS>
+void DecisionTree0<FEATURETYPE, LABELTYPE, RANDENGINE>::predict(
         FEATURES const & test_x,
         LABELS & pred_y
 ) const {
     // The features must be convertible to the internal feature type, so we can put them into the tree.
     static_assert(std::is_convertible<typename FEATURES::value_type, FeatureType>(),
-                  "DecisionTree0::predict(): Wrong feature type.");
-
-    // The internal label type must be convertible to the given type, so we can put them into the output.
+                  "DecisionTree0::predict(): Wrong feature type.");
+
+    // The internal label type must be convertible to the given type, so we can put them into the output.
+    static_assert(std::is_convertible<LabelType, typename LABELS::value_type>(),
+                  "DecisionTree0::predict(): Wrong label type.");
+
+    vigra_assert(tree_.valid(tree_.getRoot()), "DecisionTree0::predict(): The graph has no root node.");
+
+    // Only the split features are looked up, so sparse features need not be expanded.
+    size_t const num_instances = test_x.shape()[0];
+    for (size_t i = 0; i < num_instances; ++i)
+    {
+        Node const node = leaf_node(
+                [& test_x, i](size_t j)
+                {
+                    return test_x(i, j);
+                }
+        );
+        pred_y(i) = node_main_label_.at(node);
+    }
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
+template <typename FEATURES>
+void DecisionTree0<FEATURETYPE, LABELTYPE, RANDENGINE>::leaf_ids(
+        FEATURES const & features,
+        MultiArrayView<1, size_t> & indices
+) const {
+    static_assert(std::is_convertible<typename FEATURES::value_type, FeatureType>(),
+                  "DecisionTree0::leaf_indices(): Wrong feature type.");
+
+    size_t const num_instances = features.shape()[0];
+
+    vigra_precondition(num_instances == indices.size(),
+                       "DecisionTree0::leaf_indices(): Shape mismatch.");
+
+    vigra_assert(tree_.valid(tree_.getRoot()), "DecisionTree0::leaf_indices(): The graph has no root node.");
+
+    for (size_t i = 0; i < num_instances; ++i)
+    {
+        Node const node = leaf_node(
+                [& features, i](size_t j)
+                {
+                    return features(i, j);
+                }
+        );
+        indices(i) = node.id();
+    }
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
+void DecisionTree0<FEATURETYPE, LABELTYPE, RANDENGINE>::serialize(
+        std::ostream & os
+) const {
+    // Write the children of each node slot, where invalid slots (erased nodes) are marked with -2.
+    Int64 const num_slots = tree_.maxNodeId()+1;
+    detail::write_binary(os, num_slots);
+    for (Int64 id = 0; id < num_slots; ++id)
+    {
+        Node const node(id);
+        Int64 left = -2;
+        Int64 right = -2;
+        if (tree_.valid(node))
+        {
+            left = (tree_.outDegree(node) > 0) ? tree_.getChild(node, 0).id() : -1;
+            right = (tree_.outDegree(node) > 1) ? tree_.getChild(node, 1).id() : -1;
+        }
+        detail::write_binary(os, left);
+        detail::write_binary(os, right);
+    }
+    detail::write_node_map(os, node_main_label_);
+    detail::write_node_map(os, label_probs_);
+    detail::write_node_map(os, instance_count_);
+    detail::write_node_map(os, node_splits_);
+    detail::write_binary(os, is_oob_);
+    detail::write_binary(os, gini_importance_);
+    detail::write_binary(os, static_cast<UInt64>(num_labels_));
+    detail::write_binary(os, static_cast<UInt64>(num_features_));
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
+void DecisionTree0<FEATURETYPE, LABELTYPE, RANDENGINE>::deserialize(
+        std::istream & is
+){
+    // Create all node slots, so the ids are the same as in the written tree, then add the arcs and erase the invalid slots.
+    Int64 num_slots;
+    detail::read_binary(is, num_slots);
+    std::vector<std::pair<Int64, Int64> > children(num_slots);
+    for (auto & c : children)
+    {
+        detail::read_binary(is, c.first);
+        detail::read_binary(is, c.second);
+    }
+    tree_ = Graph();
+    for (Int64 id = 0; id < num_slots; ++id)
+    {
+        tree_.addNode();
+    }
+    for (Int64 id = 0; id < num_slots; ++id)
+    {
+        vigra_precondition(children[id].first < num_slots && children[id].second < num_slots,
+                           "DecisionTree0::deserialize(): Invalid node id.");
+        if (children[id].first >= 0)
+            tree_.addArc(Node(id), Node(children[id].first));
+        if (children[id].second >= 0)
+            tree_.addArc(Node(id), Node(children[id].second));
+    }
+    for (Int64 id = 0; id < num_slots; ++id)
+    {
+        if (children[id].first == -2)
+            tree_.erase(Node(id));
+    }
+    detail::read_node_map(is, node_main_label_);
+    detail::read_node_map(is, label_probs_);
+    detail::read_node_map(is, instance_count_);
+    detail::read_node_map(is, node_splits_);
+    detail::read_binary(is, is_oob_);
+    detail::read_binary(is, gini_importance_);
+    UInt64 num_labels;
+    detail::read_binary(is, num_labels);
+    num_labels_ = num_labels;
+    UInt64 num_features;
+    detail::read_binary(is, num_features);
+    num_features_ = num_features;
+    instance_ranges_.clear();
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
+auto DecisionTree0<FEATURETYPE, LABELTYPE, RANDENGINE>::compact() -> std::vector<typename Graph::index_type>
+{
+    auto const node_ids = tree_.compact();
+    remap_node_map(node_main_label_, node_ids);
+    remap_node_map(label_probs_, node_ids);
+    remap_node_map(instance_count_, node_ids);
+    remap_node_map(node_splits_, node_ids);
+    remap_node_map(instance_ranges_, node_ids);
+    return node_ids;
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
+template <typename ACCESSOR>
+auto DecisionTree0<FEATURETYPE, LABELTYPE, RANDENGINE>::leaf_node(
+        ACCESSOR const & feats
+) const -> Node
+{
+    Node node = tree_.getRoot();
+    while (tree_.outDegree(node) > 0)
+    {
+        auto const & s = node_splits_.at(node);
+        if (feats(s.feature_index) < s.thresh)
+        {
+            node = tree_.getChild(node, 0);
+        }
+        else
+        {
+            node = tree_.getChild(node, 1);
+        }
+    }
+    return node;
+}
+
+
+
+/// \brief Decision jungle: a decision DAG that is grown level by level with a bounded number of nodes per level.
+///
+/// Each level is built as follows: every node of the previous level gets an initial split from the split functor
+/// and its two children are assigned to the (at most max_width) nodes of the new level, so children of different
+/// parents are merged. Then the splits and the child assignments are optimized alternately to minimize the summed
+/// impurity of the new level. The memory thus grows linearly in the depth instead of exponentially.
+/// SPLITFUNCTOR must provide the interface of JungleSplit.
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE = MersenneTwister>
+class DecisionJungle0
+{
+public:
+
+    typedef DAGraph0 Graph;
+    typedef typename Graph::Node Node;
+    typedef FEATURETYPE FeatureType;
+    typedef LABELTYPE LabelType;
+    typedef detail::Split<FeatureType> Split;
+    typedef RANDENGINE Randengine;
+
+    template <typename T>
+    using NodeMap = typename Graph::template NodeMap<T>;
+
+    DecisionJungle0(size_t const seed)
+        : graph_(),
+          root_(lemon::INVALID),
+          num_labels_(0),
+          num_features_(0),
+          randengine_(seed)
+    {}
+
+    DecisionJungle0(DecisionJungle0 const &) = default;
+    DecisionJungle0(DecisionJungle0 &&) = default;
+    ~DecisionJungle0() = default;
+    DecisionJungle0 & operator=(DecisionJungle0 const &) = default;
+    DecisionJungle0 & operator=(DecisionJungle0 &&) = default;
+
+    /// \brief Train the decision jungle.
+    ///
+    /// \note Before calling train, you must call set_num_labels with a value larger than the maximum value in data_y.
+    /// \note Since merged nodes may stay impure, the termination must restrict the depth (see MaxDepthTermination).
+    template <typename FEATURES, typename LABELS, typename SAMPLER, typename TERMINATION, typename SPLITFUNCTOR>
+    void train(
+            FEATURES const & data_x,
+            LABELS const & data_y,
+            SAMPLER const & sampler = SAMPLER(),
+            TERMINATION const & termination = TERMINATION(),
+            SPLITFUNCTOR const & functor = SPLITFUNCTOR()
+    );
+
+    /// \brief Predict new data using the jungle.
+    template <typename FEATURES, typename LABELS>
+    void predict(
+            FEATURES const & test_x,
+            LABELS & pred_y
+    ) const;
+
+    /// \brief Return the number of labels.
+    size_t get_num_labels() const
+    {
+        return num_labels_;
+    }
+
+    /// \brief Set the number of labels.
+    void set_num_labels(size_t num_labels)
+    {
+        num_labels_ = num_labels;
+    }
+
+    /// \brief Return the number of nodes.
+    size_t num_nodes() const
+    {
+        return graph_.maxNodeId()+1;
+    }
+
+    /// \brief Return the number of leaves.
+    size_t num_leaves() const
+    {
+        return std::distance(graph_.leaves_cbegin(), graph_.leaves_cend());
+    }
+
+    /// \brief Return the graph structure.
+    Graph const & get_graph() const
+    {
+        return graph_;
+    }
+
+    /// \brief Return the root node.
+    Node get_root() const
+    {
+        return root_;
+    }
+
+    /// \brief Return the node splits.
+    NodeMap<Split> const & node_splits() const
+    {
+        return node_splits_;
+    }
+
+    /// \brief Return the left and right child of each inner node (they are always different nodes).
+    NodeMap<std::pair<Node, Node> > const & node_children() const
+    {
+        return node_children_;
+    }
+
+    /// \brief Return true if the node is a leaf.
+    bool is_leaf(Node const & node) const
+    {
+        return graph_.isLeafNode(node);
+    }
+
+    /// \brief Return the left and the right child of an inner node.
+    std::pair<Node, Node> children(Node const & node) const
+    {
+        return node_children_.at(node);
+    }
+
+    /// \brief Return the number of features of the training data.
+    size_t num_features() const
+    {
+        return num_features_;
+    }
+
+    /// \brief Return the node labels.
+    NodeMap<LabelType> const & node_main_label() const
+    {
+        return node_main_label_;
+    }
+
+    /// \brief Return the class probabilities.
+    NodeMap<std::vector<double> > const & label_probs() const
+    {
+        return label_probs_;
+    }
+
+    /// \brief Return the number of instances in each leaf.
+    NodeMap<size_t> const & instance_count() const
+    {
+        return instance_count_;
+    }
+
+    /// \brief Return the node ids of the leaves that contain the given instances.
+    template <typename FEATURES>
+    void leaf_ids(
+            FEATURES const & features,
+            MultiArrayView<1, size_t> & indices
+    ) const;
+
+    /// \brief Return the leaf that is reached by an instance, where feats(j) returns the j-th feature of the instance.
+    template <typename ACCESSOR>
+    Node leaf_node(ACCESSOR const & feats) const;
+
+    /// \brief Return true if the given training instance was not part of the bootstrap sample (out-of-bag).
+    bool is_oob(size_t instance) const
+    {
+        return is_oob_[instance];
+    }
+
+    /// \brief Return the out-of-bag flag of each training instance.
+    std::vector<bool> const & oob_instances() const
+    {
+        return is_oob_;
+    }
+
+    /// \brief Return the impurity decrease (weighted with the number of instances) of all splits on each feature.
+    std::vector<double> const & gini_importance() const
+    {
+        return gini_importance_;
+    }
+
+protected:
+
+    /// \brief The graph structure.
+    Graph graph_;
+
+    /// \brief The root node.
+    Node root_;
+
+    /// \brief The left and right child of each inner node.
+    NodeMap<std::pair<Node, Node> > node_children_;
+
+    /// \brief The node labels that were found in training.
+    NodeMap<LabelType> node_main_label_;
+
+    /// \brief Node map with the probabilities of the classes in each leaf.
+    NodeMap<std::vector<double> > label_probs_;
+
+    /// \brief The number of instances in each leaf.
+    NodeMap<size_t> instance_count_;
+
+    /// \brief The split of each node.
+    NodeMap<Split> node_splits_;
+
+    /// \brief Bitset that is true for the training instances that were not in the bootstrap sample.
+    std::vector<bool> is_oob_;
+
+    /// \brief The summed impurity decrease of the splits on each feature.
+    std::vector<double> gini_importance_;
+
+    /// \brief The number of distinct labels.
+    size_t num_labels_;
+
+    /// \brief The number of features of the training data.
+    size_t num_features_;
+
+    /// \brief The random engine.
+    Randengine randengine_;
+
+};
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
+template <typename FEATURES, typename LABELS, typename SAMPLER, typename TERMINATION, typename SPLITFUNCTOR>
+void DecisionJungle0<FEATURETYPE, LABELTYPE, RANDENGINE>::train(
+        FEATURES const & features,
+        LABELS const & labels,
+        SAMPLER const & sampler,
+        TERMINATION const & termination,
+        SPLITFUNCTOR const & functor
+){
+    typedef typename SPLITFUNCTOR::Scorer Scorer;
+    typedef std::vector<size_t>::iterator Iter;
+    typedef std::vector<double> Counts;
+    typedef detail::SplitBufferItem<typename FEATURES::value_type> Item;
+
+    static_assert(std::is_convertible<typename FEATURES::value_type, FeatureType>(),
+                  "DecisionJungle0::train(): Wrong feature type.");
+    static_assert(std::is_convertible<typename LABELS::value_type, LabelType>(),
+                  "DecisionJungle0::train(): Wrong label type.");
+
+    vigra_precondition(num_labels_ > 0, "DecisionJungle0::train(): The number of distinct labels must be set before training.");
+    size_t const max_depth = termination.max_depth();
+    vigra_precondition(max_depth != std::numeric_limits<size_t>::max(),
+                       "DecisionJungle0::train(): The termination must restrict the depth, since merged nodes may stay impure.");
+
+    // Create the bootstrap sample (distinct instances with weights) and remember the out-of-bag instances.
+    std::vector<size_t> instance_indices;
+    BootstrapWeights instance_weights;
+    sampler.bootstrap_sample(labels.size(), randengine_, instance_indices, instance_weights);
+    vigra_precondition(!instance_indices.empty(), "DecisionJungle0::train(): The bootstrap sample is empty.");
+    is_oob_.assign(labels.size(), true);
+    for (size_t i : instance_indices)
+    {
+        is_oob_[i] = false;
+    }
+    size_t const num_features = features.shape()[1];
+    num_features_ = num_features;
+    gini_importance_.assign(num_features, 0.);
+
+    graph_ = Graph();
+    node_children_.clear();
+    node_main_label_.clear();
+    label_probs_.clear();
+    instance_count_.clear();
+    node_splits_.clear();
+
+    size_t const max_width = functor.max_width();
+    size_t const num_iterations = functor.num_iterations();
+    size_t const min_leaf_size = termination.min_leaf_size();
+    size_t const num_feats = functor.num_candidate_features(num_features);
+    UniformIntRandomFunctor<RANDENGINE> rand(randengine_);
+
+    // Create a named lambda that adds the (weighted) label counts of the given instances to counts.
+    auto add_counts = [&](Iter begin, Iter end, Counts & counts) {
+        for (auto it = begin; it != end; ++it)
+        {
+            counts[labels(*it)] += instance_weights[*it];
+        }
+    };
+
+    // Create a named lambda that makes a node terminal.
+    auto make_leaf = [&](Node const & node, std::vector<size_t> const & instances) {
+        double total_weight = 0.;
+        std::vector<double> probs(num_labels_);
+        for (size_t i : instances)
+        {
+            total_weight += instance_weights[i];
+            probs[labels(i)] += instance_weights[i];
+        }
+        size_t const main_label = std::distance(probs.begin(), std::max_element(probs.begin(), probs.end()));
+        for (size_t i = 0; i < probs.size(); ++i)
+        {
+            probs[i] /= total_weight;
+        }
+        label_probs_.emplace(node, probs);
+        instance_count_[node] = instances.size();
+        node_main_label_[node] = static_cast<LabelType>(main_label);
+    };
+
+    double root_weight = 0.;
+    for (size_t i : instance_indices)
+    {
+        root_weight += instance_weights[i];
+    }
+
+    // The nodes of the current level and their instances.
+    root_ = graph_.addNode();
+    std::vector<Node> level_nodes {root_};
+    std::vector<std::vector<size_t> > level_instances {instance_indices};
+
+    for (size_t depth = 0; !level_nodes.empty(); ++depth)
+    {
+        // Find the initial split of each node or make it a leaf (all nodes at the maximum depth are leaves).
+        std::vector<size_t> parents;
+        std::vector<Split> splits;
+        for (size_t k = 0; k < level_nodes.size(); ++k)
+        {
+            auto & instances = level_instances[k];
+            Iter begin = instances.begin();
+            Iter end = instances.end();
+            sampler.split_sample(begin, end);
+            Split s;
+            Iter split_iter;
+            double impurity_decrease;
+            bool split_found = false;
+            if (depth < max_depth && !termination.stop(begin, end, labels, depth))
+            {
+                split_found = functor.split(begin, end, features, labels, instance_weights, num_labels_, randengine_,
+                                            s.feature_index, s.thresh, split_iter, impurity_decrease, min_leaf_size);
+                if (split_found)
+                {
+                    size_t const num_left = std::distance(begin, split_iter);
+                    size_t const num_right = std::distance(split_iter, end);
+                    split_found = !termination.reject_split(depth, num_left, num_right, impurity_decrease / root_weight);
+                }
+            }
+            if (split_found)
+            {
+                parents.push_back(k);
+                splits.push_back(s);
+            }
+            else
+            {
+                make_leaf(level_nodes[k], instances);
+            }
+        }
+        if (parents.empty())
+            break;
+
+        // Assign the children: initially, the children of different parents are only merged if the width is exceeded.
+        size_t const num_parents = parents.size();
+        size_t const width = std::min(max_width, 2*num_parents);
+        std::vector<std::array<size_t, 2> > child(num_parents);
+        std::vector<std::array<Counts, 2> > parent_counts(num_parents, {{Counts(num_labels_), Counts(num_labels_)}});
+        std::vector<Counts> child_counts(width, Counts(num_labels_));
+        auto partition = [&](size_t i) {
+            auto & instances = level_instances[parents[i]];
+            Split const & s = splits[i];
+            return std::partition(instances.begin(), instances.end(),
+                    [& features, & s](size_t instance_index)
+                    {
+                        return features(instance_index, s.feature_index) < s.thresh;
+                    }
+            );
+        };
+        for (size_t i = 0; i < num_parents; ++i)
+        {
+            child[i] = {{(2*i) % width, (2*i+1) % width}};
+            auto & instances = level_instances[parents[i]];
+            Iter const split_iter = partition(i);
+            add_counts(instances.begin(), split_iter, parent_counts[i][0]);
+            add_counts(split_iter, instances.end(), parent_counts[i][1]);
+            for (size_t side = 0; side < 2; ++side)
+            {
+                Counts & c = child_counts[child[i][side]];
+                for (size_t l = 0; l < num_labels_; ++l)
+                {
+                    c[l] += parent_counts[i][side][l];
+                }
+            }
+        }
+
+        // Alternately optimize the splits and the child assignments, until the impurity does not decrease anymore.
+        Counts left(num_labels_), right(num_labels_), other_left(num_labels_), other_right(num_labels_), moved(num_labels_);
+        std::vector<size_t> feat_indices(num_features);
+        std::vector<Item> buffer, tmp;
+        for (size_t iter = 0; iter < num_iterations; ++iter)
+        {
+            bool changed = false;
+
+            // Optimize the split of each parent with fixed children.
+            for (size_t i = 0; i < num_parents; ++i)
+            {
+                size_t const c0 = child[i][0];
+                size_t const c1 = child[i][1];
+                vigra_assert(c0 != c1, "DecisionJungle0::train(): Both children of a node are the same.");
+                for (size_t l = 0; l < num_labels_; ++l)
+                {
+                    other_left[l] = child_counts[c0][l] - parent_counts[i][0][l];
+                    other_right[l] = child_counts[c1][l] - parent_counts[i][1][l];
+                }
+                double const current_score = Scorer::node_score(child_counts[c0]) + Scorer::node_score(child_counts[c1]);
+                double best_score = current_score;
+                Split best_split = splits[i];
+
+                // Try the splits on a random feature subset. As in RandomSplit, the values of each feature are
+                // gathered into a contiguous buffer (together with the labels and weights), sorted there and swept.
+                std::iota(feat_indices.begin(), feat_indices.end(), 0);
+                for (size_t k = 0; k < num_feats; ++k)
+                {
+                    size_t j = k + (rand(num_features-k));
+                    std::swap(feat_indices[k], feat_indices[j]);
+                }
+                auto & instances = level_instances[parents[i]];
+                size_t const num_instances = instances.size();
+                buffer.resize(num_instances);
+                for (size_t k = 0; k < num_feats; ++k)
+                {
+                    auto const feat = feat_indices[k];
+                    for (size_t n = 0; n < num_instances; ++n)
+                    {
+                        size_t const instance = instances[n];
+                        auto const value = features(instance, feat);
+                        buffer[n] = {detail::radix_key(value), value, static_cast<size_t>(labels(instance)), instance_weights[instance]};
+                    }
+                    detail::radix_sort(buffer, tmp);
+                    left = other_left;
+                    for (size_t l = 0; l < num_labels_; ++l)
+                    {
+                        right[l] = other_right[l] + parent_counts[i][0][l] + parent_counts[i][1][l];
+                    }
+                    for (size_t n = 0; n+1 < num_instances; ++n)
+                    {
+                        size_t const label = buffer[n].label;
+                        left[label] += buffer[n].weight;
+                        right[label] -= buffer[n].weight;
+                        auto const left_value = buffer[n].value;
+                        auto const right_value = buffer[n+1].value;
+                        if (left_value == right_value)
+                            continue;
+                        if (n+1 < min_leaf_size || num_instances-n-1 < min_leaf_size)
+                            continue;
+                        double const score = Scorer::node_score(left) + Scorer::node_score(right);
+                        if (score < best_score)
+                        {
+                            best_score = score;
+                            best_split.feature_index = feat;
+                            best_split.thresh = 0.5*(left_value+right_value);
+                        }
+                    }
+                }
+
+                // Apply the best split, if it is better by more than rounding errors.
+                if (best_score < current_score - 1e-9 * std::abs(current_score))
+                {
+                    splits[i] = best_split;
+                    Iter const split_iter = partition(i);
+                    std::fill(parent_counts[i][0].begin(), parent_counts[i][0].end(), 0.);
+                    std::fill(parent_counts[i][1].begin(), parent_counts[i][1].end(), 0.);
+                    add_counts(instances.begin(), split_iter, parent_counts[i][0]);
+                    add_counts(split_iter, instances.end(), parent_counts[i][1]);
+                    for (size_t l = 0; l < num_labels_; ++l)
+                    {
+                        child_counts[c0][l] = other_left[l] + parent_counts[i][0][l];
+                        child_counts[c1][l] = other_right[l] + parent_counts[i][1][l];
+                    }
+                    changed = true;
+                }
+            }
+
+            // Optimize the child of each branch with fixed splits.
+            // A branch must not move to the child of the other branch of the same parent, since that would create duplicate arcs.
+            for (size_t i = 0; i < num_parents; ++i)
+            {
+                for (size_t side = 0; side < 2; ++side)
+                {
+                    Counts const & h = parent_counts[i][side];
+                    size_t const c0 = child[i][side];
+                    size_t const sibling = child[i][1-side];
+                    for (size_t l = 0; l < num_labels_; ++l)
+                    {
+                        moved[l] = child_counts[c0][l] - h[l];
+                    }
+                    double const remove_gain = Scorer::node_score(child_counts[c0]) - Scorer::node_score(moved);
+                    double best_delta = 0.;
+                    size_t best_child = c0;
+                    for (size_t c = 0; c < width; ++c)
+                    {
+                        if (c == c0 || c == sibling)
+                            continue;
+                        for (size_t l = 0; l < num_labels_; ++l)
+                        {
+                            left[l] = child_counts[c][l] + h[l];
+                        }
+                        double const delta = Scorer::node_score(left) - Scorer::node_score(child_counts[c]) - remove_gain;
+                        if (delta < best_delta - 1e-9 * std::abs(remove_gain))
+                        {
+                            best_delta = delta;
+                            best_child = c;
+                        }
+                    }
+                    if (best_child != c0)
+                    {
+                        for (size_t l = 0; l < num_labels_; ++l)
+                        {
+                            child_counts[c0][l] -= h[l];
+                            child_counts[best_child][l] += h[l];
+                        }
+                        child[i][side] = best_child;
+                        changed = true;
+                    }
+                }
+            }
+
+            if (!changed)
+                break;
+        }
+
+        // Create the nodes of the next level and pass the instances to them.
+        std::vector<Node> child_nodes(width, Node(lemon::INVALID));
+        std::vector<std::vector<size_t> > child_instances(width);
+        for (size_t i = 0; i < num_parents; ++i)
+        {
+            Node const parent = level_nodes[parents[i]];
+            auto & instances = level_instances[parents[i]];
+            Iter const split_iter = partition(i);
+            Iter const bounds[3] = {instances.begin(), split_iter, instances.end()};
+            for (size_t side = 0; side < 2; ++side)
+            {
+                size_t const c = child[i][side];
+                if (child_nodes[c] == lemon::INVALID)
+                    child_nodes[c] = graph_.addNode();
+                graph_.addArc(parent, child_nodes[c]);
+                child_instances[c].insert(child_instances[c].end(), bounds[side], bounds[side+1]);
+            }
+            node_splits_[parent] = splits[i];
+            node_children_[parent] = {child_nodes[child[i][0]], child_nodes[child[i][1]]};
+
+            Counts total(num_labels_);
+            add_counts(instances.begin(), instances.end(), total);
+            gini_importance_[splits[i].feature_index] += Scorer::node_score(total)
+                                                         - Scorer::node_score(parent_counts[i][0])
+                                                         - Scorer::node_score(parent_counts[i][1]);
+        }
+        level_nodes.clear();
+        level_instances.clear();
+        for (size_t c = 0; c < width; ++c)
+        {
+            if (child_nodes[c] == lemon::INVALID)
+                continue;
+            level_nodes.push_back(child_nodes[c]);
+            level_instances.push_back(std::move(child_instances[c]));
+        }
+    }
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
+template <typename FEATURES, typename LABELS>
+void DecisionJungle0<FEATURETYPE, LABELTYPE, RANDENGINE>::predict(
+        FEATURES const & test_x,
+        LABELS & pred_y
+) const {
+    static_assert(std::is_convertible<typename FEATURES::value_type, FeatureType>(),
+                  "DecisionJungle0::predict(): Wrong feature type.");
+    static_assert(std::is_convertible<LabelType, typename LABELS::value_type>(),
+                  "DecisionJungle0::predict(): Wrong label type.");
+
+    vigra_assert(graph_.valid(root_), "DecisionJungle0::predict(): The graph has no root node.");
+
+    for (size_t i = 0; i < test_x.num_instances(); ++i)
+    {
+        auto const feats = test_x.instance_features(i);
+        Node const node = leaf_node(feats);
+        pred_y(i) = node_main_label_.at(node);
+    }
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
+template <typename FEATURES>
+void DecisionJungle0<FEATURETYPE, LABELTYPE, RANDENGINE>::leaf_ids(
+        FEATURES const & features,
+        MultiArrayView<1, size_t> & indices
+) const {
+    static_assert(std::is_convertible<typename FEATURES::value_type, FeatureType>(),
+                  "DecisionJungle0::leaf_ids(): Wrong feature type.");
+
+    size_t const num_instances = features.shape()[0];
+
+    vigra_precondition(num_instances == static_cast<size_t>(indices.size()),
+                       "DecisionJungle0::leaf_ids(): Shape mismatch.");
+
+    vigra_assert(graph_.valid(root_), "DecisionJungle0::leaf_ids(): The graph has no root node.");
+
+    for (size_t i = 0; i < num_instances; ++i)
+    {
+        Node const node = leaf_node(
+                [& features, i](size_t j)
+                {
+                    return features(i, j);
+                }
+        );
+        indices(i) = node.id();
+    }
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
+template <typename ACCESSOR>
+auto DecisionJungle0<FEATURETYPE, LABELTYPE, RANDENGINE>::leaf_node(
+        ACCESSOR const & feats
+) const -> Node
+{
+    Node node = root_;
+    while (!graph_.isLeafNode(node))
+    {
+        auto const & s = node_splits_.at(node);
+        auto const & children = node_children_.at(node);
+        node = (feats(s.feature_index) < s.thresh) ? children.first : children.second;
+    }
+    return node;
+}
+
+
+
+namespace detail
+{
+
+    /// \brief Trees that can be written with serialize and restored with deserialize.
+    template <typename TREE>
+    struct IsSerializableTree : std::false_type
+    {};
+
+    template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
+    struct IsSerializableTree<DecisionTree0<FEATURETYPE, LABELTYPE, RANDENGINE> > : std::true_type
+    {};
+
+} // namespace detail
+
+
+
+template <typename FEATURETYPE, typename LABELTYPE>
+class MergedForest;
+
+template <typename FEATURETYPE, typename LABELTYPE>
+class ForestPredictor;
+
+
+
+/// \brief Random forest class.
+///
+/// TREE is the type of the single trees, it must use size_t labels and be constructible from a seed
+/// (DecisionTree0 or DecisionJungle0).
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE = MersenneTwister,
+          typename TREE = DecisionTree0<FEATURETYPE, size_t, RANDENGINE> >
+class RandomForest0
+{
+public:
+
+    typedef FEATURETYPE FeatureType;
+    typedef LABELTYPE LabelType;
+    typedef TREE Tree;
+    typedef typename Tree::Node TreeNode;
+
+    static_assert(std::is_same<typename Tree::LabelType, size_t>(),
+                  "RandomForest0: The trees must use size_t labels.");
+
+    RandomForest0(RANDENGINE const & randengine = RANDENGINE::global())
+        : randengine_(randengine)
+    {}
+
+    RandomForest0(RandomForest0 const &) = default;
+    RandomForest0(RandomForest0 &&) = default;
+    ~RandomForest0() = default;
+    RandomForest0 & operator=(RandomForest0 const &) = default;
+    RandomForest0 & operator=(RandomForest0 &&) = default;
+
+    /// \brief Train the random forest.
+    ///
+    /// The sampler, the termination criterion and the split functor are passed to each tree.
+    template <typename FEATURES, typename LABELS, typename SAMPLER, typename TERMINATION, typename SPLITFUNCTOR>
+    void train(
+            FEATURES const & train_x,
+            LABELS const & train_y,
+            size_t num_trees,
+            int num_threads = -1,
+            SAMPLER const & sampler = SAMPLER(),
+            TERMINATION const & termination = TERMINATION(),
+            SPLITFUNCTOR const & functor = SPLITFUNCTOR()
+    );
+
+    /// \brief Train additional trees on the given data and append them to the forest.
+    ///
+    /// The existing trees are not touched. Labels that did not occur so far are appended to the distinct labels,
+    /// so the internal label ids of the existing trees remain valid.
+    template <typename FEATURES, typename LABELS, typename SAMPLER, typename TERMINATION, typename SPLITFUNCTOR>
+    void add_trees(
+            FEATURES const & train_x,
+            LABELS const & train_y,
+            size_t num_trees,
+            int num_threads = -1,
+            SAMPLER const & sampler = SAMPLER(),
+            TERMINATION const & termination = TERMINATION(),
+            SPLITFUNCTOR const & functor = SPLITFUNCTOR()
+    );
+
+    /// \brief Append the trees that were written by train_trees_from_segment (see randomforest_multiprocess.hxx).
+    ///
+    /// Each string holds the trees of one worker, in the order of the seeds. The trees use the label ids of the given
+    /// distinct labels, which must start with the current distinct labels. The forest is only changed after all trees were read.
+    void add_serialized_trees(
+            std::vector<std::string> const & data,
+            std::vector<LabelType> const & distinct_labels
+    );
+
+    /// \brief Return the distinct labels with the labels that were not seen so far appended.
+    template <typename LABELS>
+    std::vector<LabelType> extended_distinct_labels(LABELS const & labels) const;
+
+    /// \brief Draw num_trees distinct seeds for new trees (add_trees uses the same seeds with the same random engine).
+    std::vector<size_t> draw_seeds(size_t num_trees) const;
+
+    /// \brief Remove the given number of trees, starting with the oldest one.
+    void retire_trees(size_t num_trees);
+
+    /// \brief Train num_trees new trees on the given data and retire the num_trees oldest trees.
+    template <typename FEATURES, typename LABELS, typename SAMPLER, typename TERMINATION, typename SPLITFUNCTOR>
+    void replace_trees(
+            FEATURES const & train_x,
+            LABELS const & train_y,
+            size_t num_trees,
+            int num_threads = -1,
+            SAMPLER const & sampler = SAMPLER(),
+            TERMINATION const & termination = TERMINATION(),
+            SPLITFUNCTOR const & functor = SPLITFUNCTOR()
+    );
+
+    /// \brief Predict new data using the forest.
+    template <typename FEATURES, typename LABELS>
+    void predict(
+            FEATURES const & test_x,
+            LABELS & pred_y
+    ) const;
+
+    /// \brief Return the tree vector.
+    std::vector<Tree> & trees()
+    {
+        return dtrees_;
+    }
+
+
+    /// \brief Return the tree vector.
+    std::vector<Tree> const & trees() const
+    {
+        return dtrees_;
+    }
+
+    /// \brief Return the number of trees.
+    size_t num_trees() const
+    {
+        return dtrees_.size();
+    }
+
+    /// \brief Return the number of classes.
+    size_t num_classes() const
+    {
+        return distinct_labels_.size();
+    }
+
+    /// \brief For each tree return the node ids of the leaves that contain the given instances.
+    template <typename FEATURES>
+    void leaf_ids(
+            FEATURES const & features,
+            MultiArrayView<2, size_t> & indices
+    ) const;
+
+    /// \brief Transform the given external labels to the labels that are used internally.
+    template <typename LABELS>
+    void transform_external_labels(
+            LABELS const & labels_in,
+            MultiArrayView<1, size_t> & labels_out
+    ) const;
+
+    /// \brief Compute the class probabilities of the training instances using only the trees where the instance is out-of-bag.
+    /// \param features: the training features (the same that were used in train)
+    /// \param probs[out]: num_instances x num_classes array, rows of instances that were never out-of-bag are set to zero
+    template <typename FEATURES>
+    void oob_predict_probabilities(
+            FEATURES const & features,
+            MultiArrayView<2, double> & probs,
+            int num_threads = -1
+    ) const;
+
+    /// \brief Return the out-of-bag error on the training instances (instances that were never out-of-bag are ignored).
+    template <typename FEATURES, typename LABELS>
+    double oob_error(
+            FEATURES const & features,
+            LABELS const & labels,
+            int num_threads = -1
+    ) const;
+
+    /// \brief Return the impurity decrease of each feature, summed over all trees and normalized to sum 1.
+    std::vector<double> gini_importance() const;
+
+    /// \brief Compute the permutation importance of each feature: the mean decrease of the out-of-bag accuracy of a tree if the feature values are permuted among its out-of-bag instances.
+    /// \param features: the training features (the same that were used in train)
+    /// \param labels: the training labels
+    /// \param importance[out]: the importance of each feature
+    template <typename FEATURES, typename LABELS>
+    void permutation_importance(
+            FEATURES const & features,
+            LABELS const & labels,
+            std::vector<double> & importance,
+            int num_threads = -1
+    ) const;
+
+    /// \brief Return the forest with identical subtrees merged into a decision DAG (the nodes of jungles are merged as well).
+    MergedForest<FeatureType, LabelType> merge() const
+    {
+        MergedForest<FeatureType, LabelType> merged;
+        merged.build(dtrees_, distinct_labels_);
+        return merged;
+    }
+
+    /// \brief Return an immutable single instance predictor of the forest.
+    ForestPredictor<FeatureType, LabelType> predictor() const
+    {
+        ForestPredictor<FeatureType, LabelType> p;
+        p.build(dtrees_, distinct_labels_);
+        return p;
+    }
+
+protected:
+
+    /// \brief Append the labels that were not seen so far, so the label ids of the existing trees stay valid.
+    template <typename LABELS>
+    void append_distinct_labels(LABELS const & labels);
+
+    /// \brief The trees of the forest.
+    std::vector<Tree> dtrees_;
+
+    /// \brief The distinct labels that were found in training.
+    std::vector<LabelType> distinct_labels_;
+
+    /// \brief The random engine.
+    RANDENGINE const & randengine_;
+
+};
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE, typename TREE>
+template <typename FEATURES, typename LABELS, typename SAMPLER, typename TERMINATION, typename SPLITFUNCTOR>
+void RandomForest0<FEATURETYPE, LABELTYPE, RANDENGINE, TREE>::train(
+        FEATURES const & data_x,
+        LABELS const & data_y,
+        size_t const num_trees,
+        int num_threads,
+        SAMPLER const & sampler,
+        TERMINATION const & termination,
+        SPLITFUNCTOR const & functor
+){
+    dtrees_.clear();
+    distinct_labels_.clear();
+    add_trees<FEATURES, LABELS, SAMPLER, TERMINATION, SPLITFUNCTOR>(
+                data_x, data_y, num_trees, num_threads, sampler, termination, functor);
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE, typename TREE>
+template <typename FEATURES, typename LABELS, typename SAMPLER, typename TERMINATION, typename SPLITFUNCTOR>
+void RandomForest0<FEATURETYPE, LABELTYPE, RANDENGINE, TREE>::add_trees(
+        FEATURES const & data_x,
+        LABELS const & data_y,
+        size_t const num_trees,
+        int num_threads,
+        SAMPLER const & sampler,
+        TERMINATION const & termination,
+        SPLITFUNCTOR const & functor
+){
+    static_assert(std::is_convertible<typename FEATURES::value_type, FeatureType>(),
+                  "RandomForest0::add_trees(): Wrong feature type.");
+    static_assert(std::is_convertible<typename LABELS::value_type, LabelType>(),
+                  "RandomForest0::add_trees(): Wrong label type.");
+
+    vigra_precondition(num_threads == -1 || num_threads > 0,
+                       "RandomForest0::add_trees(): n_threads must be -1 or greater than zero.");
+
+    append_distinct_labels(data_y);
+
+    // Translate the labels to the label ids.
+    MultiArray<1, size_t> data_y_id_arr(data_y.shape());
+    transform_external_labels(data_y, data_y_id_arr);
+    LabelGetter<size_t> const data_y_id(data_y_id_arr);
+
+    // Initialize the new trees with the seeds.
+    size_t const first_tree = dtrees_.size();
+    dtrees_.reserve(first_tree + num_trees);
+    for (size_t const seed : draw_seeds(num_trees))
+    {
+        dtrees_.push_back(Tree(seed));
+    }
+
+    // Create a named lambda to train a single new tree with index k.
+    auto train_tree = [this, first_tree, & data_x, & data_y_id, & sampler, & termination, & functor](size_t k) {
+        Tree & tree = dtrees_[first_tree + k];
+        tree.set_num_labels(distinct_labels_.size());
+        tree.template train<FEATURES, LabelGetter<size_t>, SAMPLER, TERMINATION, SPLITFUNCTOR>(
+                    data_x, data_y_id, sampler, termination, functor);
+    };
+
+    // Train each new tree.
+    detail::parallel_for(num_trees, num_threads, train_tree);
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE, typename TREE>
+void RandomForest0<FEATURETYPE, LABELTYPE, RANDENGINE, TREE>::add_serialized_trees(
+        std::vector<std::string> const & data,
+        std::vector<LabelType> const & distinct_labels
+){
+    static_assert(detail::IsSerializableTree<Tree>(),
+                  "RandomForest0::add_serialized_trees(): Only forests of DecisionTree0 can be serialized.");
+
+    vigra_precondition(distinct_labels.size() >= distinct_labels_.size()
+                       && std::equal(distinct_labels_.begin(), distinct_labels_.end(), distinct_labels.begin()),
+                       "RandomForest0::add_serialized_trees(): The distinct labels must start with the current distinct labels.");
+
+    // Read all trees before the forest is changed.
+    std::vector<Tree> trees;
+    for (auto const & d : data)
+    {
+        std::istringstream is(d);
+        UInt64 num_trees;
+        detail::read_binary(is, num_trees);
+        for (size_t k = 0; k < num_trees; ++k)
+        {
+            Tree tree(0);
+            tree.deserialize(is);
+            vigra_precondition(tree.get_num_labels() <= distinct_labels.size(),
+                               "RandomForest0::add_serialized_trees(): The tree uses unknown labels.");
+            trees.push_back(std::move(tree));
+        }
+    }
+    distinct_labels_ = distinct_labels;
+    dtrees_.reserve(dtrees_.size() + trees.size());
+    std::move(trees.begin(), trees.end(), std::back_inserter(dtrees_));
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE, typename TREE>
+template <typename LABELS>
+std::vector<LABELTYPE> RandomForest0<FEATURETYPE, LABELTYPE, RANDENGINE, TREE>::extended_distinct_labels(
+        LABELS const & labels
+) const {
+    std::set<LabelType> dlabels(labels.begin(), labels.end());
+    for (auto const & l : distinct_labels_)
+    {
+        dlabels.erase(l);
+    }
+    std::vector<LabelType> extended(distinct_labels_);
+    extended.insert(extended.end(), dlabels.begin(), dlabels.end());
+    return extended;
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE, typename TREE>
+template <typename LABELS>
+void RandomForest0<FEATURETYPE, LABELTYPE, RANDENGINE, TREE>::append_distinct_labels(
+        LABELS const & labels
+){
+    distinct_labels_ = extended_distinct_labels(labels);
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE, typename TREE>
+std::vector<size_t> RandomForest0<FEATURETYPE, LABELTYPE, RANDENGINE, TREE>::draw_seeds(
+        size_t const num_trees
+) const {
+    // Make sure that the seeds are all different, but keep them in the order they were drawn.
+    UniformIntRandomFunctor<RANDENGINE> rand(randengine_);
+    std::set<size_t> drawn;
+    std::vector<size_t> seeds;
+    seeds.reserve(num_trees);
+    while (seeds.size() < num_trees)
+    {
+        size_t const seed = rand();
+        if (drawn.insert(seed).second)
+            seeds.push_back(seed);
+    }
+    return seeds;
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE, typename TREE>
+void RandomForest0<FEATURETYPE, LABELTYPE, RANDENGINE, TREE>::retire_trees(
+        size_t const num_trees
+){
+    vigra_precondition(num_trees <= dtrees_.size(),
+                       "RandomForest0::retire_trees(): Cannot retire more trees than the forest has.");
+    dtrees_.erase(dtrees_.begin(), dtrees_.begin() + num_trees);
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE, typename TREE>
+template <typename FEATURES, typename LABELS, typename SAMPLER, typename TERMINATION, typename SPLITFUNCTOR>
+void RandomForest0<FEATURETYPE, LABELTYPE, RANDENGINE, TREE>::replace_trees(
+        FEATURES const & data_x,
+        LABELS const & data_y,
+        size_t const num_trees,
+        int num_threads,
+        SAMPLER const & sampler,
+        TERMINATION const & termination,
+        SPLITFUNCTOR const & functor
+){
+    vigra_precondition(num_trees <= dtrees_.size(),
+                       "RandomForest0::replace_trees(): Cannot replace more trees than the forest has.");
+    add_trees<FEATURES, LABELS, SAMPLER, TERMINATION, SPLITFUNCTOR>(
+                data_x, data_y, num_trees, num_threads, sampler, termination, functor);
+    retire_trees(num_trees);
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE, typename TREE>
+template <typename FEATURES, typename LABELS>
+void RandomForest0<FEATURETYPE, LABELTYPE, RANDENGINE, TREE>::predict(
+        FEATURES const & test_x,
+        LABELS & pred_y
+) const {
+    // The features must be convertible to feature type, so we can put them into the forest.
+    static_assert(std::is_convertible<typename FEATURES::value_type, FeatureType>(),
+                  "RandomForest0::predict(): Wrong feature type.");
+
+    // The internal label type must be convertible to the labels, so we can put them into the output.
+    static_assert(std::is_convertible<LabelType, typename LABELS::value_type>(),
+                  "RandomForest0::predict(): Wrong label type.");
+
+    // Let each tree predict all instances.
+    size_t const num_instances = test_x.shape()[0];
+    MultiArray<2, size_t> labels(Shape2(num_instances, dtrees_.size()));
+    for (size_t i = 0; i < dtrees_.size(); ++i)
+    {
+        auto label_view = labels.template bind<1>(i);
+        dtrees_[i].predict(test_x, label_view);
+    }
+
+    // Find the majority vote.
+    std::vector<size_t> label_counts_vec(distinct_labels_.size());
+    for (size_t i = 0; i < num_instances; ++i)
+    {
+        // Count the labels.
+        std::fill(label_counts_vec.begin(), label_counts_vec.end(), 0);
+        for (size_t k = 0; k < dtrees_.size(); ++k)
+        {
+            size_t const label = labels(i, k);
+            if (label >= label_counts_vec.size())
+                vigra_fail("Prediction of a label that did not exist in training.");
+            ++label_counts_vec[label];
+        }
+
+        // Find the label with the maximum count.
+        size_t max_count = 0;
+        size_t max_label;
+        for (size_t k = 0; k < label_counts_vec.size(); ++k)
+        {
+            if (label_counts_vec[k] > max_count)
+            {
+                max_count = label_counts_vec[k];
+                max_label = k;
+            }
+        }
+
+        // Write the label in the output array.
+        pred_y(i) = distinct_labels_[max_label];
+    }
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE, typename TREE>
+template <typename FEATURES>
+void RandomForest0<FEATURETYPE, LABELTYPE, RANDENGINE, TREE>::leaf_ids(
+        FEATURES const & features,
+        MultiArrayView<2, size_t> & indices
+) const {
+    static_assert(std::is_convertible<typename FEATURES::value_type, FeatureType>(),
+                  "RandomForest0::leaf_indices(): Wrong feature type.");
+
+    vigra_precondition(indices.shape() == Shape2(features.shape()[0], dtrees_.size()),
+                       "RandomForest0::leaf_indices(): Shape mismatch.");
+
+    for (size_t i = 0; i < dtrees_.size(); ++i)
+    {
+        auto sub = indices.bind<1>(i);
+        dtrees_[i].leaf_ids(features, sub);
+    }
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE, typename TREE>
+template <typename LABELS>
+void RandomForest0<FEATURETYPE, LABELTYPE, RANDENGINE, TREE>::transform_external_labels(
+        LABELS const & labels_in,
+        MultiArrayView<1, size_t> & labels_out
+) const {
+    static_assert(std::is_convertible<typename LABELS::value_type, LabelType>(),
+                  "RandomForest0::transform_external_labels(): Wrong label type.");
+
+    vigra_precondition(labels_in.size() == labels_out.size(),
+                       "RandomForest0::transform_external_labels(): Shape mismatch.");
+
+    std::map<FeatureType, size_t> label_id;
+    for (size_t i = 0; i < distinct_labels_.size(); ++i)
+    {
+        label_id[distinct_labels_[i]] = i;
+    }
+    for (size_t i = 0; i < labels_in.size(); ++i)
+    {
+        labels_out(i) = label_id[labels_in(i)];
+    }
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE, typename TREE>
+template <typename FEATURES>
+void RandomForest0<FEATURETYPE, LABELTYPE, RANDENGINE, TREE>::oob_predict_probabilities(
+        FEATURES const & features,
+        MultiArrayView<2, double> & probs,
+        int num_threads
+) const {
+    static_assert(std::is_convertible<typename FEATURES::value_type, FeatureType>(),
+                  "RandomForest0::oob_predict_probabilities(): Wrong feature type.");
+
+    size_t const num_instances = features.shape()[0];
+    vigra_precondition(probs.shape() == Shape2(num_instances, distinct_labels_.size()),
+                       "RandomForest0::oob_predict_probabilities(): Shape mismatch.");
+    for (auto const & tree : dtrees_)
+    {
+        vigra_precondition(tree.oob_instances().size() == num_instances,
+                           "RandomForest0::oob_predict_probabilities(): The number of instances differs from training.");
+    }
+
+    // Split the instances into blocks and let each thread handle some of the blocks.
+    size_t const block_size = 256;
+    size_t const num_blocks = (num_instances + block_size - 1) / block_size;
+    detail::parallel_for(num_blocks, num_threads,
+            [this, & features, & probs, num_instances, block_size](size_t b)
+            {
+                size_t const end = std::min(num_instances, (b+1)*block_size);
+                for (size_t i = b*block_size; i < end; ++i)
+                {
+                    auto const feats = [& features, i](size_t j)
+                    {
+                        return features(i, j);
+                    };
+                    auto row = probs.template bind<0>(i);
+                    row = 0.;
+                    size_t count = 0;
+                    for (auto const & tree : dtrees_)
+                    {
+                        if (!tree.is_oob(i))
+                            continue;
+                        auto const & leaf_probs = tree.label_probs().at(tree.leaf_node(feats));
+                        for (size_t c = 0; c < leaf_probs.size(); ++c)
+                        {
+                            row(c) += leaf_probs[c];
+                        }
+                        ++count;
+                    }
+                    if (count > 0)
+                    {
+                        size_t const num_classes = row.size();
+                        for (size_t c = 0; c < num_classes; ++c)
+                        {
+                            row(c) /= count;
+                        }
+                    }
+                }
+            }
+    );
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE, typename TREE>
+template <typename FEATURES, typename LABELS>
+double RandomForest0<FEATURETYPE, LABELTYPE, RANDENGINE, TREE>::oob_error(
+        FEATURES const & features,
+        LABELS const & labels,
+        int num_threads
+) const {
+    static_assert(std::is_convertible<typename LABELS::value_type, LabelType>(),
+                  "RandomForest0::oob_error(): Wrong label type.");
+
+    size_t const num_instances = features.shape()[0];
+    vigra_precondition(labels.size() == num_instances,
+                       "RandomForest0::oob_error(): Shape mismatch.");
+
+    MultiArray<2, double> probs(Shape2(num_instances, distinct_labels_.size()));
+    oob_predict_probabilities(features, probs, num_threads);
+
+    MultiArray<1, size_t> label_ids((Shape1(num_instances)));
+    transform_external_labels(labels, label_ids);
+
+    size_t num_oob = 0;
+    size_t num_wrong = 0;
+    for (size_t i = 0; i < num_instances; ++i)
+    {
+        auto const row = probs.template bind<0>(i);
+        auto const max_it = std::max_element(row.begin(), row.end());
+        if (*max_it == 0)
+            continue; // the instance was never out-of-bag
+        ++num_oob;
+        if (static_cast<size_t>(std::distance(row.begin(), max_it)) != label_ids(i))
+            ++num_wrong;
+    }
+    vigra_precondition(num_oob > 0, "RandomForest0::oob_error(): There are no out-of-bag instances.");
+    return num_wrong / static_cast<double>(num_oob);
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE, typename TREE>
+std::vector<double> RandomForest0<FEATURETYPE, LABELTYPE, RANDENGINE, TREE>::gini_importance() const
+{
+    std::vector<double> importance;
+    for (auto const & tree : dtrees_)
+    {
+        auto const & tree_importance = tree.gini_importance();
+        importance.resize(std::max(importance.size(), tree_importance.size()), 0.);
+        for (size_t j = 0; j < tree_importance.size(); ++j)
+        {
+            importance[j] += tree_importance[j];
+        }
+    }
+    double const total = std::accumulate(importance.begin(), importance.end(), 0.);
+    if (total > 0)
+    {
+        for (auto & v : importance)
+        {
+            v /= total;
+        }
+    }
+    return importance;
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE, typename TREE>
+template <typename FEATURES, typename LABELS>
+void RandomForest0<FEATURETYPE, LABELTYPE, RANDENGINE, TREE>::permutation_importance(
+        FEATURES const & features,
+        LABELS const & labels,
+        std::vector<double> & importance,
+        int num_threads
+) const {
+    static_assert(std::is_convertible<typename FEATURES::value_type, FeatureType>(),
+                  "RandomForest0::permutation_importance(): Wrong feature type.");
+    static_assert(std::is_convertible<typename LABELS::value_type, LabelType>(),
+                  "RandomForest0::permutation_importance(): Wrong label type.");
+
+    size_t const num_instances = features.shape()[0];
+    size_t const num_features = features.shape()[1];
+    vigra_precondition(labels.size() == num_instances,
+                       "RandomForest0::permutation_importance(): Shape mismatch.");
+
+    MultiArray<1, size_t> label_ids((Shape1(num_instances)));
+    transform_external_labels(labels, label_ids);
+
+    // Collect the out-of-bag instances of each tree and count the correct predictions.
+    std::vector<std::vector<size_t> > oob_indices(dtrees_.size());
+    std::vector<size_t> oob_correct(dtrees_.size(), 0);
+    detail::parallel_for(dtrees_.size(), num_threads,
+            [this, & features, & label_ids, & oob_indices, & oob_correct, num_instances](size_t t)
+            {
+                auto const & tree = dtrees_[t];
+                for (size_t i = 0; i < num_instances; ++i)
+                {
+                    if (!tree.is_oob(i))
+                        continue;
+                    oob_indices[t].push_back(i);
+                    auto const leaf = tree.leaf_node(
+                            [& features, i](size_t j)
+                            {
+                                return features(i, j);
+                            }
+                    );
+                    if (tree.node_main_label().at(leaf) == label_ids(i))
+                        ++oob_correct[t];
+                }
+            }
+    );
+
+    // Draw the seeds for the permutations, so the result does not depend on the number of threads.
+    UniformIntRandomFunctor<RANDENGINE> rand(randengine_);
+    std::vector<size_t> seeds(num_features);
+    for (auto & seed : seeds)
+    {
+        seed = rand();
+    }
+
+    // For each feature, permute the feature among the out-of-bag instances of each tree and count the correct predictions.
+    importance.assign(num_features, 0.);
+    detail::parallel_for(num_features, num_threads,
+            [this, & features, & label_ids, & oob_indices, & oob_correct, & seeds, & importance](size_t f)
+            {
+                RANDENGINE const randengine(seeds[f]);
+                UniformIntRandomFunctor<RANDENGINE> rand(randengine);
+                std::vector<size_t> permuted;
+                size_t num_used_trees = 0;
+                for (size_t t = 0; t < dtrees_.size(); ++t)
+                {
+                    auto const & indices = oob_indices[t];
+                    if (indices.empty())
+                        continue;
+                    ++num_used_trees;
+
+                    permuted = indices;
+                    for (size_t k = 0; k+1 < permuted.size(); ++k)
+                    {
+                        std::swap(permuted[k], permuted[k + rand(permuted.size()-k)]);
+                    }
+
+                    size_t correct = 0;
+                    for (size_t k = 0; k < indices.size(); ++k)
+                    {
+                        size_t const i = indices[k];
+                        size_t const i_perm = permuted[k];
+                        auto const leaf = dtrees_[t].leaf_node(
+                                [& features, i, i_perm, f](size_t j)
+                                {
+                                    return features(j == f ? i_perm : i, j);
+                                }
+                        );
+                        if (dtrees_[t].node_main_label().at(leaf) == label_ids(i))
+                            ++correct;
+                    }
+                    importance[f] += (static_cast<double>(oob_correct[t]) - correct) / indices.size();
+                }
+                if (num_used_trees > 0)
+                {
+                    importance[f] /= num_used_trees;
+                }
+            }
+    );
+}
+
+
+
+/// \brief Forest model where identical subtrees are stored only once.
+///
+/// The trees are merged bottom-up by hash-consing: two leaves are identical if they have the same value,
+/// two inner nodes are identical if they have the same split and identical children. An inner node whose children
+/// are identical is replaced by its child, since its split cannot change the result.
+/// Identical subtrees are shared within a tree as well as across trees, so the model is a DAG with one root per tree.
+/// The nodes are stored in a flat array indexed by the node id, the children of an inner node have smaller ids.
+template <typename FEATURETYPE, typename LEAFTYPE>
+class DecisionDAG
+{
+public:
+
+    typedef DAGraph0::Node Node;
+    typedef DAGraph0::index_type index_type;
+    typedef FEATURETYPE FeatureType;
+    typedef LEAFTYPE LeafType;
+    typedef detail::Split<FeatureType> Split;
+
+    /// \brief Build the model from the given trees, leaf_values[t].at(n) is the value of the leaf n of tree t.
+    template <typename TREE, typename LEAFMAP>
+    void build(
+            std::vector<TREE> const & trees,
+            std::vector<LEAFMAP> const & leaf_values
+    );
+
+    /// \brief Return the leaf node of the given tree that contains the instance with the features feats(0), feats(1), ...
+    template <typename ACCESSOR>
+    Node leaf_node(
+            size_t tree,
+            ACCESSOR const & feats
+    ) const;
+
+    /// \brief For each tree return the node ids of the leaves that contain the given instances.
+    template <typename FEATURES>
+    void leaf_ids(
+            FEATURES const & features,
+            MultiArrayView<2, size_t> & indices
+    ) const;
+
+    /// \brief Return the value of the given leaf.
+    LeafType const & leaf_value(Node const & node) const
+    {
+        vigra_assert(is_leaf(node), "DecisionDAG::leaf_value(): The node is not a leaf.");
+        return leaf_values_[node.id()];
+    }
+
+    /// \brief Return true if the given node is a leaf.
+    bool is_leaf(Node const & node) const
+    {
+        return nodes_[node.id()].children[0] == -1;
+    }
+
+    /// \brief Return the child k (0: left, 1: right) of the given inner node.
+    Node child(Node const & node, size_t k) const
+    {
+        vigra_assert(!is_leaf(node) && k < 2, "DecisionDAG::child(): Invalid child.");
+        return Node(nodes_[node.id()].children[k]);
+    }
+
+    /// \brief Return the root node of the given tree.
+    Node root(size_t tree) const
+    {
+        return roots_[tree];
+    }
+
+    /// \brief Return the number of trees.
+    size_t num_trees() const
+    {
+        return roots_.size();
+    }
+
+    /// \brief Return the number of (shared) nodes.
+    size_t num_nodes() const
+    {
+        return nodes_.size();
+    }
+
+    /// \brief Return the number of nodes of the trees before they were merged.
+    size_t num_tree_nodes() const
+    {
+        return num_tree_nodes_;
+    }
+
+protected:
+
+    /// \brief A node of the flat array. Leaves have the children -1.
+    struct NodeT
+    {
+        Split split;
+        index_type children[2];
+    };
+
+    /// \brief The nodes, indexed by the node id.
+    std::vector<NodeT> nodes_;
+
+    /// \brief The leaf values, indexed by the node id (entries of inner nodes are unused).
+    std::vector<LeafType> leaf_values_;
+
+    /// \brief The root node of each tree.
+    std::vector<Node> roots_;
+
+    /// \brief The number of nodes of the trees before they were merged.
+    size_t num_tree_nodes_ = 0;
+
+};
+
+template <typename FEATURETYPE, typename LEAFTYPE>
+template <typename TREE, typename LEAFMAP>
+void DecisionDAG<FEATURETYPE, LEAFTYPE>::build(
+        std::vector<TREE> const & trees,
+        std::vector<LEAFMAP> const & leaf_values
+){
+    typedef typename TREE::Node TreeNode;
+    typedef std::tuple<size_t, FeatureType, index_type, index_type> InnerKey;
+
+    vigra_precondition(trees.size() == leaf_values.size(),
+                       "DecisionDAG::build(): Number of leaf value maps must be equal to number of trees.");
+
+    nodes_.clear();
+    leaf_values_.clear();
+    roots_.clear();
+    num_tree_nodes_ = 0;
+
+    // The hash-consing tables map the key of a node to the id of the node that was already created.
+    std::map<LeafType, index_type> leaf_table;
+    std::map<InnerKey, index_type> inner_table;
+
+    for (size_t t = 0; t < trees.size(); ++t)
+    {
+        auto const & tree = trees[t];
+        auto const & values = leaf_values[t];
+
+        // Traverse the tree in post-order, so the children of a node are merged before the node itself.
+        // The nodes of a decision jungle may have several parents, so nodes that were already merged are skipped.
+        std::vector<index_type> merged(tree.get_graph().maxNodeId()+1, -1);
+        std::vector<std::pair<TreeNode, bool> > stack {{tree.get_root(), false}};
+        while (!stack.empty())
+        {
+            TreeNode const n = stack.back().first;
+            bool const visited = stack.back().second;
+            stack.pop_back();
+
+            if (!visited && merged[n.id()] != -1)
+            {
+                continue;
+            }
+            else if (tree.is_leaf(n))
+            {
+                ++num_tree_nodes_;
+                auto const inserted = leaf_table.emplace(values.at(n), nodes_.size());
+                if (inserted.second)
+                {
+                    nodes_.push_back({Split(), {-1, -1}});
+                    leaf_values_.push_back(values.at(n));
+                }
+                merged[n.id()] = inserted.first->second;
+            }
+            else if (!visited)
+            {
+                auto const children = tree.children(n);
+                stack.push_back({n, true});
+                stack.push_back({children.second, false});
+                stack.push_back({children.first, false});
+            }
+            else
+            {
+                ++num_tree_nodes_;
+                auto const children = tree.children(n);
+                index_type const left = merged[children.first.id()];
+                index_type const right = merged[children.second.id()];
+                if (left == right)
+                {
+                    merged[n.id()] = left;
+                    continue;
+                }
+                auto const & s = tree.node_splits().at(n);
+                auto const inserted = inner_table.emplace(InnerKey(s.feature_index, s.thresh, left, right), nodes_.size());
+                if (inserted.second)
+                {
+                    nodes_.push_back({s, {left, right}});
+                    leaf_values_.push_back(LeafType());
+                }
+                merged[n.id()] = inserted.first->second;
+            }
+        }
+        roots_.push_back(Node(merged[tree.get_root().id()]));
+    }
+}
+
+template <typename FEATURETYPE, typename LEAFTYPE>
+template <typename ACCESSOR>
+auto DecisionDAG<FEATURETYPE, LEAFTYPE>::leaf_node(
+        size_t tree,
+        ACCESSOR const & feats
+) const -> Node
+{
+    index_type k = roots_[tree].id();
+    while (nodes_[k].children[0] != -1)
+    {
+        auto const & n = nodes_[k];
+        k = n.children[(feats(n.split.feature_index) < n.split.thresh) ? 0 : 1];
+    }
+    return Node(k);
+}
+
+template <typename FEATURETYPE, typename LEAFTYPE>
+template <typename FEATURES>
+void DecisionDAG<FEATURETYPE, LEAFTYPE>::leaf_ids(
+        FEATURES const & features,
+        MultiArrayView<2, size_t> & indices
+) const {
+    static_assert(std::is_convertible<typename FEATURES::value_type, FeatureType>(),
+                  "DecisionDAG::leaf_ids(): Wrong feature type.");
+
+    size_t const num_instances = features.shape()[0];
+    vigra_precondition(indices.shape() == Shape2(num_instances, roots_.size()),
+                       "DecisionDAG::leaf_ids(): Shape mismatch.");
+
+    for (size_t i = 0; i < num_instances; ++i)
+    {
+        auto const feats = [& features, i](size_t j)
+        {
+            return features(i, j);
+        };
+        for (size_t t = 0; t < roots_.size(); ++t)
+        {
+            indices(i, t) = leaf_node(t, feats).id();
+        }
+    }
+}
+
+
+
+/// \brief Random forest where identical subtrees of the trees are merged (see DecisionDAG). It gives the same predictions as the original forest.
+///
+/// A leaf stores the main label and the class probabilities, so only leaves that agree in both are merged.
+template <typename FEATURETYPE, typename LABELTYPE>
+class MergedForest
+{
+public:
+
+    typedef FEATURETYPE FeatureType;
+    typedef LABELTYPE LabelType;
+
+    /// \brief The value of a leaf: the internal main label and the class probabilities.
+    typedef std::pair<size_t, std::vector<double> > LeafValue;
+
+    typedef DecisionDAG<FeatureType, LeafValue> DAG;
+    typedef typename DAG::Node Node;
+
+    /// \brief Merge the given trees, distinct_labels[k] is the external label of the internal label k.
+    template <typename TREE>
+    void build(
+            std::vector<TREE> const & trees,
+            std::vector<LabelType> const & distinct_labels
+    );
+
+    /// \brief Predict the labels of the given instances by majority vote.
+    template <typename FEATURES, typename LABELS>
+    void predict(
+            FEATURES const & test_x,
+            LABELS & pred_y
+    ) const;
+
+    /// \brief Compute the class probabilities of the given instances (the mean of the leaf probabilities).
+    /// \param probs[out]: num_instances x num_classes array
+    template <typename FEATURES>
+    void predict_probabilities(
+            FEATURES const & test_x,
+            MultiArrayView<2, double> & probs
+    ) const;
+
+    /// \brief For each tree return the node ids of the leaves that contain the given instances.
+    template <typename FEATURES>
+    void leaf_ids(
+            FEATURES const & features,
+            MultiArrayView<2, size_t> & indices
+    ) const {
+        dag_.leaf_ids(features, indices);
+    }
+
+    /// \brief Return the merged trees.
+    DAG const & get_dag() const
+    {
+        return dag_;
+    }
+
+    /// \brief Return the number of trees.
+    size_t num_trees() const
+    {
+        return dag_.num_trees();
+    }
+
+protected:
+
+    /// \brief The merged trees, the leaf values are the internal labels and the class probabilities.
+    DAG dag_;
+
+    /// \brief The distinct labels that were found in training.
+    std::vector<LabelType> distinct_labels_;
+
+};
+
+template <typename FEATURETYPE, typename LABELTYPE>
+template <typename TREE>
+void MergedForest<FEATURETYPE, LABELTYPE>::build(
+        std::vector<TREE> const & trees,
+        std::vector<LabelType> const & distinct_labels
+){
+    // Trees that were trained before new labels were added have shorter probability vectors.
+    size_t const num_classes = distinct_labels.size();
+    std::vector<typename TREE::template NodeMap<LeafValue> > leaf_values(trees.size());
+    for (size_t t = 0; t < trees.size(); ++t)
+    {
+        for (auto const & p : trees[t].label_probs())
+        {
+            std::vector<double> probs(p.second);
+            probs.resize(num_classes, 0.);
+            leaf_values[t][p.first] = LeafValue(trees[t].node_main_label().at(p.first), probs);
+        }
+    }
+    dag_.build(trees, leaf_values);
+    distinct_labels_ = distinct_labels;
+}
+
+template <typename FEATURETYPE, typename LABELTYPE>
+template <typename FEATURES, typename LABELS>
+void MergedForest<FEATURETYPE, LABELTYPE>::predict(
+        FEATURES const & test_x,
+        LABELS & pred_y
+) const {
+    static_assert(std::is_convertible<typename FEATURES::value_type, FeatureType>(),
+                  "MergedForest::predict(): Wrong feature type.");
     static_assert(std::is_convertible<LabelType, typename LABELS::value_type>(),
-                  "DecisionTree0::predict(): Wrong label type.");
+                  "MergedForest::predict(): Wrong label type.");
 
-    Node const rootnode = tree_.getRoot();
-    vigra_assert(tree_.valid(rootnode), "DecisionTree0::predict(): The graph has no root node.");
-
-    for (size_t i = 0; i < test_x.num_instances(); ++i)
+    size_t const num_instances = test_x.shape()[0];
+    std::vector<size_t> label_counts_vec(distinct_labels_.size());
+    for (size_t i = 0; i < num_instances; ++i)
     {
-        auto const feats = test_x.instance_features(i);
-        Node node = rootnode;
+        // Count the labels.
+        auto const feats = [& test_x, i](size_t j)
+        {
+            return test_x(i, j);
+        };
+        std::fill(label_counts_vec.begin(), label_counts_vec.end(), 0);
+        for (size_t t = 0; t < dag_.num_trees(); ++t)
+        {
+            size_t const label = dag_.leaf_value(dag_.leaf_node(t, feats)).first;
+            if (label >= label_counts_vec.size())
+                vigra_fail("Prediction of a label that did not exist in training.");
+            ++label_counts_vec[label];
+        }
 
-        while (tree_.outDegree(node) > 0)
+        // Find the label with the maximum count (the first one on ties, as in RandomForest0).
+        size_t max_count = 0;
+        size_t max_label = 0;
+        for (size_t k = 0; k < label_counts_vec.size(); ++k)
         {
-             auto const & s = node_splits_.at(node);
-             if (feats(s.feature_index) < s.thresh)
-             {
-                 node = tree_.getChild(node, 0);
-             }
-             else
-             {
-                 node = tree_.getChild(node, 1);
-             }
+            if (label_counts_vec[k] > max_count)
+            {
+                max_count = label_counts_vec[k];
+                max_label = k;
+            }
         }
-        pred_y(i) = node_main_label_.at(node);
+        pred_y(i) = distinct_labels_[max_label];
     }
 }
 
-template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
+template <typename FEATURETYPE, typename LABELTYPE>
 template <typename FEATURES>
-void DecisionTree0<FEATURETYPE, LABELTYPE, RANDENGINE>::leaf_ids(
-        FEATURES const & features,
-        MultiArrayView<1, size_t> & indices
+void MergedForest<FEATURETYPE, LABELTYPE>::predict_probabilities(
+        FEATURES const & test_x,
+        MultiArrayView<2, double> & probs
 ) const {
     static_assert(std::is_convertible<typename FEATURES::value_type, FeatureType>(),
-                  "DecisionTree0::leaf_indices(): Wrong feature type.");
-
-    size_t const num_instances = features.shape()[0];
-
-    vigra_precondition(num_instances == indices.size(),
-                       "DecisionTree0::leaf_indices(): Shape mismatch.");
-
-    Node const rootnode = tree_.getRoot();
-    vigra_assert(tree_.valid(rootnode), "DecisionTree0::leaf_indices(): The graph has no root node.");
+                  "MergedForest::predict_probabilities(): Wrong feature type.");
 
+    size_t const num_instances = test_x.shape()[0];
+    vigra_precondition(probs.shape() == Shape2(num_instances, distinct_labels_.size()),
+                       "MergedForest::predict_probabilities(): Shape mismatch.");
     for (size_t i = 0; i < num_instances; ++i)
     {
-        Node node = rootnode;
-
-        while (tree_.outDegree(node) > 0)
+        auto const feats = [& test_x, i](size_t j)
+        {
+            return test_x(i, j);
+        };
+        auto row = probs.template bind<0>(i);
+        row = 0.;
+        for (size_t t = 0; t < dag_.num_trees(); ++t)
         {
-            auto const & s = node_splits_.at(node);
-            if (features(i, s.feature_index) < s.thresh)
+            auto const & leaf_probs = dag_.leaf_value(dag_.leaf_node(t, feats)).second;
+            for (size_t c = 0; c < leaf_probs.size(); ++c)
             {
-                node = tree_.getChild(node, 0);
+                row(c) += leaf_probs[c];
             }
-            else
+        }
+        if (dag_.num_trees() > 0)
+        {
+            size_t const num_classes = row.size();
+            for (size_t c = 0; c < num_classes; ++c)
             {
-                node = tree_.getChild(node, 1);
+                row(c) /= dag_.num_trees();
             }
         }
-        indices(i) = node.id();
     }
 }
 
 
 
-/// \brief Random forest class.
-template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE = MersenneTwister>
-class RandomForest0
+/// \brief Globally refined random forest where identical subtrees of the trees are merged (see DecisionDAG).
+///
+/// The leaf values are the leaf weights of the refined forest, so it gives the same predictions as the refined forest.
+template <typename FEATURETYPE, typename LABELTYPE>
+class MergedRefinedForest
 {
 public:
 
     typedef FEATURETYPE FeatureType;
     typedef LABELTYPE LabelType;
-    typedef DecisionTree0<FeatureType, size_t, RANDENGINE> Tree;
-    typedef typename Tree::Node TreeNode;
-
-    RandomForest0(RANDENGINE const & randengine = RANDENGINE::global())
-        : randengine_(randengine)
-    {}
-
-    RandomForest0(RandomForest0 const &) = default;
-    RandomForest0(RandomForest0 &&) = default;
-    ~RandomForest0() = default;
-    RandomForest0 & operator=(RandomForest0 const &) = default;
-    RandomForest0 & operator=(RandomForest0 &&) = default;
-
-    /// \brief Train the random forest.
-    template <typename FEATURES, typename LABELS, typename SAMPLER, typename TERMINATION, typename SPLITFUNCTOR>
-    void train(
-            FEATURES const & train_x,
-            LABELS const & train_y,
-            size_t num_trees,
-            int num_threads = -1
-    );
+    typedef DecisionDAG<FeatureType, double> DAG;
+    typedef typename DAG::Node Node;
+
+    /// \brief Merge the given trees with their leaf weights and the two labels.
+    template <typename TREE, typename WEIGHTMAP>
+    void build(
+            std::vector<TREE> const & trees,
+            std::vector<WEIGHTMAP> const & leaf_weights,
+            std::vector<LabelType> const & distinct_labels
+    ){
+        vigra_precondition(distinct_labels.size() == 2,
+                           "MergedRefinedForest::build(): Only implemented for two labels.");
+        dag_.build(trees, leaf_weights);
+        distinct_labels_ = distinct_labels;
+    }
 
-    /// \brief Predict new data using the forest.
+    /// \brief Predict the labels of the given instances (a non-negative sum of the leaf weights gives the first label).
     template <typename FEATURES, typename LABELS>
     void predict(
             FEATURES const & test_x,
             LABELS & pred_y
     ) const;
 
-    /// \brief Return the tree vector.
-    std::vector<Tree> & trees()
-    {
-        return dtrees_;
-    }
-
-
-    /// \brief Return the tree vector.
-    std::vector<Tree> const & trees() const
+    /// \brief Return the merged trees.
+    DAG const & get_dag() const
     {
-        return dtrees_;
+        return dag_;
     }
 
     /// \brief Return the number of trees.
     size_t num_trees() const
     {
-        return dtrees_.size();
-    }
-
-    /// \brief Return the number of classes.
-    size_t num_classes() const
-    {
-        return distinct_labels_.size();
+        return dag_.num_trees();
     }
 
-    /// \brief For each tree return the node ids of the leaves that contain the given instances.
-    template <typename FEATURES>
-    void leaf_ids(
-            FEATURES const & features,
-            MultiArrayView<2, size_t> & indices
-    ) const;
-
-    /// \brief Transform the given external labels to the labels that are used internally.
-    template <typename LABELS>
-    void transform_external_labels(
-            LABELS const & labels_in,
-            MultiArrayView<1, size_t> & labels_out
-    ) const;
-
 protected:
 
-    /// \brief The trees of the forest.
-    std::vector<Tree> dtrees_;
+    /// \brief The merged trees, the leaf values are the leaf weights.
+    DAG dag_;
 
-    /// \brief The distinct labels that were found in training.
+    /// \brief The two labels.
     std::vector<LabelType> distinct_labels_;
 
-    /// \brief The random engine.
-    RANDENGINE const & randengine_;
-
 };
 
-template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
-template <typename FEATURES, typename LABELS, typename SAMPLER, typename TERMINATION, typename SPLITFUNCTOR>
-void RandomForest0<FEATURETYPE, LABELTYPE, RANDENGINE>::train(
-        FEATURES const & data_x,
-        LABELS const & data_y,
-        size_t const num_trees,
-        int num_threads
-){
+template <typename FEATURETYPE, typename LABELTYPE>
+template <typename FEATURES, typename LABELS>
+void MergedRefinedForest<FEATURETYPE, LABELTYPE>::predict(
+        FEATURES const & test_x,
+        LABELS & pred_y
+) const {
     static_assert(std::is_convertible<typename FEATURES::value_type, FeatureType>(),
-                  "RandomForest0::train(): Wrong feature type.");
-    static_assert(std::is_convertible<typename LABELS::value_type, LabelType>(),
-                  "RandomForest0::train(): Wrong label type.");
+                  "MergedRefinedForest::predict(): Wrong feature type.");
+    static_assert(std::is_convertible<LabelType, typename LABELS::value_type>(),
+                  "MergedRefinedForest::predict(): Wrong label type.");
 
-    vigra_precondition(num_threads == -1 || num_threads > 0,
-                       "RandomForest0::train(): n_threads must be -1 or greater than zero.");
+    size_t const num_instances = test_x.shape()[0];
+    for (size_t i = 0; i < num_instances; ++i)
+    {
+        auto const feats = [& test_x, i](size_t j)
+        {
+            return test_x(i, j);
+        };
+        double v = 0.;
+        for (size_t t = 0; t < dag_.num_trees(); ++t)
+        {
+            v = v + dag_.leaf_value(dag_.leaf_node(t, feats));
+        }
+        pred_y(i) = distinct_labels_[(v >= 0) ? 0 : 1];
+    }
+}
 
-    // Find the distinct labels.
-    std::set<LabelType> dlabels(data_y.begin(), data_y.end());
-    distinct_labels_.resize(dlabels.size());
-    std::copy(dlabels.begin(), dlabels.end(), distinct_labels_.begin());
 
-    // Translate the labels to the label ids.
-    MultiArray<1, size_t> data_y_id_arr(data_y.shape());
-    transform_external_labels(data_y, data_y_id_arr);
-    LabelGetter<size_t> const data_y_id(data_y_id_arr);
 
-    // Create a named lambda to train a single tree with index i.
-    auto train_tree = [this, & data_x, & data_y_id](size_t i) {
-        dtrees_[i].set_num_labels(distinct_labels_.size());
-        dtrees_[i].train<FEATURES, LabelGetter<size_t>, SAMPLER, TERMINATION, SPLITFUNCTOR>(data_x, data_y_id);
-    };
+namespace detail
+{
 
-    // Create the seeds for the trees. Make sure that they are all different.
-    UniformIntRandomFunctor<RANDENGINE> rand(randengine_);
-    std::set<size_t> seeds;
-    while (seeds.size() < num_trees)
+    /// \brief Flat array representation of the trees of a forest for fast single instance traversal.
+    ///
+    /// The nodes of each tree are stored breadth-first, so the two children of a node are adjacent.
+    /// The leaves of all trees are numbered consecutively.
+    template <typename FEATURETYPE>
+    class FlatForest
     {
-        seeds.insert(rand());
-    }
-    vigra_assert(seeds.size() == num_trees, "RandomForest0::train(): Somehow we got more seeds than trees.");
+    public:
 
-    // Initialize the trees with the seeds.
-    dtrees_.reserve(num_trees);
-    for (auto it = seeds.begin(); it != seeds.end(); ++it)
-    {
-        dtrees_.push_back(Tree(*it));
-    }
+        typedef FEATURETYPE FeatureType;
 
-    // Train each tree.
-    if (num_threads == -1)
-        num_threads = std::thread::hardware_concurrency(); // might return 0 if the value is not computable
-    if (num_threads <= 1)
-    {
-        // Single thread.
-        for (size_t i = 0; i < num_trees; ++i)
-        {
-            train_tree(i);
-        }
-    }
-    else
-    {
-        // Create one worker per thread and let them train the trees.
-        std::vector<std::thread> workers;
-        for (size_t k = 0; k < num_threads; ++k)
-        {
-            workers.push_back(std::thread(
-                    [this, & train_tree, & num_trees, & num_threads](size_t k)
+        /// \brief Build the arrays from the given trees and call f(tree_index, tree_node, leaf_index) for each leaf.
+        ///
+        /// TREE may be a DecisionTree0 or a DecisionJungle0. A node of a jungle may have several parents, so each node
+        /// is visited once and the parents share its entry.
+        template <typename TREE, typename FUNCTOR>
+        void build(
+                std::vector<TREE> const & trees,
+                FUNCTOR const & f
+        ){
+            typedef typename TREE::Node TreeNode;
+
+            nodes_.clear();
+            roots_.clear();
+            num_features_ = 0;
+            UInt32 num_leaves = 0;
+            for (size_t t = 0; t < trees.size(); ++t)
+            {
+                auto const & tree = trees[t];
+                num_features_ = std::max(num_features_, tree.num_features());
+
+                // Visit the nodes in breadth-first order. Leaves get the next leaf index, inner nodes get a pair of
+                // child slots. The entry of a node (feature, threshold and index) is then copied into the slots of
+                // each of its parents, so the traversal needs no extra indirection for shared nodes.
+                std::vector<NodeT> entries(tree.get_graph().maxNodeId()+1);
+                std::vector<bool> visited(entries.size(), false);
+                std::vector<TreeNode> inner_nodes;
+                std::queue<TreeNode> queue;
+                TreeNode const root = tree.get_root();
+                roots_.push_back(nodes_.size());
+                nodes_.push_back(NodeT());
+                visited[root.id()] = true;
+                queue.push(root);
+                while (!queue.empty())
+                {
+                    TreeNode const n = queue.front();
+                    queue.pop();
+                    NodeT & entry = entries[n.id()];
+                    if (tree.is_leaf(n))
                     {
-                        for (size_t i = k; i < num_trees; i+=num_threads)
+                        entry.feature = LEAF;
+                        entry.index = num_leaves;
+                        f(t, n, num_leaves);
+                        ++num_leaves;
+                    }
+                    else
+                    {
+                        auto const & s = tree.node_splits().at(n);
+                        vigra_precondition(s.feature_index < LEAF, "FlatForest::build(): Too many features.");
+                        vigra_precondition(s.feature_index < num_features_, "FlatForest::build(): Split on an unknown feature.");
+                        entry.feature = s.feature_index;
+                        entry.thresh = s.thresh;
+                        entry.index = nodes_.size();
+                        nodes_.push_back(NodeT());
+                        nodes_.push_back(NodeT());
+                        inner_nodes.push_back(n);
+                        auto const children = tree.children(n);
+                        for (TreeNode const & c : {children.first, children.second})
                         {
-                            train_tree(i);
+                            if (!visited[c.id()])
+                            {
+                                visited[c.id()] = true;
+                                queue.push(c);
+                            }
                         }
-                    },
-                    k
-            ));
+                    }
+                }
+                nodes_[roots_.back()] = entries[root.id()];
+                for (TreeNode const & n : inner_nodes)
+                {
+                    auto const children = tree.children(n);
+                    nodes_[entries[n.id()].index] = entries[children.first.id()];
+                    nodes_[entries[n.id()].index+1] = entries[children.second.id()];
+                }
+            }
+            vigra_precondition(nodes_.size() <= std::numeric_limits<UInt32>::max(),
+                               "FlatForest::build(): Too many nodes.");
+        }
+
+        /// \brief Return the index of the leaf of tree t that contains the instance with the features x[0], x[1], ...
+        UInt32 leaf_index(size_t t, FeatureType const * x) const
+        {
+            NodeT const * node = &nodes_[roots_[t]];
+            while (node->feature != LEAF)
+            {
+                node = &nodes_[node->index + (x[node->feature] < node->thresh ? 0 : 1)];
+            }
+            return node->index;
         }
-        for (auto & t : workers)
+
+        /// \brief Return the number of trees.
+        size_t num_trees() const
         {
-            t.join();
+            return roots_.size();
         }
-    }
-}
 
-template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
-template <typename FEATURES, typename LABELS>
-void RandomForest0<FEATURETYPE, LABELTYPE, RANDENGINE>::predict(
-        FEATURES const & test_x,
-        LABELS & pred_y
-) const {
-    // The features must be convertible to feature type, so we can put them into the forest.
-    static_assert(std::is_convertible<typename FEATURES::value_type, FeatureType>(),
-                  "RandomForest0::predict(): Wrong feature type.");
+        /// \brief Return the number of features of the training data (the length of an instance).
+        size_t num_features() const
+        {
+            return num_features_;
+        }
 
-    // The internal label type must be convertible to the labels, so we can put them into the output.
-    static_assert(std::is_convertible<LabelType, typename LABELS::value_type>(),
-                  "RandomForest0::predict(): Wrong label type.");
+    protected:
 
-    // Let each tree predict all instances.
-    MultiArray<2, size_t> labels(Shape2(test_x.num_instances(), dtrees_.size()));
-    for (size_t i = 0; i < dtrees_.size(); ++i)
-    {
-        auto label_view = labels.template bind<1>(i);
-        dtrees_[i].predict(test_x, label_view);
+        /// \brief A tree node. For leaves, feature is LEAF and index is the leaf index, else it is the index of the left child (the right child follows).
+        struct NodeT
+        {
+            UInt32 feature;
+            UInt32 index;
+            FeatureType thresh;
+        };
+
+        static UInt32 const LEAF = std::numeric_limits<UInt32>::max();
+
+        std::vector<NodeT> nodes_;
+        std::vector<UInt32> roots_;
+        size_t num_features_ = 0;
+    };
+
+} // namespace detail
+
+
+
+/// \brief Immutable single instance predictor of a random forest.
+///
+/// All methods are const and do not allocate memory, so a predictor can be shared by many threads.
+/// An instance is given as a pointer to its num_features() contiguous feature values.
+template <typename FEATURETYPE, typename LABELTYPE>
+class ForestPredictor
+{
+public:
+
+    typedef FEATURETYPE FeatureType;
+    typedef LABELTYPE LabelType;
+
+    /// \brief The maximum number of classes for predict_one (the votes are counted on the stack).
+    static constexpr size_t max_vote_classes = 256;
+
+    /// \brief Build the predictor from the given trees, distinct_labels[k] is the external label of the internal label k.
+    template <typename TREE>
+    void build(
+            std::vector<TREE> const & trees,
+            std::vector<LabelType> const & distinct_labels
+    ){
+        distinct_labels_ = distinct_labels;
+        size_t const num_classes = distinct_labels_.size();
+        leaf_labels_.clear();
+        leaf_probs_.clear();
+        forest_.build(trees,
+                [this, & trees, num_classes](size_t t, typename TREE::Node const & n, UInt32)
+                {
+                    // Trees that were trained before new labels were added have shorter probability vectors.
+                    auto const & probs = trees[t].label_probs().at(n);
+                    for (size_t k = 0; k < num_classes; ++k)
+                    {
+                        leaf_probs_.push_back(k < probs.size() ? probs[k] : 0.);
+                    }
+                    leaf_labels_.push_back(trees[t].node_main_label().at(n));
+                }
+        );
     }
 
-    // Find the majority vote.
-    std::vector<size_t> label_counts_vec(distinct_labels_.size());
-    for (size_t i = 0; i < test_x.num_instances(); ++i)
+    /// \brief Predict the label of a single instance by majority vote.
+    LabelType predict_one(FeatureType const * x) const
     {
-        // Count the labels.
-        std::fill(label_counts_vec.begin(), label_counts_vec.end(), 0);
-        for (size_t k = 0; k < dtrees_.size(); ++k)
+        vigra_precondition(distinct_labels_.size() <= max_vote_classes,
+                           "ForestPredictor::predict_one(): Too many classes.");
+        std::array<UInt32, max_vote_classes> votes;
+        std::fill(votes.begin(), votes.begin() + distinct_labels_.size(), 0);
+        for (size_t t = 0; t < forest_.num_trees(); ++t)
         {
-            size_t const label = labels(i, k);
-            if (label >= label_counts_vec.size())
-                vigra_fail("Prediction of a label that did not exist in training.");
-            ++label_counts_vec[label];
+            ++votes[leaf_labels_[forest_.leaf_index(t, x)]];
         }
 
-        // Find the label with the maximum count.
-        size_t max_count = 0;
-        size_t max_label;
-        for (size_t k = 0; k < label_counts_vec.size(); ++k)
+        // Find the label with the maximum count (the first one on ties, as in RandomForest0).
+        size_t max_label = 0;
+        for (size_t k = 1; k < distinct_labels_.size(); ++k)
         {
-            if (label_counts_vec[k] > max_count)
-            {
-                max_count = label_counts_vec[k];
+            if (votes[k] > votes[max_label])
                 max_label = k;
-            }
         }
-
-        // Write the label in the output array.
-        pred_y(i) = distinct_labels_[max_label];
+        return distinct_labels_[max_label];
     }
-}
-
-template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
-template <typename FEATURES>
-void RandomForest0<FEATURETYPE, LABELTYPE, RANDENGINE>::leaf_ids(
-        FEATURES const & features,
-        MultiArrayView<2, size_t> & indices
-) const {
-    static_assert(std::is_convertible<typename FEATURES::value_type, FeatureType>(),
-                  "RandomForest0::leaf_indices(): Wrong feature type.");
-
-    vigra_precondition(indices.shape() == Shape2(features.shape()[0], dtrees_.size()),
-                       "RandomForest0::leaf_indices(): Shape mismatch.");
 
-    for (size_t i = 0; i < dtrees_.size(); ++i)
+    /// \brief Compute the class probabilities of a single instance (the mean of the leaf probabilities).
+    /// \param probs[out]: array with num_classes() entries
+    void predict_proba_one(FeatureType const * x, double * probs) const
     {
-        auto sub = indices.bind<1>(i);
-        dtrees_[i].leaf_ids(features, sub);
-    }
-}
-
-template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
-template <typename LABELS>
-void RandomForest0<FEATURETYPE, LABELTYPE, RANDENGINE>::transform_external_labels(
-        LABELS const & labels_in,
-        MultiArrayView<1, size_t> & labels_out
-) const {
-    static_assert(std::is_convertible<typename LABELS::value_type, LabelType>(),
-                  "RandomForest0::transform_external_labels(): Wrong label type.");
+        size_t const num_classes = distinct_labels_.size();
+        std::fill(probs, probs + num_classes, 0.);
+        for (size_t t = 0; t < forest_.num_trees(); ++t)
+        {
+            double const * leaf_probs = &leaf_probs_[forest_.leaf_index(t, x) * num_classes];
+            for (size_t k = 0; k < num_classes; ++k)
+            {
+                probs[k] += leaf_probs[k];
+            }
+        }
+        for (size_t k = 0; k < num_classes; ++k)
+        {
+            probs[k] /= forest_.num_trees();
+        }
+    }
 
-    vigra_precondition(labels_in.size() == labels_out.size(),
-                       "RandomForest0::transform_external_labels(): Shape mismatch.");
+    /// \brief Predict the labels of n instances that are stored row by row in x.
+    void predict(FeatureType const * x, size_t n, LabelType * labels) const
+    {
+        size_t const num_features = forest_.num_features();
+        for (size_t i = 0; i < n; ++i)
+        {
+            labels[i] = predict_one(x + i*num_features);
+        }
+    }
 
-    std::map<FeatureType, size_t> label_id;
-    for (size_t i = 0; i < distinct_labels_.size(); ++i)
+    /// \brief Return the number of features of an instance.
+    size_t num_features() const
     {
-        label_id[distinct_labels_[i]] = i;
+        return forest_.num_features();
     }
-    for (size_t i = 0; i < labels_in.size(); ++i)
+
+    /// \brief Return the number of classes.
+    size_t num_classes() const
     {
-        labels_out(i) = label_id[labels_in(i)];
+        return distinct_labels_.size();
     }
-}
+
+protected:
+
+    detail::FlatForest<FeatureType> forest_;
+
+    /// \brief The internal label of each leaf.
+    std::vector<UInt32> leaf_labels_;
+
+    /// \brief The class probabilities of each leaf (num_classes entries per leaf).
+    std::vector<double> leaf_probs_;
+
+    /// \brief The distinct labels.
+    std::vector<LabelType> distinct_labels_;
+
+};
+
+
+
+template <typename FEATURETYPE, typename LABELTYPE, typename WEIGHTTYPE, typename BINTYPE>
+class QuantizedRefinedForest;
+
+template <typename FEATURETYPE, typename LABELTYPE>
+class MergedRefinedForest;
+
+template <typename FEATURETYPE, typename LABELTYPE>
+class RefinedForestPredictor;
 
 
 
@@ -922,8 +4291,11 @@ public:
     template <typename T>
     using TreeNodeMap = typename Tree::template NodeMap<T>;
 
-    GloballyRefinedRandomForest(RANDOMFOREST & rf)
-        : rf_(rf)
+    /// \param svm_num_threads: number of threads for the dual coordinate descent of the leaf weight SVM
+    /// (-1: use all cores), with more than one thread the result depends on the scheduling
+    GloballyRefinedRandomForest(RANDOMFOREST & rf, int const svm_num_threads = 1)
+        : rf_(rf),
+          svm_num_threads_(svm_num_threads)
     {}
 
     template <typename FEATURES, typename LABELS>
@@ -932,16 +4304,87 @@ public:
             LABELS const & labels
     );
 
+    /// \brief Train new trees in the underlying forest and refine only the leaf weights of the new trees.
+    ///
+    /// The weights of the existing trees are kept up to a common factor: The weights of each block of trees that was
+    /// refined together are scaled by the block's share of the forest, so each block contributes to the decision
+    /// according to its size.
+    template <typename FEATURES, typename LABELS, typename SAMPLER, typename TERMINATION, typename SPLITFUNCTOR>
+    void add_trees(
+            FEATURES const & features,
+            LABELS const & labels,
+            size_t num_trees,
+            int num_threads = -1,
+            SAMPLER const & sampler = SAMPLER(),
+            TERMINATION const & termination = TERMINATION(),
+            SPLITFUNCTOR const & functor = SPLITFUNCTOR()
+    );
+
+    /// \brief Remove the given number of trees (and their leaf weights), starting with the oldest one.
+    ///
+    /// The weights of the remaining trees are scaled up, so they keep their relative contributions.
+    void retire_trees(size_t num_trees);
+
     template <typename FEATURES, typename LABELS>
     void predict(
             FEATURES const & features,
             LABELS & pred_y
     ) const;
 
+    /// \brief Return the compressed model with quantized leaf weights and split thresholds.
+    template <typename WEIGHTTYPE = Int8, typename BINTYPE = UInt16>
+    QuantizedRefinedForest<FeatureType, LabelType, WEIGHTTYPE, BINTYPE> quantize() const
+    {
+        QuantizedRefinedForest<FeatureType, LabelType, WEIGHTTYPE, BINTYPE> q;
+        q.build(rf_.trees(), svm_weights_, distinct_labels_);
+        return q;
+    }
+
+    /// \brief Return the refined forest with identical subtrees merged into a decision DAG with the leaf weights as leaf values.
+    MergedRefinedForest<FeatureType, LabelType> merge() const
+    {
+        MergedRefinedForest<FeatureType, LabelType> merged;
+        merged.build(rf_.trees(), svm_weights_, distinct_labels_);
+        return merged;
+    }
+
+    /// \brief Return an immutable single instance predictor of the refined forest.
+    RefinedForestPredictor<FeatureType, LabelType> predictor() const
+    {
+        RefinedForestPredictor<FeatureType, LabelType> p;
+        p.build(rf_.trees(), svm_weights_, distinct_labels_);
+        return p;
+    }
+
+    /// \brief Return the leaf weights of each tree.
+    std::vector<TreeNodeMap<double> > const & leaf_weights() const
+    {
+        return svm_weights_;
+    }
+
+    /// \brief Return the two labels (a non-negative decision value gives the first one).
+    std::vector<LabelType> const & distinct_labels() const
+    {
+        return distinct_labels_;
+    }
+
 protected:
 
+    /// \brief Train the SVM on the leaves of the trees [first_tree, num_trees), prune them and save the leaf weights.
+    template <typename FEATURES, typename LABELS>
+    void refine(
+            FEATURES const & features,
+            LABELS const & labels,
+            size_t first_tree
+    );
+
+    /// \brief Multiply all leaf weights with the given factor.
+    void scale_leaf_weights(double scale);
+
     RandomForest & rf_;
 
+    int svm_num_threads_;
+
     Adaptor rf_adaptor_;
 
     std::vector<TreeNodeMap<double> > svm_weights_;
@@ -958,44 +4401,133 @@ template <typename FEATURES, typename LABELS>
 void GloballyRefinedRandomForest<RANDOMFOREST>::train(
         FEATURES const & features,
         LABELS const & labels
+){
+    svm_weights_.clear();
+    distinct_labels_.clear();
+    refine(features, labels, 0);
+}
+
+template <typename RANDOMFOREST>
+template <typename FEATURES, typename LABELS, typename SAMPLER, typename TERMINATION, typename SPLITFUNCTOR>
+void GloballyRefinedRandomForest<RANDOMFOREST>::add_trees(
+        FEATURES const & features,
+        LABELS const & labels,
+        size_t const num_trees,
+        int num_threads,
+        SAMPLER const & sampler,
+        TERMINATION const & termination,
+        SPLITFUNCTOR const & functor
+){
+    size_t const first_tree = rf_.num_trees();
+    rf_.template add_trees<FEATURES, LABELS, SAMPLER, TERMINATION, SPLITFUNCTOR>(
+                features, labels, num_trees, num_threads, sampler, termination, functor);
+    refine(features, labels, first_tree);
+}
+
+template <typename RANDOMFOREST>
+void GloballyRefinedRandomForest<RANDOMFOREST>::retire_trees(
+        size_t const num_trees
+){
+    size_t const old_num_trees = svm_weights_.size();
+    rf_.retire_trees(num_trees);
+    svm_weights_.erase(svm_weights_.begin(), svm_weights_.begin() + std::min(num_trees, svm_weights_.size()));
+
+    // The remaining trees make up a larger share of the forest.
+    if (!svm_weights_.empty())
+        scale_leaf_weights(old_num_trees / static_cast<double>(svm_weights_.size()));
+}
+
+template <typename RANDOMFOREST>
+void GloballyRefinedRandomForest<RANDOMFOREST>::scale_leaf_weights(
+        double const scale
+){
+    for (auto & weights : svm_weights_)
+    {
+        for (auto & p : weights)
+        {
+            p.second *= scale;
+        }
+    }
+}
+
+template <typename RANDOMFOREST>
+template <typename FEATURES, typename LABELS>
+void GloballyRefinedRandomForest<RANDOMFOREST>::refine(
+        FEATURES const & features,
+        LABELS const & labels,
+        size_t const first_tree
 ){
     static_assert(std::is_convertible<typename FEATURES::value_type, FeatureType>(),
-                  "GloballyRefinedRandomForest::train(): Wrong feature type.");
+                  "GloballyRefinedRandomForest::refine(): Wrong feature type.");
     static_assert(std::is_convertible<typename LABELS::value_type, LabelType>(),
-                  "GloballyRefinedRandomForest::train(): Wrong label type.");
+                  "GloballyRefinedRandomForest::refine(): Wrong label type.");
 
     vigra_precondition(rf_.num_classes() == 2,
-                       "GloballyRefinedRandomForest::train(): Curently only implemented for binary random forests.");
+                       "GloballyRefinedRandomForest::refine(): Curently only implemented for binary random forests.");
+    vigra_precondition(svm_weights_.size() == first_tree,
+                       "GloballyRefinedRandomForest::refine(): The forest was changed outside of the refined forest.");
 
     size_t const num_instances = features.shape()[0];
+    size_t const num_new_trees = rf_.num_trees() - first_tree;
 
-    // Create an adaptor for the graph structure and the node splits.
+    // Create an adaptor for the graph structure and the node splits of the new trees.
     {
         std::vector<TreeGraph*> tree_graphs;
-        for (Tree & tree : rf_.trees())
+        for (size_t j = first_tree; j < rf_.num_trees(); ++j)
         {
-            tree_graphs.push_back(&tree.get_graph());
+            tree_graphs.push_back(&rf_.trees()[j].get_graph());
         }
         rf_adaptor_.set_forest(tree_graphs);
     }
 
-    // Create the index vectors (= features) for the SVM.
-    SparseFeatureGetter<UInt8> svm_features(Shape2(num_instances, rf_adaptor_.numLeaves()));
+    // Create the index vectors (= features) for the SVM. Each instance has exactly one active leaf per tree,
+    // so only the global leaf indices are stored. The instances are processed in blocks: For each block, all
+    // trees are traversed one after another (so the nodes of one tree stay in the cache) and the leaf indices
+    // are appended directly to the SVM features, without an intermediate array of node ids.
+    size_t const num_leaves = rf_adaptor_.numLeaves();
+    vigra_precondition(num_leaves <= std::numeric_limits<UInt32>::max(),
+                       "GloballyRefinedRandomForest::refine(): Too many leaves.");
+    BinarySparseFeatureGetter<UInt8> svm_features(Shape2(num_instances, num_leaves));
     {
-        // Get the leaf nodes of the training instances.
-        MultiArray<2, size_t> leaf_ids(num_instances, rf_.num_trees());
-        rf_.leaf_ids(features, leaf_ids);
+        // Map the node ids of each tree to the global leaf indices (the same as rf_adaptor_.getLeafIndex()).
+        std::vector<std::vector<UInt32> > leaf_indices(num_new_trees);
+        UInt32 leaf_offset = 0;
+        for (size_t j = 0; j < num_new_trees; ++j)
+        {
+            auto const & g = rf_.trees()[first_tree + j].get_graph();
+            leaf_indices[j].resize(g.maxNodeId()+1);
+            for (size_t l = 0; l < g.numLeaves(); ++l)
+            {
+                leaf_indices[j][g.getLeafNode(l).id()] = leaf_offset + l;
+            }
+            leaf_offset += g.numLeaves();
+        }
 
-        // Put the leaf ids in the feature array.
-        for (size_t i = 0; i < num_instances; ++i)
+        static constexpr size_t block_size = 256;
+        std::vector<UInt32> block(block_size * num_new_trees);
+        svm_features.reserve(num_instances * num_new_trees);
+        for (size_t begin = 0; begin < num_instances; begin += block_size)
         {
-            for (size_t j = 0; j < rf_.num_trees(); ++j)
+            size_t const n = std::min(num_instances, begin + block_size) - begin;
+            for (size_t j = 0; j < num_new_trees; ++j)
+            {
+                auto const & tree = rf_.trees()[first_tree + j];
+                for (size_t i = 0; i < n; ++i)
+                {
+                    size_t const instance = begin + i;
+                    auto const leaf = tree.leaf_node(
+                            [& features, instance](size_t f)
+                            {
+                                return features(instance, f);
+                            }
+                    );
+                    block[i*num_new_trees + j] = leaf_indices[j][leaf.id()];
+                }
+            }
+            // The leaf indices of an instance are increasing, since the leaves of tree j come before those of tree j+1.
+            for (size_t i = 0; i < n; ++i)
             {
-                TreeNode const tree_node(leaf_ids(i, j));
-                Node const node = rf_adaptor_.tree_to_forest(j, tree_node);
-                size_t const node_index = rf_adaptor_.getLeafIndex(node);
-                svm_features.unsafe_insert(i, node_index, 1); // The precondition "node_index must be monotonically increasing for fixed i" is fulfilled.
-//                svm_features(i, node_index) = 1;
+                svm_features.append_instance(block.begin() + i*num_new_trees, block.begin() + (i+1)*num_new_trees);
             }
         }
     }
@@ -1007,9 +4539,15 @@ void GloballyRefinedRandomForest<RANDOMFOREST>::train(
         SVM::Options opt;
         opt.normalize_ = false;
         opt.bias_value_ = 0.; // do not use bias feature
+        opt.num_threads_ = svm_num_threads_;
         SVM svm(opt);
         svm.train(svm_features, labels);
-        distinct_labels_ = std::vector<LabelType>(svm.distinct_labels().begin(), svm.distinct_labels().end());
+        std::vector<LabelType> const svm_labels(svm.distinct_labels().begin(), svm.distinct_labels().end());
+        if (first_tree == 0)
+            distinct_labels_ = svm_labels;
+        else
+            vigra_precondition(svm_labels == distinct_labels_,
+                               "GloballyRefinedRandomForest::refine(): The new data must have the same two labels.");
         weights = std::vector<double>(svm.beta().begin(), svm.beta().end()-1); // copy all weights but the bias weight
     }
 
@@ -1092,9 +4630,9 @@ void GloballyRefinedRandomForest<RANDOMFOREST>::train(
     std::vector<NodePair> pairs;
     std::vector<double> pair_weights;
 
-    // Use a priority queue to access the pairs in a sorted order.
+    // Use a priority queue to access the pairs in a sorted order, so the pair with the smallest weights is merged first.
     auto COMP = [& pair_weights](size_t const & i, size_t const & j) {
-        return pair_weights[i] < pair_weights[j];
+        return pair_weights[i] > pair_weights[j];
     };
     std::priority_queue<size_t, std::vector<size_t>, decltype(COMP)> pair_index_queue(COMP);
 
@@ -1174,7 +4712,10 @@ void GloballyRefinedRandomForest<RANDOMFOREST>::train(
 
 
 
-    // Save the produced leaf weights.
+    // Save the produced leaf weights. Each block of trees is weighted with its share of the forest,
+    // so the older weights are scaled down and the new ones are scaled by the ratio of new and all trees.
+    double const scale = num_new_trees / static_cast<double>(rf_.num_trees());
+    scale_leaf_weights(first_tree / static_cast<double>(rf_.num_trees()));
     svm_weights_.resize(rf_.num_trees());
     for (size_t i = 0; i < weights.size(); ++i) // do not use bias feature -> i+1 in termination condition
     {
@@ -1182,7 +4723,14 @@ void GloballyRefinedRandomForest<RANDOMFOREST>::train(
         size_t ti;
         TreeNode tn;
         rf_adaptor_.forest_to_tree(n, ti, tn);
-        svm_weights_[ti][tn] = weights[i];
+        svm_weights_[first_tree + ti][tn] = scale * weights[i];
+    }
+
+    // Remove the holes that were left by the pruning, so the pruned trees are as compact as freshly trained ones.
+    for (size_t j = first_tree; j < rf_.num_trees(); ++j)
+    {
+        auto const node_ids = rf_.trees()[j].compact();
+        remap_node_map(svm_weights_[j], node_ids);
     }
 
 //    // Save the betas.
@@ -1229,6 +4777,371 @@ void GloballyRefinedRandomForest<RANDOMFOREST>::predict(
 
 
 
+
+/// \brief Compressed version of a globally refined random forest.
+///
+/// The leaf weights are stored as WEIGHTTYPE (8 or 16 bit integers) with one common scale, so the prediction sums
+/// the integer weights of all trees and applies the scale only once.
+/// The split thresholds of each feature are replaced by their index in the sorted list of all thresholds of that feature,
+/// so an instance is binned once and traversing the trees only compares small integers. The binning is exact,
+/// so only the quantization of the weights changes the predictions.
+/// The nodes of all trees are stored in a single array with 8 bytes per node (using UInt16 bins).
+template <typename FEATURETYPE, typename LABELTYPE, typename WEIGHTTYPE = Int8, typename BINTYPE = UInt16>
+class QuantizedRefinedForest
+{
+public:
+
+    typedef FEATURETYPE FeatureType;
+    typedef LABELTYPE LabelType;
+    typedef WEIGHTTYPE WeightType;
+    typedef BINTYPE BinType;
+
+    static_assert(std::is_integral<WeightType>() && std::is_signed<WeightType>(),
+                  "QuantizedRefinedForest: The weight type must be a signed integer.");
+    static_assert(std::is_integral<BinType>() && std::is_unsigned<BinType>(),
+                  "QuantizedRefinedForest: The bin type must be an unsigned integer.");
+
+    QuantizedRefinedForest()
+        : scale_(1.)
+    {}
+
+    /// \brief Build the compressed model from the given trees, their leaf weights and the two labels.
+    template <typename TREE, typename WEIGHTMAP>
+    void build(
+            std::vector<TREE> const & trees,
+            std::vector<WEIGHTMAP> const & leaf_weights,
+            std::vector<LabelType> const & distinct_labels
+    );
+
+    /// \brief Predict the labels of the given instances.
+    template <typename FEATURES, typename LABELS>
+    void predict(
+            FEATURES const & features,
+            LABELS & pred_y
+    ) const;
+
+    /// \brief Return the number of trees.
+    size_t num_trees() const
+    {
+        return roots_.size();
+    }
+
+    /// \brief Return the number of bytes that are used by the model data.
+    size_t memory_size() const
+    {
+        size_t bytes = nodes_.size() * sizeof(NodeT)
+                     + weights_.size() * sizeof(WeightType)
+                     + sizeof(scale_)
+                     + roots_.size() * sizeof(UInt32);
+        for (auto const & edges : bin_edges_)
+        {
+            bytes += edges.size() * sizeof(FeatureType);
+        }
+        return bytes;
+    }
+
+protected:
+
+    /// \brief A tree node. For leaves, feature is LEAF and index is the index of the leaf weight, else it is the index of the left child (the right child follows).
+    struct NodeT
+    {
+        UInt32 index;
+        UInt16 feature;
+        BinType bin;
+    };
+
+    static UInt16 const LEAF = std::numeric_limits<UInt16>::max();
+
+    /// \brief The nodes of all trees.
+    std::vector<NodeT> nodes_;
+
+    /// \brief The root node of each tree.
+    std::vector<UInt32> roots_;
+
+    /// \brief The quantized leaf weights.
+    std::vector<WeightType> weights_;
+
+    /// \brief The common scale of the leaf weights.
+    double scale_;
+
+    /// \brief The sorted split thresholds of each feature.
+    std::vector<std::vector<FeatureType> > bin_edges_;
+
+    /// \brief The two labels.
+    std::vector<LabelType> distinct_labels_;
+
+};
+
+template <typename FEATURETYPE, typename LABELTYPE, typename WEIGHTTYPE, typename BINTYPE>
+template <typename TREE, typename WEIGHTMAP>
+void QuantizedRefinedForest<FEATURETYPE, LABELTYPE, WEIGHTTYPE, BINTYPE>::build(
+        std::vector<TREE> const & trees,
+        std::vector<WEIGHTMAP> const & leaf_weights,
+        std::vector<LabelType> const & distinct_labels
+){
+    typedef typename TREE::Node TreeNode;
+
+    vigra_precondition(trees.size() == leaf_weights.size(),
+                       "QuantizedRefinedForest::build(): Number of weight maps must be equal to number of trees.");
+    vigra_precondition(distinct_labels.size() == 2,
+                       "QuantizedRefinedForest::build(): Only implemented for two labels.");
+
+    nodes_.clear();
+    roots_.clear();
+    weights_.clear();
+    bin_edges_.clear();
+    distinct_labels_ = distinct_labels;
+
+    // Collect the thresholds of each feature.
+    for (auto const & tree : trees)
+    {
+        auto const & g = tree.get_graph();
+        std::vector<TreeNode> stack {g.getRoot()};
+        while (!stack.empty())
+        {
+            TreeNode const n = stack.back();
+            stack.pop_back();
+            if (g.outDegree(n) == 0)
+                continue;
+            auto const & s = tree.node_splits().at(n);
+            vigra_precondition(s.feature_index < LEAF,
+                               "QuantizedRefinedForest::build(): Too many features.");
+            if (s.feature_index >= bin_edges_.size())
+                bin_edges_.resize(s.feature_index+1);
+            bin_edges_[s.feature_index].push_back(s.thresh);
+            stack.push_back(g.getChild(n, 0));
+            stack.push_back(g.getChild(n, 1));
+        }
+    }
+    for (auto & edges : bin_edges_)
+    {
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+        vigra_precondition(edges.size() <= std::numeric_limits<BinType>::max(),
+                           "QuantizedRefinedForest::build(): Too many thresholds for the bin type.");
+    }
+
+    // Find the common scale of the weights of all trees.
+    double max_abs = 0.;
+    for (auto const & tree_weights : leaf_weights)
+    {
+        for (auto const & p : tree_weights)
+        {
+            max_abs = std::max(max_abs, std::abs(p.second));
+        }
+    }
+    scale_ = (max_abs > 0) ? max_abs / std::numeric_limits<WeightType>::max() : 1.;
+
+    // Flatten each tree in breadth-first order, so the children of a node are adjacent.
+    for (size_t t = 0; t < trees.size(); ++t)
+    {
+        auto const & tree = trees[t];
+        auto const & g = tree.get_graph();
+        auto const & tree_weights = leaf_weights[t];
+
+        std::queue<std::pair<TreeNode, size_t> > queue;
+        roots_.push_back(nodes_.size());
+        nodes_.push_back(NodeT());
+        queue.push({g.getRoot(), nodes_.size()-1});
+        while (!queue.empty())
+        {
+            TreeNode const n = queue.front().first;
+            size_t const k = queue.front().second;
+            queue.pop();
+            if (g.outDegree(n) == 0)
+            {
+                nodes_[k].feature = LEAF;
+                nodes_[k].bin = 0;
+                nodes_[k].index = weights_.size();
+                weights_.push_back(static_cast<WeightType>(std::round(tree_weights.at(n) / scale_)));
+            }
+            else
+            {
+                auto const & s = tree.node_splits().at(n);
+                auto const & edges = bin_edges_[s.feature_index];
+                nodes_[k].feature = s.feature_index;
+                nodes_[k].bin = std::distance(edges.begin(), std::lower_bound(edges.begin(), edges.end(), s.thresh));
+                nodes_[k].index = nodes_.size();
+                nodes_.push_back(NodeT());
+                nodes_.push_back(NodeT());
+                queue.push({g.getChild(n, 0), nodes_[k].index});
+                queue.push({g.getChild(n, 1), nodes_[k].index+1});
+            }
+        }
+    }
+    vigra_precondition(nodes_.size() <= std::numeric_limits<UInt32>::max() && weights_.size() <= std::numeric_limits<UInt32>::max(),
+                       "QuantizedRefinedForest::build(): Too many nodes.");
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename WEIGHTTYPE, typename BINTYPE>
+template <typename FEATURES, typename LABELS>
+void QuantizedRefinedForest<FEATURETYPE, LABELTYPE, WEIGHTTYPE, BINTYPE>::predict(
+        FEATURES const & features,
+        LABELS & pred_y
+) const {
+    static_assert(std::is_convertible<typename FEATURES::value_type, FeatureType>(),
+                  "QuantizedRefinedForest::predict(): Wrong feature type.");
+
+    size_t const num_instances = features.shape()[0];
+    size_t const num_features = bin_edges_.size();
+    vigra_precondition(num_features <= static_cast<size_t>(features.shape()[1]),
+                       "QuantizedRefinedForest::predict(): Too few features.");
+
+    // Process the instances in blocks, so the bins and the leaf weights of a block stay in the cache.
+    size_t const block_size = 64;
+    std::vector<BinType> bins(block_size * num_features);
+    std::vector<Int64> decision(block_size);
+    for (size_t block_begin = 0; block_begin < num_instances; block_begin += block_size)
+    {
+        size_t const n = std::min(block_size, num_instances - block_begin);
+
+        // Bin the features: bin = number of thresholds that are less or equal to the feature value,
+        // so feature < threshold if and only if bin <= threshold index.
+        for (size_t i = 0; i < n; ++i)
+        {
+            for (size_t j = 0; j < num_features; ++j)
+            {
+                auto const & edges = bin_edges_[j];
+                FeatureType const v = features(block_begin + i, j);
+                bins[i*num_features + j] = std::distance(edges.begin(), std::upper_bound(edges.begin(), edges.end(), v));
+            }
+        }
+
+        // Traverse the trees and accumulate the integer leaf weights tree by tree.
+        // The weights share one positive scale, so the sign of the integer sum is the sign of the decision value.
+        std::fill(decision.begin(), decision.begin() + n, 0);
+        for (size_t t = 0; t < roots_.size(); ++t)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                BinType const * instance_bins = &bins[i*num_features];
+                NodeT const * node = &nodes_[roots_[t]];
+                while (node->feature != LEAF)
+                {
+                    node = &nodes_[node->index + (instance_bins[node->feature] <= node->bin ? 0 : 1)];
+                }
+                decision[i] += weights_[node->index];
+            }
+        }
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            pred_y(block_begin + i) = distinct_labels_[(decision[i] >= 0) ? 0 : 1];
+        }
+    }
+}
+
+
+
+
+/// \brief Immutable single instance predictor of a globally refined random forest.
+///
+/// All methods are const and do not allocate memory, so a predictor can be shared by many threads.
+/// An instance is given as a pointer to its num_features() contiguous feature values.
+template <typename FEATURETYPE, typename LABELTYPE>
+class RefinedForestPredictor
+{
+public:
+
+    typedef FEATURETYPE FeatureType;
+    typedef LABELTYPE LabelType;
+
+    /// \brief Build the predictor from the given trees, their leaf weights and the two labels.
+    template <typename TREE, typename WEIGHTMAP>
+    void build(
+            std::vector<TREE> const & trees,
+            std::vector<WEIGHTMAP> const & leaf_weights,
+            std::vector<LabelType> const & distinct_labels
+    ){
+        vigra_precondition(trees.size() == leaf_weights.size(),
+                           "RefinedForestPredictor::build(): Number of weight maps must be equal to number of trees.");
+        vigra_precondition(distinct_labels.size() == 2,
+                           "RefinedForestPredictor::build(): Only implemented for two labels.");
+        distinct_labels_ = distinct_labels;
+        leaf_weights_.clear();
+        forest_.build(trees,
+                [this, & leaf_weights](size_t t, typename TREE::Node const & n, UInt32)
+                {
+                    leaf_weights_.push_back(leaf_weights[t].at(n));
+                }
+        );
+    }
+
+    /// \brief Return the decision value of a single instance (a non-negative value gives the first label).
+    double decision_value_one(FeatureType const * x) const
+    {
+        double v = 0.;
+        for (size_t t = 0; t < forest_.num_trees(); ++t)
+        {
+            v += leaf_weights_[forest_.leaf_index(t, x)];
+        }
+        return v;
+    }
+
+    /// \brief Predict the label of a single instance.
+    LabelType predict_one(FeatureType const * x) const
+    {
+        return distinct_labels_[(decision_value_one(x) >= 0) ? 0 : 1];
+    }
+
+    /// \brief Compute the decision values of n instances that are stored row by row in x.
+    ///
+    /// The instances are processed in small blocks with the trees in the outer loop, so the nodes of a tree stay in the cache.
+    void decision_values(FeatureType const * x, size_t n, double * values) const
+    {
+        size_t const num_features = forest_.num_features();
+        std::fill(values, values + n, 0.);
+        for (size_t block_begin = 0; block_begin < n; block_begin += block_size)
+        {
+            size_t const block_end = std::min(n, block_begin + block_size);
+            for (size_t t = 0; t < forest_.num_trees(); ++t)
+            {
+                for (size_t i = block_begin; i < block_end; ++i)
+                {
+                    values[i] += leaf_weights_[forest_.leaf_index(t, x + i*num_features)];
+                }
+            }
+        }
+    }
+
+    /// \brief Predict the labels of n instances that are stored row by row in x.
+    void predict(FeatureType const * x, size_t n, LabelType * labels) const
+    {
+        std::array<double, block_size> values;
+        size_t const num_features = forest_.num_features();
+        for (size_t block_begin = 0; block_begin < n; block_begin += block_size)
+        {
+            size_t const block_end = std::min(n, block_begin + block_size);
+            decision_values(x + block_begin*num_features, block_end - block_begin, values.data());
+            for (size_t i = block_begin; i < block_end; ++i)
+            {
+                labels[i] = distinct_labels_[(values[i - block_begin] >= 0) ? 0 : 1];
+            }
+        }
+    }
+
+    /// \brief Return the number of features of an instance.
+    size_t num_features() const
+    {
+        return forest_.num_features();
+    }
+
+protected:
+
+    static constexpr size_t block_size = 32;
+
+    detail::FlatForest<FeatureType> forest_;
+
+    /// \brief The weight of each leaf.
+    std::vector<double> leaf_weights_;
+
+    /// \brief The two labels.
+    std::vector<LabelType> distinct_labels_;
+
+};
+
+
+
 }
 
 #endif
@@ -0,0 +1,194 @@
+#ifndef VIGRA_RANDOMFOREST_MULTIPROCESS_HXX
+#define VIGRA_RANDOMFOREST_MULTIPROCESS_HXX
+
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include <cstring>
+
+#include "randomforest.hxx"
+#include "multiprocess.hxx"
+
+// Training of random forests in local worker processes. This header uses POSIX (fork, pipes and mmap), so it is not
+// included by randomforest.hxx and must be included explicitly.
+
+namespace vigra
+{
+
+namespace detail
+{
+
+    /// \brief Byte offset of the features in a training segment (the header holds the number of instances, features and labels).
+    inline size_t segment_features_offset()
+    {
+        return 64;
+    }
+
+    /// \brief Byte offset of the label ids in a training segment.
+    template <typename FEATURETYPE>
+    size_t segment_labels_offset(size_t num_instances, size_t num_features)
+    {
+        size_t const feature_bytes = num_instances * num_features * sizeof(FEATURETYPE);
+        return segment_features_offset() + (feature_bytes + sizeof(size_t) - 1) / sizeof(size_t) * sizeof(size_t);
+    }
+
+    /// \brief Write the features (column by column) and the ids of the labels in distinct_labels to a new shared memory segment.
+    template <typename FEATURETYPE, typename FEATURES, typename LABELS, typename LABELTYPE>
+    void write_training_segment(
+            FEATURES const & features,
+            LABELS const & labels,
+            std::vector<LABELTYPE> const & distinct_labels,
+            SharedMemorySegment & segment,
+            std::string const & directory
+    ){
+        size_t const num_instances = features.shape()[0];
+        size_t const num_features = features.shape()[1];
+        vigra_precondition(static_cast<size_t>(labels.size()) == num_instances,
+                           "write_training_segment(): Shape mismatch.");
+
+        size_t const labels_offset = segment_labels_offset<FEATURETYPE>(num_instances, num_features);
+        segment.create(directory, labels_offset + num_instances * sizeof(size_t));
+        UInt64 const header[3] = {num_instances, num_features, distinct_labels.size()};
+        std::memcpy(segment.data(), header, sizeof(header));
+
+        FEATURETYPE * const x = reinterpret_cast<FEATURETYPE *>(segment.data() + segment_features_offset());
+        for (size_t j = 0; j < num_features; ++j)
+        {
+            for (size_t i = 0; i < num_instances; ++i)
+            {
+                x[j*num_instances + i] = features(i, j);
+            }
+        }
+
+        std::map<LABELTYPE, size_t> label_id;
+        for (size_t i = 0; i < distinct_labels.size(); ++i)
+        {
+            label_id[distinct_labels[i]] = i;
+        }
+        size_t * const y = reinterpret_cast<size_t *>(segment.data() + labels_offset);
+        for (size_t i = 0; i < num_instances; ++i)
+        {
+            y[i] = label_id.at(labels(i));
+        }
+    }
+
+} // namespace detail
+
+
+
+/// \brief Worker side of add_trees_multiprocess: Map the training segment, train one tree of the forest type RF for each seed
+/// and write the serialized trees to os.
+///
+/// This can also be called by workers that were started with other local launchers, the coordinator passes the
+/// written data to RandomForest0::add_serialized_trees.
+template <typename RF, typename SAMPLER, typename TERMINATION, typename SPLITFUNCTOR>
+void train_trees_from_segment(
+        std::string const & path,
+        std::vector<size_t> const & seeds,
+        std::ostream & os,
+        SAMPLER const & sampler = SAMPLER(),
+        TERMINATION const & termination = TERMINATION(),
+        SPLITFUNCTOR const & functor = SPLITFUNCTOR()
+){
+    typedef typename RF::FeatureType FeatureType;
+    typedef typename RF::Tree Tree;
+
+    static_assert(detail::IsSerializableTree<Tree>(),
+                  "train_trees_from_segment(): Only forests of DecisionTree0 can be trained in worker processes.");
+
+    SharedMemorySegment segment;
+    segment.open(path);
+    vigra_precondition(segment.size() >= detail::segment_features_offset(),
+                       "train_trees_from_segment(): Invalid segment.");
+    UInt64 header[3];
+    std::memcpy(header, segment.data(), sizeof(header));
+    size_t const num_instances = header[0];
+    size_t const num_features = header[1];
+    size_t const num_labels = header[2];
+    size_t const labels_offset = detail::segment_labels_offset<FeatureType>(num_instances, num_features);
+    vigra_precondition(segment.size() == labels_offset + num_instances * sizeof(size_t),
+                       "train_trees_from_segment(): Invalid segment.");
+
+    // The views only read from the mapped memory.
+    FeatureType * const x = reinterpret_cast<FeatureType *>(const_cast<char *>(segment.data()) + detail::segment_features_offset());
+    size_t * const y = reinterpret_cast<size_t *>(const_cast<char *>(segment.data()) + labels_offset);
+    MultiArrayView<2, FeatureType> const x_view(Shape2(num_instances, num_features), x);
+    MultiArrayView<1, size_t> const y_view(Shape1(num_instances), y);
+    FeatureGetter<FeatureType> const features(x_view);
+    LabelGetter<size_t> const labels(y_view);
+
+    detail::write_binary(os, static_cast<UInt64>(seeds.size()));
+    for (size_t const seed : seeds)
+    {
+        Tree tree(seed);
+        tree.set_num_labels(num_labels);
+        tree.template train<FeatureGetter<FeatureType>, LabelGetter<size_t>, SAMPLER, TERMINATION, SPLITFUNCTOR>(
+                    features, labels, sampler, termination, functor);
+        tree.serialize(os);
+    }
+}
+
+/// \brief Train additional trees of rf in num_processes local worker processes and append them to the forest.
+///
+/// The features and the label ids are written to a shared memory segment in the given directory, which the
+/// workers map read-only. Each worker trains a disjoint range of the tree seeds and streams the serialized trees
+/// back, so the forest is the same as after add_trees with the same random engine. The forest (including its
+/// distinct labels) is only changed if all workers succeeded.
+///
+/// The features are always copied densely into the segment and the workers train on a FeatureGetter, so sparse
+/// feature getters are densified (the segment needs num_instances x num_features values). The trees are the same
+/// as the trees that add_trees trains on the equivalent dense features.
+template <typename FEATURES, typename LABELS, typename SAMPLER, typename TERMINATION, typename SPLITFUNCTOR,
+          typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE, typename TREE>
+void add_trees_multiprocess(
+        RandomForest0<FEATURETYPE, LABELTYPE, RANDENGINE, TREE> & rf,
+        FEATURES const & data_x,
+        LABELS const & data_y,
+        size_t const num_trees,
+        size_t const num_processes,
+        SAMPLER const & sampler = SAMPLER(),
+        TERMINATION const & termination = TERMINATION(),
+        SPLITFUNCTOR const & functor = SPLITFUNCTOR(),
+        std::string const & directory = "/dev/shm"
+){
+    typedef RandomForest0<FEATURETYPE, LABELTYPE, RANDENGINE, TREE> RF;
+
+    static_assert(std::is_convertible<typename FEATURES::value_type, FEATURETYPE>(),
+                  "add_trees_multiprocess(): Wrong feature type.");
+    static_assert(std::is_convertible<typename LABELS::value_type, LABELTYPE>(),
+                  "add_trees_multiprocess(): Wrong label type.");
+    static_assert(detail::IsSerializableTree<TREE>(),
+                  "add_trees_multiprocess(): Only forests of DecisionTree0 can be trained in worker processes.");
+
+    vigra_precondition(num_processes > 0,
+                       "add_trees_multiprocess(): num_processes must be greater than zero.");
+
+    // Write the training data with the label ids of the extended distinct labels, so all workers use the same ids.
+    std::vector<LABELTYPE> const distinct_labels = rf.extended_distinct_labels(data_y);
+    SharedMemorySegment segment;
+    detail::write_training_segment<FEATURETYPE>(data_x, data_y, distinct_labels, segment, directory);
+
+    // Give each worker a contiguous range of the seeds, so the trees come back in the same order as in add_trees.
+    std::vector<size_t> const seeds = rf.draw_seeds(num_trees);
+    size_t const n = std::min(num_processes, std::max(num_trees, static_cast<size_t>(1)));
+    std::string const & path = segment.path();
+    std::vector<std::string> const results = run_worker_processes(n,
+            [& seeds, & path, & sampler, & termination, & functor, n](size_t p, std::ostream & os)
+            {
+                std::vector<size_t> const worker_seeds(seeds.begin() + p * seeds.size() / n,
+                                                       seeds.begin() + (p+1) * seeds.size() / n);
+                train_trees_from_segment<RF, SAMPLER, TERMINATION, SPLITFUNCTOR>(
+                        path, worker_seeds, os, sampler, termination, functor);
+            }
+    );
+
+    // Merge the trees of all workers.
+    rf.add_serialized_trees(results, distinct_labels);
+}
+
+
+
+} // namespace vigra
+
+#endif // VIGRA_RANDOMFOREST_MULTIPROCESS_HXX
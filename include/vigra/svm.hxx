@@ -4,12 +4,17 @@
 #include <vector>
 #include <set>
 #include <map>
+#include <array>
+#include <algorithm>
+#include <atomic>
+#include <numeric>
 
 #include <vigra/multi_array.hxx>
 #include <vigra/random.hxx>
 
 #include "kmeans.hxx"
 #include "feature_getter.hxx"
+#include "parallel.hxx"
 
 
 
@@ -267,163 +272,474 @@ namespace detail
 
 
 
-    template <typename SVM, typename FEATURES, typename LABELS>
-    class TwoClassSVMTrainFunctor
+    /// \brief The type of the normalized features (with the bias feature) that are used in the dual coordinate descent.
+    template <typename FEATURES>
+    struct SVMNormalizedFeatures
     {
-    public:
+        typedef MultiArray<2, double> type;
+    };
 
-        typedef typename SVM::Options Options;
-        typedef typename SVM::FeatureType FeatureType;
-        typedef typename SVM::LabelType LabelType;
-        typedef typename SVM::RandEngine RandEngine;
-        typedef FEATURES Features;
-        typedef LABELS Labels;
-        typedef MultiArray<2, double> NormalizedType;
-        typedef NormalizeFunctor<Features, NormalizedType > Normalizer;
+    template <typename T>
+    struct SVMNormalizedFeatures<SparseFeatureGetter<T> >
+    {
+        typedef SparseFeatureGetter<T> type;
+    };
 
-        static_assert(std::is_convertible<typename Features::value_type, FeatureType>(),
-                      "TwoClassSVMTrainFunctor: Wrong feature type.");
-        static_assert(std::is_convertible<typename Labels::value_type, LabelType>(),
-                      "TwoClassSVMTrainFunctor: Wrong label type.");
+    template <typename T>
+    struct SVMNormalizedFeatures<BinarySparseFeatureGetter<T> >
+    {
+        typedef BinarySparseFeatureGetter<T> type;
+    };
 
-        TwoClassSVMTrainFunctor(
-                SVM & svm,
-                RandEngine const & randengine = RandEngine::global()
-        )   : svm_(svm),
-              randengine_(randengine)
-        {}
+    /// \brief Normalize the features (if options.normalize_ is set), append the bias feature and return the normalization.
+    template <typename FEATURES, typename OPTIONS>
+    void normalize_svm_features(
+            FEATURES const & features,
+            OPTIONS const & options,
+            MultiArray<2, double> & normalized_features,
+            std::vector<double> & mean,
+            std::vector<double> & std_dev
+    ){
+        size_t const num_features = features.shape()[1];
+        NormalizeFunctor<FEATURES, MultiArray<2, double> > normalizer(options.bias_value_);
+        if (options.normalize_)
+        {
+            normalizer.find_normalization(features);
+        }
+        else
+        {
+            normalizer.mean().resize(num_features, 0.); // the bias feature is never normalized
+            normalizer.std_dev().resize(num_features, 1.);
+        }
+        normalizer.apply_normalization(features, normalized_features);
+        mean = normalizer.mean();
+        std_dev = normalizer.std_dev();
+    }
 
-        void operator()(
-                Features const & features,
-                Labels const & labels
-        ){
-            size_t const num_instances = features.shape()[0];
-            size_t num_features = features.shape()[1]+1; // +1 for the bias feature
+    /// \brief Normalize the sparse features (if options.normalize_ is set) and return the normalization.
+    /// \note Without normalization, the features are used as they are (without the bias feature).
+    template <typename T, typename OPTIONS>
+    void normalize_svm_features(
+            SparseFeatureGetter<T> const & features,
+            OPTIONS const & options,
+            SparseFeatureGetter<T> & normalized_features,
+            std::vector<double> & mean,
+            std::vector<double> & std_dev
+    ){
+        size_t const num_features = features.shape()[1];
+        NormalizeFunctor<SparseFeatureGetter<T>, SparseFeatureGetter<T> > normalizer(options.bias_value_);
+        if (options.normalize_)
+        {
+            normalizer.find_normalization(features);
+            normalizer.apply_normalization(features, normalized_features);
+        }
+        else
+        {
+            normalizer.mean().resize(num_features, 0.); // the bias feature is not normalized
+            normalizer.std_dev().resize(num_features, 1.);
+            normalized_features = features;
+        }
+        mean = normalizer.mean();
+        std_dev = normalizer.std_dev();
+    }
+
+    /// \brief Binary features cannot be normalized, so they are used as they are (without the bias feature).
+    template <typename T, typename OPTIONS>
+    void normalize_svm_features(
+            BinarySparseFeatureGetter<T> const & features,
+            OPTIONS const & options,
+            BinarySparseFeatureGetter<T> & normalized_features,
+            std::vector<double> & mean,
+            std::vector<double> & std_dev
+    ){
+        vigra_precondition(!options.normalize_,
+                           "normalize_svm_features(): Binary features cannot be normalized.");
+        size_t const num_features = features.shape()[1];
+        mean.assign(num_features, 0.);
+        std_dev.assign(num_features, 1.);
+        normalized_features = features;
+    }
 
-            // Get alpha and beta vector from the SVM.
-            auto & alpha_ = svm_.alpha();
-            auto & beta_ = svm_.beta();
+    /// \brief Return the dot product of instance i with beta.
+    template <typename BETA>
+    double svm_instance_dot(
+            MultiArray<2, double> const & features,
+            size_t const i,
+            BETA const & beta
+    ){
+        double v = 0.;
+        size_t const num_features = beta.size();
+        for (size_t j = 0; j < num_features; ++j)
+        {
+            v += features(i, j) * beta(j);
+        }
+        return v;
+    }
 
-            // Find the feature normalization.
-            normalizer_.bias_value_ = svm_.options().bias_value_;
-            auto normalized_features = NormalizedType();
-            if (svm_.options().normalize_)
+    template <typename T, typename BETA>
+    double svm_instance_dot(
+            SparseFeatureGetter<T> const & features,
+            size_t const i,
+            BETA const & beta
+    ){
+        double v = 0.;
+        for (auto it = features.begin_instance_nonzero(i); it != features.end_instance_nonzero(i); ++it)
+        {
+            auto const j = (*it).first;
+            auto const f = (*it).second;
+            v += f * beta(j);
+        }
+        return v;
+    }
+
+    template <typename T, typename BETA>
+    double svm_instance_dot(
+            BinarySparseFeatureGetter<T> const & features,
+            size_t const i,
+            BETA const & beta
+    ){
+        double v = 0.;
+        for (auto it = features.begin_instance_indices(i); it != features.end_instance_indices(i); ++it)
+        {
+            v += beta(*it);
+        }
+        return v;
+    }
+
+    /// \brief Add a times instance i to beta.
+    template <typename BETA>
+    void svm_instance_add(
+            MultiArray<2, double> const & features,
+            size_t const i,
+            double const a,
+            BETA & beta
+    ){
+        size_t const num_features = beta.size();
+        for (size_t j = 0; j < num_features; ++j)
+        {
+            beta(j) += a * features(i, j);
+        }
+    }
+
+    template <typename T, typename BETA>
+    void svm_instance_add(
+            SparseFeatureGetter<T> const & features,
+            size_t const i,
+            double const a,
+            BETA & beta
+    ){
+        for (auto it = features.begin_instance_nonzero(i); it != features.end_instance_nonzero(i); ++it)
+        {
+            auto const j = (*it).first;
+            auto const f = (*it).second;
+            beta(j) += a * f;
+        }
+    }
+
+    template <typename T, typename BETA>
+    void svm_instance_add(
+            BinarySparseFeatureGetter<T> const & features,
+            size_t const i,
+            double const a,
+            BETA & beta
+    ){
+        for (auto it = features.begin_instance_indices(i); it != features.end_instance_indices(i); ++it)
+        {
+            beta(*it) += a;
+        }
+    }
+
+    /// \brief Return the squared norm of instance i.
+    inline double svm_instance_squared_norm(
+            MultiArray<2, double> const & features,
+            size_t const i
+    ){
+        double v = 0.;
+        size_t const num_features = features.shape()[1];
+        for (size_t j = 0; j < num_features; ++j)
+        {
+            double const f = features(i, j);
+            v += f * f;
+        }
+        return v;
+    }
+
+    template <typename T>
+    double svm_instance_squared_norm(
+            SparseFeatureGetter<T> const & features,
+            size_t const i
+    ){
+        double v = 0.;
+        for (auto it = features.begin_instance_nonzero(i); it != features.end_instance_nonzero(i); ++it)
+        {
+            double const f = (*it).second;
+            v += f * f;
+        }
+        return v;
+    }
+
+    template <typename T>
+    double svm_instance_squared_norm(
+            BinarySparseFeatureGetter<T> const & features,
+            size_t const i
+    ){
+        return features.count_nonzero(i);
+    }
+
+    /// \brief Weight vector that is shared by the threads of the parallel dual coordinate descent.
+    ///
+    /// The non-const operator() returns a reference proxy, so the svm_instance_* functions work unchanged.
+    /// The entries are read and written with relaxed atomic loads and stores, but += is not a single atomic
+    /// operation ("wild" updates): A concurrent update of the same entry may be lost. This is much cheaper than
+    /// a compare-and-swap loop, and the lost updates are repaired by recomputing beta from alpha at the end.
+    class SharedSVMWeights
+    {
+    public:
+
+        class Reference
+        {
+        public:
+
+            explicit Reference(std::atomic<double> & x)
+                : x_(x)
+            {}
+
+            operator double() const
             {
-                normalizer_.find_normalization(features);
+                return x_.load(std::memory_order_relaxed);
             }
-            else
+
+            Reference & operator+=(double const a)
             {
-                normalizer_.mean().resize(num_features-1, 0.); // num_features-1 since the bias feature is never normalized
-                normalizer_.std_dev().resize(num_features-1, 1.); // num_features-1 since the bias feature is never normalized
+                x_.store(x_.load(std::memory_order_relaxed) + a, std::memory_order_relaxed);
+                return *this;
             }
-            normalizer_.apply_normalization(features, normalized_features);
-            svm_.mean() = normalizer_.mean();
-            svm_.std_dev() = normalizer_.std_dev();
 
-            // Precompute the squared norm of the instances.
-            auto x_squ = MultiArray<1, double>(Shape1(num_instances));
-            for (size_t i = 0; i < num_instances; ++i)
+        protected:
+
+            std::atomic<double> & x_;
+        };
+
+        explicit SharedSVMWeights(MultiArray<1, double> const & beta)
+            : weights_(beta.size())
+        {
+            for (size_t j = 0; j < weights_.size(); ++j)
             {
-                double v = 0.;
-                for (size_t j = 0; j < num_features; ++j)
-                {
-                    double f = normalized_features(i, j);
-                    v += f * f;
-                }
-                x_squ(i) = v;
+                weights_[j].store(beta(j), std::memory_order_relaxed);
             }
+        }
 
-            // Initialize alphas and betas.
-            beta_.reshape(Shape1(num_features), 0.);
-            if (alpha_.size() == num_instances)
-            {
-                // The alphas are initialized, so we must create the according betas.
-                for (size_t i = 0; i < num_instances; ++i)
-                {
-                    for (size_t j = 0; j < num_features; ++j)
+        size_t size() const
+        {
+            return weights_.size();
+        }
+
+        Reference operator()(size_t const j)
+        {
+            return Reference(weights_[j]);
+        }
+
+        double operator()(size_t const j) const
+        {
+            return weights_[j].load(std::memory_order_relaxed);
+        }
+
+    protected:
+
+        std::vector<std::atomic<double> > weights_;
+    };
+
+    /// \brief Run the iterations of the dual coordinate descent with num_workers threads (PASSCoDe-Wild [Hsieh et al. 2015]).
+    ///
+    /// In each epoch, the shuffled instances are split into one contiguous part per thread, so every alpha is updated by
+    /// a single thread, while beta is shared and updated without locks. The gradients may thus use slightly outdated
+    /// weights and concurrent updates of the same weight may be lost. This rarely happens if the instances touch only
+    /// a few features, as the leaf indicators of a forest do. At the end, beta is recomputed from alpha, so both are consistent.
+    template <typename FEATURES, typename LABELS, typename OPTIONS, typename RANDENGINE>
+    void svm_parallel_coordinate_descent(
+            FEATURES const & normalized_features,
+            LABELS const & labels,
+            OPTIONS const & options,
+            MultiArray<1, double> const & x_squ,
+            MultiArray<1, double> & alpha,
+            MultiArray<1, double> & beta,
+            RANDENGINE const & randengine,
+            size_t const num_workers
+    ){
+        size_t const num_instances = x_squ.size();
+        SharedSVMWeights shared_beta(beta);
+        std::vector<size_t> diff_counts(num_workers);
+        std::vector<double> min_grads(num_workers);
+        std::vector<double> max_grads(num_workers);
+
+        auto indices = std::vector<size_t>(num_instances);
+        std::iota(indices.begin(), indices.end(), 0);
+        auto rand_int = UniformIntRandomFunctor<RANDENGINE>(randengine);
+        for (size_t t = 0; t < options.max_t_;)
+        {
+            std::random_shuffle(indices.begin(), indices.end(), rand_int);
+            size_t const n = std::min(num_instances, options.max_t_ - t);
+            parallel_for(num_workers, num_workers,
+                    [&](size_t w)
                     {
-                        beta_(j) += alpha_(i) * labels(i) * normalized_features(i, j);
+                        size_t diff_count = 0;
+                        double min_grad = std::numeric_limits<double>::max();
+                        double max_grad = std::numeric_limits<double>::lowest();
+                        for (size_t k = w*n/num_workers; k < (w+1)*n/num_workers; ++k)
+                        {
+                            size_t const i = indices[k];
+
+                            // Compute the gradient and update alpha and beta, as in the sequential loop.
+                            auto const grad = labels(i) * svm_instance_dot(normalized_features, i, shared_beta) - 1;
+                            auto const old_alpha = alpha(i);
+                            alpha(i) = std::max(0., std::min(options.U_, alpha(i) - grad/x_squ(i)));
+                            if (alpha(i) != old_alpha)
+                                svm_instance_add(normalized_features, i, labels(i) * (alpha(i) - old_alpha), shared_beta);
+
+                            // Compute the projected gradient and update the stopping criteria.
+                            auto proj_grad = grad;
+                            if (alpha(i) <= 0)
+                                proj_grad = std::min(grad, 0.);
+                            else if (alpha(i) >= options.U_)
+                                proj_grad = std::max(grad, 0.);
+                            min_grad = std::min(min_grad, proj_grad);
+                            max_grad = std::max(max_grad, proj_grad);
+                            if (std::abs(alpha(i) - old_alpha) > options.alpha_tol_)
+                            {
+                                ++diff_count;
+                            }
+                        }
+                        diff_counts[w] = diff_count;
+                        min_grads[w] = min_grad;
+                        max_grads[w] = max_grad;
                     }
-                }
-            }
-            else
+            );
+            t += n;
+
+            size_t const diff_count = std::accumulate(diff_counts.begin(), diff_counts.end(), static_cast<size_t>(0));
+            double const min_grad = *std::min_element(min_grads.begin(), min_grads.end());
+            double const max_grad = *std::max_element(max_grads.begin(), max_grads.end());
+            if (max_grad - min_grad < options.grad_tol_ ||
+                    diff_count <= options.max_total_diffs_ ||
+                    diff_count <= options.max_relative_diffs_ * num_instances)
             {
-                // The alphas are not initialized, so all alphas and betas are 0.
-                alpha_.reshape(Shape1(num_instances), 0.);
+                break;
             }
+        }
 
-            // Do the SVM loop.
-            auto indices = std::vector<size_t>(num_instances);
-            std::iota(indices.begin(), indices.end(), 0);
-            auto rand_int = UniformIntRandomFunctor<RandEngine>(randengine_);
-            for (size_t t = 0; t < svm_.options().max_t_;)
-            {
-                std::random_shuffle(indices.begin(), indices.end(), rand_int);
-                size_t diff_count = 0;
-                double min_grad = std::numeric_limits<double>::max();
-                double max_grad = std::numeric_limits<double>::lowest();
-                for (size_t i : indices)
-                {
-                    // Compute the gradient.
-                    double v = 0.;
-                    for (size_t j = 0; j < num_features; ++j)
-                    {
-                        v += normalized_features(i, j) * beta_(j);
-                    }
-                    auto const grad = labels(i) * v - 1;
+        // Restore the consistency: beta = sum_i alpha_i y_i x_i.
+        beta = 0.;
+        for (size_t i = 0; i < num_instances; ++i)
+        {
+            if (alpha(i) != 0)
+                svm_instance_add(normalized_features, i, alpha(i) * labels(i), beta);
+        }
+    }
 
-                    // Update alpha
-                    auto old_alpha = alpha_(i);
-                    alpha_(i) = std::max(0., std::min(svm_.options().U_, alpha_(i) - grad/x_squ(i)));
+    /// \brief Solve the dual SVM problem on the normalized features with dual coordinate descent [Hsieh et al. 2008].
+    /// \param labels: the labels (+1 and -1)
+    /// \param num_features: the number of features including the bias feature (the size of beta)
+    /// \param alpha[in, out]: the alphas, they are used as warm start if they have one entry per instance
+    /// \param beta[out]: the weights
+    template <typename FEATURES, typename LABELS, typename OPTIONS, typename RANDENGINE>
+    void svm_dual_coordinate_descent(
+            FEATURES const & normalized_features,
+            LABELS const & labels,
+            size_t const num_features,
+            OPTIONS const & options,
+            MultiArray<1, double> & alpha,
+            MultiArray<1, double> & beta,
+            RANDENGINE const & randengine
+    ){
+        size_t const num_instances = normalized_features.shape()[0];
+
+        // Precompute the squared norm of the instances.
+        auto x_squ = MultiArray<1, double>(Shape1(num_instances));
+        for (size_t i = 0; i < num_instances; ++i)
+        {
+            x_squ(i) = svm_instance_squared_norm(normalized_features, i);
+        }
 
-                    // Update beta.
-                    for (size_t j = 0; j < num_features; ++j)
-                    {
-                        beta_(j) += labels(i) * normalized_features(i, j) * (alpha_(i) - old_alpha);
-                    }
+        // Initialize alphas and betas.
+        beta.reshape(Shape1(num_features), 0.);
+        if (static_cast<size_t>(alpha.size()) == num_instances)
+        {
+            // The alphas are initialized, so we must create the according betas.
+            for (size_t i = 0; i < num_instances; ++i)
+            {
+                svm_instance_add(normalized_features, i, alpha(i) * labels(i), beta);
+            }
+        }
+        else
+        {
+            // The alphas are not initialized, so all alphas and betas are 0.
+            alpha.reshape(Shape1(num_instances), 0.);
+        }
 
-                    // Compute the projected gradient (for the stopping criteria).
-                    auto proj_grad = grad;
-                    if (alpha_(i) <= 0)
-                        proj_grad = std::min(grad, 0.);
-                    else if (alpha_(i) >= svm_.options().U_)
-                        proj_grad = std::max(grad, 0.);
-                    min_grad = std::min(min_grad, proj_grad);
-                    max_grad = std::max(max_grad, proj_grad);
-
-                    // Update the stopping criteria.
-                    if (std::abs(alpha_(i) - old_alpha) > svm_.options().alpha_tol_)
-                    {
-                        ++diff_count;
-                    }
-                    ++t;
-                    if (t >= svm_.options().max_t_)
-                    {
-                        break;
-                    }
-                }
+        // Run the iterations in parallel if more than one thread is requested.
+        size_t const num_workers = std::min(detail::num_workers(options.num_threads_), num_instances);
+        if (num_workers > 1)
+        {
+            svm_parallel_coordinate_descent(normalized_features, labels, options, x_squ, alpha, beta, randengine, num_workers);
+            return;
+        }
 
-                if (max_grad - min_grad < svm_.options().grad_tol_ ||
-                        diff_count <= svm_.options().max_total_diffs_ ||
-                        diff_count <= svm_.options().max_relative_diffs_ * num_instances)
+        // Do the SVM loop.
+        auto indices = std::vector<size_t>(num_instances);
+        std::iota(indices.begin(), indices.end(), 0);
+        auto rand_int = UniformIntRandomFunctor<RANDENGINE>(randengine);
+        for (size_t t = 0; t < options.max_t_;)
+        {
+            std::random_shuffle(indices.begin(), indices.end(), rand_int);
+            size_t diff_count = 0;
+            double min_grad = std::numeric_limits<double>::max();
+            double max_grad = std::numeric_limits<double>::lowest();
+            for (size_t i : indices)
+            {
+                // Compute the gradient.
+                auto const grad = labels(i) * svm_instance_dot(normalized_features, i, beta) - 1;
+
+                // Update alpha
+                auto old_alpha = alpha(i);
+                alpha(i) = std::max(0., std::min(options.U_, alpha(i) - grad/x_squ(i)));
+
+                // Update beta.
+                svm_instance_add(normalized_features, i, labels(i) * (alpha(i) - old_alpha), beta);
+
+                // Compute the projected gradient (for the stopping criteria).
+                auto proj_grad = grad;
+                if (alpha(i) <= 0)
+                    proj_grad = std::min(grad, 0.);
+                else if (alpha(i) >= options.U_)
+                    proj_grad = std::max(grad, 0.);
+                min_grad = std::min(min_grad, proj_grad);
+                max_grad = std::max(max_grad, proj_grad);
+
+                // Update the stopping criteria.
+                if (std::abs(alpha(i) - old_alpha) > options.alpha_tol_)
+                {
+                    ++diff_count;
+                }
+                ++t;
+                if (t >= options.max_t_)
                 {
                     break;
                 }
             }
-        }
-
-    protected:
 
-        SVM & svm_;
-        RandEngine const & randengine_;
-        Normalizer normalizer_;
-
-    };
+            if (max_grad - min_grad < options.grad_tol_ ||
+                    diff_count <= options.max_total_diffs_ ||
+                    diff_count <= options.max_relative_diffs_ * num_instances)
+            {
+                break;
+            }
+        }
+    }
 
 
 
-    template <typename SVM, typename T, typename LABELS>
-    class TwoClassSVMTrainFunctor<SVM, SparseFeatureGetter<T>, LABELS>
+    template <typename SVM, typename FEATURES, typename LABELS>
+    class TwoClassSVMTrainFunctor
     {
     public:
 
@@ -431,9 +747,9 @@ namespace detail
         typedef typename SVM::FeatureType FeatureType;
         typedef typename SVM::LabelType LabelType;
         typedef typename SVM::RandEngine RandEngine;
-        typedef SparseFeatureGetter<T> Features;
+        typedef FEATURES Features;
         typedef LABELS Labels;
-        typedef NormalizeFunctor<Features, Features> Normalizer;
+        typedef typename SVMNormalizedFeatures<Features>::type NormalizedType;
 
         static_assert(std::is_convertible<typename Features::value_type, FeatureType>(),
                       "TwoClassSVMTrainFunctor: Wrong feature type.");
@@ -451,284 +767,245 @@ namespace detail
                 Features const & features,
                 Labels const & labels
         ){
-            size_t const num_instances = features.shape()[0];
-            size_t num_features = features.shape()[1]+1; // +1 for the bias feature
-
-            // Get alpha and beta vector from the SVM.
-            auto & alpha_ = svm_.alpha();
-            auto & beta_ = svm_.beta();
-
-            // Find the feature normalization.
-            normalizer_.bias_value_ = svm_.options().bias_value_;
-            auto normalized_features = Features();
-            if (svm_.options().normalize_)
-            {
-                normalizer_.find_normalization(features);
-                normalizer_.apply_normalization(features, normalized_features);
-            }
-            else
-            {
-                normalizer_.mean().resize(num_features-1, 0.); // num_features-1 since the bias feature is not normalized
-                normalizer_.std_dev().resize(num_features-1, 1.); // num_features-1 since the bias feature is not normalized
-                normalized_features = Features(features);
-            }
-            svm_.mean() = normalizer_.mean();
-            svm_.std_dev() = normalizer_.std_dev();
-
-            // Precompute the squared norm of the instances.
-            auto x_squ = MultiArray<1, double>(Shape1(num_instances));
-            for (size_t i = 0; i < num_instances; ++i)
-            {
-                double v = 0.;
-                for (auto it = normalized_features.begin_instance_nonzero(i); it != normalized_features.end_instance_nonzero(i); ++it)
-                {
-                    double f = (*it).second;
-                    v += f*f;
-                }
-                x_squ(i) = v;
-            }
-
-            // Initialize alphas and betas.
-            beta_.reshape(Shape1(num_features), 0.);
-            if (alpha_.size() == num_instances)
-            {
-                // The alphas are initialized, so we must create the according betas.
-                for (size_t i = 0; i < num_instances; ++i)
-                {
-                    for (auto it = normalized_features.begin_instance_nonzero(i); it != normalized_features.end_instance_nonzero(i); ++it)
-                    {
-                        auto const j = (*it).first;
-                        auto const f = (*it).second;
-                        beta_(j) += alpha_(i) * labels(i) * f;
-                    }
-                }
-            }
-            else
-            {
-                // The alphas are not initialized, so all alphas and betas are 0.
-                alpha_.reshape(Shape1(num_instances), 0.);
-            }
-
-            // Do the SVM loop.
-            auto indices = std::vector<size_t>(num_instances);
-            std::iota(indices.begin(), indices.end(), 0);
-            auto rand_int = UniformIntRandomFunctor<RandEngine>(randengine_);
-            for (size_t t = 0; t < svm_.options().max_t_;)
-            {
-                std::random_shuffle(indices.begin(), indices.end(), rand_int);
-                size_t diff_count = 0;
-                double min_grad = std::numeric_limits<double>::max();
-                double max_grad = std::numeric_limits<double>::lowest();
-                for (size_t i : indices)
-                {
-                    // Compute the gradient.
-                    double v = 0.;
-                    for (auto it = normalized_features.begin_instance_nonzero(i); it != normalized_features.end_instance_nonzero(i); ++it)
-                    {
-                        auto const j = (*it).first;
-                        auto const f = (*it).second;
-                        v += f * beta_(j);
-                    }
-                    auto const grad = labels(i) * v - 1;
-
-                    // Update alpha
-                    auto old_alpha = alpha_(i);
-                    alpha_(i) = std::max(0., std::min(svm_.options().U_, alpha_(i) - grad/x_squ(i)));
-
-                    // Update beta.
-                    for (auto it = normalized_features.begin_instance_nonzero(i); it != normalized_features.end_instance_nonzero(i); ++it)
-                    {
-                        auto const j = (*it).first;
-                        auto const f = (*it).second;
-                        beta_(j) += labels(i) * f * (alpha_(i) - old_alpha);
-                    }
-
-                    // Compute the projected gradient (for the stopping criteria).
-                    auto proj_grad = grad;
-                    if (alpha_(i) <= 0)
-                        proj_grad = std::min(grad, 0.);
-                    else if (alpha_(i) >= svm_.options().U_)
-                        proj_grad = std::max(grad, 0.);
-                    min_grad = std::min(min_grad, proj_grad);
-                    max_grad = std::max(max_grad, proj_grad);
-
-                    // Update the stopping criteria.
-                    if (std::abs(alpha_(i) - old_alpha) > svm_.options().alpha_tol_)
-                    {
-                        ++diff_count;
-                    }
-                    ++t;
-                    if (t >= svm_.options().max_t_)
-                    {
-                        break;
-                    }
-                }
-
-                if (max_grad - min_grad < svm_.options().grad_tol_ ||
-                        diff_count <= svm_.options().max_total_diffs_ ||
-                        diff_count <= svm_.options().max_relative_diffs_ * num_instances)
-                {
-                    break;
-                }
-            }
+            size_t const num_features = features.shape()[1]+1; // +1 for the bias feature
+            auto normalized_features = NormalizedType();
+            normalize_svm_features(features, svm_.options(), normalized_features, svm_.mean(), svm_.std_dev());
+            svm_dual_coordinate_descent(normalized_features, labels, num_features, svm_.options(),
+                                        svm_.alpha(), svm_.beta(), randengine_);
         }
 
     protected:
 
         SVM & svm_;
         RandEngine const & randengine_;
-        Normalizer normalizer_;
 
     };
 
 
 
-    template <typename SVM, typename FEATURES, typename LABELS>
-    class TwoClassSVMPredictFunctor
+    /// \brief Train functor for binary features: They are not normalized, so the dual coordinate descent runs directly on the given features.
+    template <typename SVM, typename T, typename LABELS>
+    class TwoClassSVMTrainFunctor<SVM, BinarySparseFeatureGetter<T>, LABELS>
     {
     public:
 
         typedef typename SVM::Options Options;
         typedef typename SVM::FeatureType FeatureType;
         typedef typename SVM::LabelType LabelType;
-        typedef FEATURES Features;
+        typedef typename SVM::RandEngine RandEngine;
+        typedef BinarySparseFeatureGetter<T> Features;
         typedef LABELS Labels;
-        typedef MultiArray<2, double> NormalizedType;
-        typedef NormalizeFunctor<Features, NormalizedType > Normalizer;
 
         static_assert(std::is_convertible<typename Features::value_type, FeatureType>(),
                       "TwoClassSVMTrainFunctor: Wrong feature type.");
         static_assert(std::is_convertible<typename Labels::value_type, LabelType>(),
                       "TwoClassSVMTrainFunctor: Wrong label type.");
 
-        TwoClassSVMPredictFunctor(
-                SVM const & svm,
-                std::vector<LabelType> const & distinct_labels
+        TwoClassSVMTrainFunctor(
+                SVM & svm,
+                RandEngine const & randengine = RandEngine::global()
         )   : svm_(svm),
-              distinct_labels_(distinct_labels)
+              randengine_(randengine)
         {}
 
         void operator()(
                 Features const & features,
-                Labels & labels
-        ) const {
-            vigra_precondition(distinct_labels_.size() == 1 || distinct_labels_.size() == 2,
-                               "TwoClassSVMPredictFunctor::operator(): Number of labels found in training must be 1 or 2.");
-            vigra_precondition(features.shape()[1]+1 == svm_.beta().size(),
-                               "TwoClassSVMPredictFunctor::operator(): Wrong number of features.");
+                Labels const & labels
+        ){
+            vigra_precondition(!svm_.options().normalize_,
+                               "TwoClassSVMTrainFunctor: Binary features cannot be normalized.");
+            size_t const num_features = features.shape()[1]+1; // +1 for the bias feature (which stays zero)
+            svm_.mean().assign(num_features-1, 0.);
+            svm_.std_dev().assign(num_features-1, 1.);
+            svm_dual_coordinate_descent(features, labels, num_features, svm_.options(),
+                                        svm_.alpha(), svm_.beta(), randengine_);
+        }
 
-            size_t const num_instances = features.shape()[0];
-            size_t const num_features = features.shape()[1]+1;
+    protected:
 
-            // If only one class was found in training, always predict this class.
-            if (distinct_labels_.size() == 1)
+        SVM & svm_;
+        RandEngine const & randengine_;
+
+    };
+
+
+
+    /// \brief Compute the decision values of the instances [begin, begin+n) with the folded weights of a TwoClassSVM.
+    ///
+    /// The outer loop runs over the features, so a (column-major) feature array is read contiguously
+    /// and the inner loop over the instances can be vectorized.
+    template <typename FEATURES>
+    struct TwoClassSVMDecisionKernel
+    {
+        static void apply(
+                FEATURES const & features,
+                std::vector<double> const & weights,
+                double const offset,
+                size_t const begin,
+                size_t const n,
+                double * values
+        ){
+            std::fill(values, values+n, offset);
+            for (size_t j = 0; j < weights.size(); ++j)
             {
-                for (size_t i = 0; i < num_instances; ++i)
+                double const w = weights[j];
+                if (w == 0)
+                    continue;
+                for (size_t i = 0; i < n; ++i)
                 {
-                    labels(i) = distinct_labels_[0];
+                    values[i] += features(begin+i, j) * w;
                 }
-                return;
             }
+        }
+    };
 
-            // If two classes were found in training, we must do the "real" SVM prediction.
-            auto normalizer = Normalizer(svm_.options().bias_value_, svm_.mean(), svm_.std_dev());
-            auto normalized_features = NormalizedType();
-            normalizer.apply_normalization(features, normalized_features);
-            for (size_t i = 0; i < num_instances; ++i)
+    /// \brief Compute the decision values of the instances [begin, begin+n) by gathering the weights of the non-zero features.
+    template <typename T>
+    struct TwoClassSVMDecisionKernel<SparseFeatureGetter<T> >
+    {
+        static void apply(
+                SparseFeatureGetter<T> const & features,
+                std::vector<double> const & weights,
+                double const offset,
+                size_t const begin,
+                size_t const n,
+                double * values
+        ){
+            for (size_t i = 0; i < n; ++i)
             {
-                double v = 0;
-                for (size_t j = 0; j < num_features; ++j)
+                double v = offset;
+                for (auto it = features.begin_instance_nonzero(begin+i); it != features.end_instance_nonzero(begin+i); ++it)
                 {
-                    v += normalized_features(i, j) * svm_.beta()(j);
+                    auto const j = (*it).first;
+                    auto const f = (*it).second;
+                    v += f * weights[j];
                 }
-                size_t const index = (v >= 0) ? 0 : 1; // if v >= 0 then we use label +1, which has index 0 in distinct_labels_, else we use the label with index 1
-                labels(i) = distinct_labels_[index];
+                values[i] = v;
             }
         }
-
-    protected:
-
-        SVM const & svm_;
-        std::vector<LabelType> const & distinct_labels_;
     };
 
-
-
-    template <typename SVM, typename T, typename LABELS>
-    class TwoClassSVMPredictFunctor<SVM, SparseFeatureGetter<T>, LABELS>
+    /// \brief Compute the decision values of the instances [begin, begin+n) by summing the weights of the non-zero binary features.
+    template <typename T>
+    struct TwoClassSVMDecisionKernel<BinarySparseFeatureGetter<T> >
     {
-    public:
-
-        typedef typename SVM::Options Options;
-        typedef typename SVM::FeatureType FeatureType;
-        typedef typename SVM::LabelType LabelType;
-        typedef SparseFeatureGetter<T> Features;
-        typedef LABELS Labels;
-        typedef NormalizeFunctor<Features, Features> Normalizer;
-
-        static_assert(std::is_convertible<typename Features::value_type, FeatureType>(),
-                      "TwoClassSVMTrainFunctor: Wrong feature type.");
-        static_assert(std::is_convertible<typename Labels::value_type, LabelType>(),
-                      "TwoClassSVMTrainFunctor: Wrong label type.");
-
-        TwoClassSVMPredictFunctor(
-                SVM const & svm,
-                std::vector<LabelType> const & distinct_labels
-        )   : svm_(svm),
-              distinct_labels_(distinct_labels)
-        {}
-
-        void operator()(
-                Features const & features,
-                Labels & labels
-        ) const {
-            vigra_precondition(distinct_labels_.size() == 1 || distinct_labels_.size() == 2,
-                               "TwoClassSVMPredictFunctor::operator(): Number of labels found in training must be 1 or 2.");
-            vigra_precondition(features.shape()[1]+1 == svm_.beta().size(),
-                               "TwoClassSVMPredictFunctor::operator(): Wrong number of features.");
-
-            size_t const num_instances = features.shape()[0];
-            size_t const num_features = features.shape()[1]+1;
-
-            // If only one class was found in training, always predict this class.
-            if (distinct_labels_.size() == 1)
+        static void apply(
+                BinarySparseFeatureGetter<T> const & features,
+                std::vector<double> const & weights,
+                double const offset,
+                size_t const begin,
+                size_t const n,
+                double * values
+        ){
+            for (size_t i = 0; i < n; ++i)
             {
-                for (size_t i = 0; i < num_instances; ++i)
+                double v = offset;
+                for (auto it = features.begin_instance_indices(begin+i); it != features.end_instance_indices(begin+i); ++it)
                 {
-                    labels(i) = distinct_labels_[0];
+                    v += weights[*it];
                 }
-                return;
+                values[i] = v;
             }
+        }
+    };
 
-            // If two classes were found in training, we must do the "real" SVM prediction.
-            auto normalizer = Normalizer(svm_.options().bias_value_, svm_.mean(), svm_.std_dev());
-            auto normalized_features = Features();
-            if (svm_.options().normalize_)
+    /// \brief Compute the decision values of all classes for the instances [begin, begin+n) with the folded weights of a MultiClassSVM.
+    ///
+    /// The weights are stored as num_classes x num_features matrix, so the weights of one feature are contiguous.
+    /// values[i*num_classes + k] is the decision value of instance begin+i for class k.
+    template <typename FEATURES>
+    struct MultiClassSVMDecisionKernel
+    {
+        static void apply(
+                FEATURES const & features,
+                MultiArray<2, double> const & weights,
+                std::vector<double> const & offsets,
+                size_t const begin,
+                size_t const n,
+                double * values
+        ){
+            size_t const num_classes = offsets.size();
+            for (size_t i = 0; i < n; ++i)
             {
-                normalizer.apply_normalization(features, normalized_features);
+                std::copy(offsets.begin(), offsets.end(), values + i*num_classes);
             }
-            else
+            size_t const num_features = weights.shape()[1];
+            for (size_t j = 0; j < num_features; ++j)
             {
-                normalized_features = Features(features);
+                double const * w = &weights(0, j);
+                for (size_t i = 0; i < n; ++i)
+                {
+                    double const f = features(begin+i, j);
+                    if (f == 0)
+                        continue;
+                    double * v = values + i*num_classes;
+                    for (size_t k = 0; k < num_classes; ++k)
+                    {
+                        v[k] += f * w[k];
+                    }
+                }
             }
-            for (size_t i = 0; i < num_instances; ++i)
+        }
+    };
+
+    /// \brief Compute the decision values of all classes for the instances [begin, begin+n) using only the non-zero features.
+    template <typename T>
+    struct MultiClassSVMDecisionKernel<SparseFeatureGetter<T> >
+    {
+        static void apply(
+                SparseFeatureGetter<T> const & features,
+                MultiArray<2, double> const & weights,
+                std::vector<double> const & offsets,
+                size_t const begin,
+                size_t const n,
+                double * values
+        ){
+            size_t const num_classes = offsets.size();
+            for (size_t i = 0; i < n; ++i)
             {
-                double v = 0;
-                for (auto it = normalized_features.begin_instance_nonzero(i); it != normalized_features.end_instance_nonzero(i); ++it)
+                double * v = values + i*num_classes;
+                std::copy(offsets.begin(), offsets.end(), v);
+                for (auto it = features.begin_instance_nonzero(begin+i); it != features.end_instance_nonzero(begin+i); ++it)
                 {
                     auto const j = (*it).first;
-                    auto const f = (*it).second;
-                    v += f * svm_.beta()(j);
+                    double const f = (*it).second;
+                    double const * w = &weights(0, j);
+                    for (size_t k = 0; k < num_classes; ++k)
+                    {
+                        v[k] += f * w[k];
+                    }
                 }
-                size_t index = (v >= 0) ? 0 : 1; // if v >= 0 then we use label +1, which has index 0 in distinct_labels_, else we use the label with index 1
-                labels(i) = distinct_labels_[index];
             }
         }
+    };
 
-    protected:
-
-        SVM const & svm_;
-        std::vector<LabelType> const & distinct_labels_;
+    /// \brief Compute the decision values of all classes for the instances [begin, begin+n) by summing the weights of the non-zero binary features.
+    template <typename T>
+    struct MultiClassSVMDecisionKernel<BinarySparseFeatureGetter<T> >
+    {
+        static void apply(
+                BinarySparseFeatureGetter<T> const & features,
+                MultiArray<2, double> const & weights,
+                std::vector<double> const & offsets,
+                size_t const begin,
+                size_t const n,
+                double * values
+        ){
+            size_t const num_classes = offsets.size();
+            for (size_t i = 0; i < n; ++i)
+            {
+                double * v = values + i*num_classes;
+                std::copy(offsets.begin(), offsets.end(), v);
+                for (auto it = features.begin_instance_indices(begin+i); it != features.end_instance_indices(begin+i); ++it)
+                {
+                    double const * w = &weights(0, *it);
+                    for (size_t k = 0; k < num_classes; ++k)
+                    {
+                        v[k] += w[k];
+                    }
+                }
+            }
+        }
     };
 
 
@@ -736,6 +1013,11 @@ namespace detail
 
 
 
+template <typename FEATURETYPE, typename LABELTYPE>
+class SVMPredictor;
+
+
+
 /// \brief Two class support vector machine using hinge loss and a quadratic regularizer (implemented with "dual coordinate descent" [Hsieh et al. 2008]).
 template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE = MersenneTwister>
 class TwoClassSVM
@@ -756,7 +1038,8 @@ public:
                 size_t const max_total_diffs = 0,
                 double const max_relative_diffs = 0.,
                 double const grad_tol = 0.0001,
-                size_t const max_t = std::numeric_limits<size_t>::max()
+                size_t const max_t = std::numeric_limits<size_t>::max(),
+                int const num_threads = 1
         )   : U_(U),
               bias_value_(bias_value),
               normalize_(normalize),
@@ -764,10 +1047,13 @@ public:
               max_total_diffs_(max_total_diffs),
               max_relative_diffs_(max_relative_diffs),
               grad_tol_(grad_tol),
-              max_t_(max_t)
+              max_t_(max_t),
+              num_threads_(num_threads)
         {
             vigra_precondition(0. <= max_relative_diffs_ && max_relative_diffs_ <= 1.,
                                "Options(): The relative number of differences must be in the interval [0, 1].");
+            vigra_precondition(num_threads_ == -1 || num_threads_ > 0,
+                               "Options(): num_threads must be -1 or greater than zero.");
         }
 
         // upper bound of the alpha values
@@ -790,6 +1076,10 @@ public:
 
         // maximum number of iterations
         size_t max_t_;
+
+        // number of threads for the dual coordinate descent (-1: use all cores), with more than one thread
+        // the alphas are updated concurrently, so the result depends on the scheduling
+        int num_threads_;
     };
 
     TwoClassSVM(
@@ -814,12 +1104,51 @@ public:
     /// \brief Predict with the SVM.
     /// \param features: the features
     /// \param labels[out]: the predicted labels
+    /// \param num_threads: number of threads (-1: use all cores)
     template <typename FEATURES, typename LABELS>
     void predict(
             FEATURES const & features,
-            LABELS & labels
+            LABELS & labels,
+            int num_threads = -1
     ) const;
 
+    /// \brief Compute the decision values of the SVM (a non-negative value gives the first label).
+    /// \param features: the features
+    /// \param values[out]: the decision values
+    /// \param num_threads: number of threads (-1: use all cores)
+    template <typename FEATURES>
+    void decision_values(
+            FEATURES const & features,
+            MultiArrayView<1, double> & values,
+            int num_threads = -1
+    ) const;
+
+    /// \brief Fold the feature normalization and the bias feature into the prediction weights and the offset.
+    /// \note This is done in train. Call it again if beta, mean or std_dev were changed manually.
+    void fold_normalization();
+
+    /// \brief Getter for the prediction weights (the decision value of x is dot(weights, x) + offset).
+    std::vector<double> const & weights() const
+    {
+        return weights_;
+    }
+
+    /// \brief Getter for the prediction offset.
+    double offset() const
+    {
+        return offset_;
+    }
+
+    /// \brief Return an immutable single instance predictor of the SVM.
+    SVMPredictor<FeatureType, LabelType> predictor() const
+    {
+        vigra_precondition(!distinct_labels_.empty(),
+                           "TwoClassSVM::predictor(): The SVM has not been trained.");
+        SVMPredictor<FeatureType, LabelType> p;
+        p.build(weights_, offset_, distinct_labels_);
+        return p;
+    }
+
     /// \brief Transform the labels to +1 and -1.
     /// \param labels_in: the labels that should be transformed
     /// \param labels_out[out]: the transformed labels
@@ -917,6 +1246,22 @@ protected:
 
     /// \brief The SVM options.
     Options const options_;
+
+    /// \brief The prediction weights (beta with the normalization folded in).
+    std::vector<double> weights_;
+
+    /// \brief The prediction offset (bias and normalization).
+    double offset_ = 0.;
+
+private:
+
+    /// \brief Compute the decision values of the instances in blocks and call f(begin, n, values) for each block, using multiple threads.
+    template <typename FEATURES, typename FUNCTOR>
+    void for_each_decision_block(
+            FEATURES const & features,
+            int num_threads,
+            FUNCTOR const & f
+    ) const;
 };
 
 template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
@@ -944,6 +1289,9 @@ void TwoClassSVM<FEATURETYPE, LABELTYPE, RANDENGINE>::train(
     if (distinct_labels_.size() == 1)
     {
         beta_.reshape(Shape1(num_features));
+        mean_.assign(num_features-1, 0.);
+        std_dev_.assign(num_features-1, 1.);
+        fold_normalization();
         return;
     }
 
@@ -956,18 +1304,102 @@ void TwoClassSVM<FEATURETYPE, LABELTYPE, RANDENGINE>::train(
     typedef detail::TwoClassSVMTrainFunctor<TwoClassSVM, FEATURES, NEWLABELS> TrainFunctor;
     TrainFunctor train_functor(*this, randengine_);
     train_functor(features, label_ids);
+    fold_normalization();
 }
 
 template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
 template <typename FEATURES, typename LABELS>
 void TwoClassSVM<FEATURETYPE, LABELTYPE, RANDENGINE>::predict(
         FEATURES const & features,
-        LABELS & labels
+        LABELS & labels,
+        int num_threads
+) const {
+    static_assert(std::is_convertible<LabelType, typename LABELS::value_type>(),
+                  "TwoClassSVM::predict(): Wrong label type.");
+    vigra_precondition(features.shape()[0] == labels.size(),
+                       "TwoClassSVM::predict(): Shape mismatch.");
+
+    // If v >= 0 then we use label +1, which has index 0 in distinct_labels_, else we use the label with index 1.
+    // If only one class was found in training, the weights are zero, so this class is always predicted.
+    for_each_decision_block(features, num_threads,
+            [this, & labels](size_t begin, size_t n, double const * values)
+            {
+                for (size_t i = 0; i < n; ++i)
+                {
+                    size_t const index = (values[i] >= 0) ? 0 : 1;
+                    labels(begin+i) = distinct_labels_[index];
+                }
+            }
+    );
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
+template <typename FEATURES>
+void TwoClassSVM<FEATURETYPE, LABELTYPE, RANDENGINE>::decision_values(
+        FEATURES const & features,
+        MultiArrayView<1, double> & values,
+        int num_threads
+) const {
+    vigra_precondition(features.shape()[0] == values.size(),
+                       "TwoClassSVM::decision_values(): Shape mismatch.");
+
+    for_each_decision_block(features, num_threads,
+            [& values](size_t begin, size_t n, double const * block_values)
+            {
+                for (size_t i = 0; i < n; ++i)
+                {
+                    values(begin+i) = block_values[i];
+                }
+            }
+    );
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
+void TwoClassSVM<FEATURETYPE, LABELTYPE, RANDENGINE>::fold_normalization()
+{
+    size_t const num_betas = beta_.size();
+    vigra_precondition(num_betas > 0 && mean_.size()+1 == num_betas && std_dev_.size()+1 == num_betas,
+                       "TwoClassSVM::fold_normalization(): The SVM has not been trained.");
+
+    // dot(beta, ((x-mean)/std_dev, bias)) = dot(beta/std_dev, x) + bias*beta_bias - dot(beta/std_dev, mean).
+    size_t const num_features = mean_.size();
+    weights_.resize(num_features);
+    offset_ = options_.bias_value_ * beta_(num_features);
+    for (size_t j = 0; j < num_features; ++j)
+    {
+        weights_[j] = beta_(j) / std_dev_[j];
+        offset_ -= weights_[j] * mean_[j];
+    }
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
+template <typename FEATURES, typename FUNCTOR>
+void TwoClassSVM<FEATURETYPE, LABELTYPE, RANDENGINE>::for_each_decision_block(
+        FEATURES const & features,
+        int num_threads,
+        FUNCTOR const & f
 ) const {
-    // Call the predict functor.
-    typedef detail::TwoClassSVMPredictFunctor<TwoClassSVM, FEATURES, LABELS> PredictFunctor;
-    PredictFunctor predict_functor(*this, distinct_labels_);
-    predict_functor(features, labels);
+    static_assert(std::is_convertible<typename FEATURES::value_type, FeatureType>(),
+                  "TwoClassSVM::predict(): Wrong feature type.");
+    vigra_precondition(distinct_labels_.size() == 1 || distinct_labels_.size() == 2,
+                       "TwoClassSVM::predict(): Number of labels found in training must be 1 or 2.");
+    vigra_precondition(static_cast<size_t>(features.shape()[1]) == weights_.size(),
+                       "TwoClassSVM::predict(): Wrong number of features.");
+
+    // Each block of instances is handled by one thread, the decision values of a block stay in the cache.
+    static constexpr size_t block_size = 256;
+    size_t const num_instances = features.shape()[0];
+    size_t const num_blocks = (num_instances + block_size - 1) / block_size;
+    detail::parallel_for(num_blocks, num_threads,
+            [this, & features, & f, num_instances](size_t b)
+            {
+                std::array<double, block_size> values;
+                size_t const begin = b * block_size;
+                size_t const n = std::min(block_size, num_instances - begin);
+                detail::TwoClassSVMDecisionKernel<FEATURES>::apply(features, weights_, offset_, begin, n, values.data());
+                f(begin, n, values.data());
+            }
+    );
 }
 
 template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
@@ -995,6 +1427,403 @@ void TwoClassSVM<FEATURETYPE, LABELTYPE, RANDENGINE>::transform_external_labels(
 
 
 
+/// \brief Multiclass SVM that solves one two class problem per class (one-vs-rest) with the dual coordinate descent of TwoClassSVM.
+///
+/// The features are normalized once and the normalized (or sparse) features are shared by the binary problems,
+/// which are trained concurrently. The folded weights of all classes are stored in one num_classes x num_features
+/// matrix, so the decision values of a block of instances are computed in a single pass over the features.
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE = MersenneTwister>
+class MultiClassSVM
+{
+public:
+
+    typedef FEATURETYPE FeatureType;
+    typedef LABELTYPE LabelType;
+    typedef RANDENGINE RandEngine;
+    typedef typename TwoClassSVM<FeatureType, LabelType, RandEngine>::Options Options;
+
+    MultiClassSVM(
+            Options const & options = Options(),
+            RandEngine const & randengine = RandEngine::global()
+    )   : options_(options),
+          randengine_(randengine)
+    {}
+
+    /// \brief Train the SVM.
+    /// \param features: the features
+    /// \param labels: the labels
+    /// \param num_threads: number of threads for the binary problems (-1: use all cores)
+    template <typename FEATURES, typename LABELS>
+    void train(
+            FEATURES const & features,
+            LABELS const & labels,
+            int num_threads = -1
+    );
+
+    /// \brief Predict the class with the maximum decision value.
+    /// \param features: the features
+    /// \param labels[out]: the predicted labels
+    /// \param num_threads: number of threads (-1: use all cores)
+    template <typename FEATURES, typename LABELS>
+    void predict(
+            FEATURES const & features,
+            LABELS & labels,
+            int num_threads = -1
+    ) const;
+
+    /// \brief Compute the decision values of each class.
+    /// \param features: the features
+    /// \param values[out]: num_instances x num_classes array with the decision values
+    /// \param num_threads: number of threads (-1: use all cores)
+    template <typename FEATURES>
+    void decision_values(
+            FEATURES const & features,
+            MultiArrayView<2, double> & values,
+            int num_threads = -1
+    ) const;
+
+    /// \brief Getter for the num_classes x num_features matrix with the prediction weights.
+    MultiArray<2, double> const & weights() const
+    {
+        return weights_;
+    }
+
+    /// \brief Getter for the prediction offset of each class.
+    std::vector<double> const & offsets() const
+    {
+        return offsets_;
+    }
+
+    /// \brief Getter for the num_classes x (num_features+1) matrix with the beta vectors of the binary problems.
+    MultiArray<2, double> const & beta() const
+    {
+        return beta_;
+    }
+
+    std::vector<double> const & mean() const
+    {
+        return mean_;
+    }
+
+    std::vector<double> const & std_dev() const
+    {
+        return std_dev_;
+    }
+
+    Options const & options() const
+    {
+        return options_;
+    }
+
+    std::vector<LabelType> const & distinct_labels() const
+    {
+        return distinct_labels_;
+    }
+
+    /// \brief Return the number of classes.
+    size_t num_classes() const
+    {
+        return distinct_labels_.size();
+    }
+
+protected:
+
+    /// \brief Fold the feature normalization and the bias feature into the prediction weights and the offsets.
+    void fold_normalization();
+
+    /// \brief The SVM options.
+    Options const options_;
+
+    /// \brief The random engine.
+    RandEngine const & randengine_;
+
+    /// \brief The labels that were found in training.
+    std::vector<LabelType> distinct_labels_;
+
+    /// \brief The beta vectors that are computed in training (one row per class).
+    MultiArray<2, double> beta_;
+
+    /// \brief The vector with the mean of each feature dimension of the training data.
+    std::vector<double> mean_;
+
+    /// \brief The vector with the standard deviation of each feature dimension of the training data.
+    std::vector<double> std_dev_;
+
+    /// \brief The prediction weights (beta with the normalization folded in, one row per class).
+    MultiArray<2, double> weights_;
+
+    /// \brief The prediction offsets (bias and normalization).
+    std::vector<double> offsets_;
+
+private:
+
+    /// \brief Compute the decision values of the instances in blocks and call f(begin, n, values) for each block, using multiple threads.
+    template <typename FEATURES, typename FUNCTOR>
+    void for_each_decision_block(
+            FEATURES const & features,
+            int num_threads,
+            FUNCTOR const & f
+    ) const;
+};
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
+template <typename FEATURES, typename LABELS>
+void MultiClassSVM<FEATURETYPE, LABELTYPE, RANDENGINE>::train(
+        FEATURES const & features,
+        LABELS const & labels,
+        int num_threads
+){
+    static_assert(std::is_convertible<typename FEATURES::value_type, FeatureType>(),
+                  "MultiClassSVM::train(): Wrong feature type.");
+    static_assert(std::is_convertible<typename LABELS::value_type, LabelType>(),
+                  "MultiClassSVM::train(): Wrong label type.");
+
+    size_t const num_instances = features.shape()[0];
+    size_t const num_features = features.shape()[1]+1; // +1 for the bias feature
+    vigra_precondition(static_cast<size_t>(labels.size()) == num_instances,
+                       "MultiClassSVM::train(): Shape mismatch.");
+
+    // Find the distinct labels and the class of each instance.
+    auto dlabels = std::set<LabelType>(labels.begin(), labels.end());
+    vigra_precondition(!dlabels.empty(),
+                       "MultiClassSVM::train(): No labels found.");
+    distinct_labels_.assign(dlabels.begin(), dlabels.end());
+    size_t const num_classes = distinct_labels_.size();
+    std::map<LabelType, size_t> label_ids;
+    for (size_t k = 0; k < num_classes; ++k)
+    {
+        label_ids[distinct_labels_[k]] = k;
+    }
+    std::vector<size_t> instance_classes(num_instances);
+    for (size_t i = 0; i < num_instances; ++i)
+    {
+        instance_classes[i] = label_ids[labels(i)];
+    }
+
+    // Normalize the features once, all binary problems only read them.
+    typename detail::SVMNormalizedFeatures<FEATURES>::type normalized_features;
+    detail::normalize_svm_features(features, options_, normalized_features, mean_, std_dev_);
+
+    // Draw the seeds of the binary problems, so the result does not depend on the number of threads.
+    UniformIntRandomFunctor<RANDENGINE> rand(randengine_);
+    std::vector<size_t> seeds(num_classes);
+    for (auto & seed : seeds)
+    {
+        seed = rand();
+    }
+
+    // Train class k against the rest. If there is only one class, the weights stay zero.
+    beta_.reshape(Shape2(num_classes, num_features), 0.);
+    detail::parallel_for((num_classes > 1) ? num_classes : 0, num_threads,
+            [this, & normalized_features, & instance_classes, & seeds, num_instances, num_features](size_t k)
+            {
+                MultiArray<1, int> binary_labels(num_instances);
+                for (size_t i = 0; i < num_instances; ++i)
+                {
+                    binary_labels(i) = (instance_classes[i] == k) ? 1 : -1;
+                }
+                RANDENGINE const randengine(seeds[k]);
+                MultiArray<1, double> alpha;
+                MultiArray<1, double> beta;
+                detail::svm_dual_coordinate_descent(normalized_features, binary_labels, num_features, options_,
+                                                    alpha, beta, randengine);
+                for (size_t j = 0; j < num_features; ++j)
+                {
+                    beta_(k, j) = beta(j);
+                }
+            }
+    );
+    fold_normalization();
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
+template <typename FEATURES, typename LABELS>
+void MultiClassSVM<FEATURETYPE, LABELTYPE, RANDENGINE>::predict(
+        FEATURES const & features,
+        LABELS & labels,
+        int num_threads
+) const {
+    static_assert(std::is_convertible<LabelType, typename LABELS::value_type>(),
+                  "MultiClassSVM::predict(): Wrong label type.");
+    vigra_precondition(features.shape()[0] == labels.size(),
+                       "MultiClassSVM::predict(): Shape mismatch.");
+
+    // Find the class with the maximum decision value (the first one on ties).
+    size_t const num_classes = distinct_labels_.size();
+    for_each_decision_block(features, num_threads,
+            [this, & labels, num_classes](size_t begin, size_t n, double const * values)
+            {
+                for (size_t i = 0; i < n; ++i)
+                {
+                    double const * v = values + i*num_classes;
+                    labels(begin+i) = distinct_labels_[std::max_element(v, v+num_classes) - v];
+                }
+            }
+    );
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
+template <typename FEATURES>
+void MultiClassSVM<FEATURETYPE, LABELTYPE, RANDENGINE>::decision_values(
+        FEATURES const & features,
+        MultiArrayView<2, double> & values,
+        int num_threads
+) const {
+    size_t const num_classes = distinct_labels_.size();
+    vigra_precondition(values.shape()[0] == features.shape()[0] && static_cast<size_t>(values.shape()[1]) == num_classes,
+                       "MultiClassSVM::decision_values(): Shape mismatch.");
+
+    for_each_decision_block(features, num_threads,
+            [& values, num_classes](size_t begin, size_t n, double const * block_values)
+            {
+                for (size_t i = 0; i < n; ++i)
+                {
+                    for (size_t k = 0; k < num_classes; ++k)
+                    {
+                        values(begin+i, k) = block_values[i*num_classes + k];
+                    }
+                }
+            }
+    );
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
+void MultiClassSVM<FEATURETYPE, LABELTYPE, RANDENGINE>::fold_normalization()
+{
+    // The same as TwoClassSVM::fold_normalization for each row of beta.
+    size_t const num_classes = beta_.shape()[0];
+    size_t const num_features = mean_.size();
+    weights_.reshape(Shape2(num_classes, num_features));
+    offsets_.resize(num_classes);
+    for (size_t k = 0; k < num_classes; ++k)
+    {
+        offsets_[k] = options_.bias_value_ * beta_(k, num_features);
+        for (size_t j = 0; j < num_features; ++j)
+        {
+            weights_(k, j) = beta_(k, j) / std_dev_[j];
+            offsets_[k] -= weights_(k, j) * mean_[j];
+        }
+    }
+}
+
+template <typename FEATURETYPE, typename LABELTYPE, typename RANDENGINE>
+template <typename FEATURES, typename FUNCTOR>
+void MultiClassSVM<FEATURETYPE, LABELTYPE, RANDENGINE>::for_each_decision_block(
+        FEATURES const & features,
+        int num_threads,
+        FUNCTOR const & f
+) const {
+    static_assert(std::is_convertible<typename FEATURES::value_type, FeatureType>(),
+                  "MultiClassSVM::predict(): Wrong feature type.");
+    vigra_precondition(!distinct_labels_.empty(),
+                       "MultiClassSVM::predict(): The SVM has not been trained.");
+    vigra_precondition(features.shape()[1] == weights_.shape()[1],
+                       "MultiClassSVM::predict(): Wrong number of features.");
+
+    // Each block of instances is handled by one thread. The buffer of the decision values is kept per thread,
+    // so it is allocated once and not for every block.
+    static constexpr size_t block_size = 256;
+    size_t const num_instances = features.shape()[0];
+    size_t const num_blocks = (num_instances + block_size - 1) / block_size;
+    detail::parallel_for(num_blocks, num_threads,
+            [this, & features, & f, num_instances](size_t b)
+            {
+                static thread_local std::vector<double> values;
+                values.resize(block_size * offsets_.size());
+                size_t const begin = b * block_size;
+                size_t const n = std::min(block_size, num_instances - begin);
+                detail::MultiClassSVMDecisionKernel<FEATURES>::apply(features, weights_, offsets_, begin, n, values.data());
+                f(begin, n, values.data());
+            }
+    );
+}
+
+
+
+/// \brief Immutable single instance predictor of a two class SVM.
+///
+/// All methods are const and do not allocate memory, so a predictor can be shared by many threads.
+/// An instance is given as a pointer to its num_features() contiguous feature values.
+template <typename FEATURETYPE, typename LABELTYPE>
+class SVMPredictor
+{
+public:
+
+    typedef FEATURETYPE FeatureType;
+    typedef LABELTYPE LabelType;
+
+    /// \brief Build the predictor from the folded weights, the offset and the distinct labels of the SVM.
+    void build(
+            std::vector<double> const & weights,
+            double offset,
+            std::vector<LabelType> const & distinct_labels
+    ){
+        vigra_precondition(distinct_labels.size() == 1 || distinct_labels.size() == 2,
+                           "SVMPredictor::build(): Number of labels must be 1 or 2.");
+        weights_ = weights;
+        offset_ = offset;
+
+        // If only one class was found in training, it is predicted for both signs.
+        labels_[0] = distinct_labels.front();
+        labels_[1] = distinct_labels.back();
+    }
+
+    /// \brief Return the decision value of a single instance (a non-negative value gives the first label).
+    double decision_value_one(FeatureType const * x) const
+    {
+        double v = offset_;
+        for (size_t j = 0; j < weights_.size(); ++j)
+        {
+            v += weights_[j] * x[j];
+        }
+        return v;
+    }
+
+    /// \brief Predict the label of a single instance.
+    LabelType predict_one(FeatureType const * x) const
+    {
+        return labels_[(decision_value_one(x) >= 0) ? 0 : 1];
+    }
+
+    /// \brief Compute the decision values of n instances that are stored row by row in x.
+    void decision_values(FeatureType const * x, size_t n, double * values) const
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            values[i] = decision_value_one(x + i*weights_.size());
+        }
+    }
+
+    /// \brief Predict the labels of n instances that are stored row by row in x.
+    void predict(FeatureType const * x, size_t n, LabelType * labels) const
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            labels[i] = predict_one(x + i*weights_.size());
+        }
+    }
+
+    /// \brief Return the number of features of an instance.
+    size_t num_features() const
+    {
+        return weights_.size();
+    }
+
+protected:
+
+    /// \brief The prediction weights.
+    std::vector<double> weights_;
+
+    /// \brief The prediction offset.
+    double offset_ = 0.;
+
+    /// \brief The labels for non-negative and negative decision values.
+    std::array<LabelType, 2> labels_;
+
+};
+
+
+
 /// \brief Divide and Conquer SVM [Hsieh et al. 2014].
 template <typename SVM>
 class ClusteredTwoClassSVM
@@ -1035,10 +1864,12 @@ public:
     /// \brief Predict with the SVM.
     /// \param features: the features
     /// \param labels[out]: the predicted labels
+    /// \param num_threads: number of threads (-1: use all cores)
     template <typename FEATURES, typename LABELS>
     void predict(
             FEATURES const & features,
-            LABELS & labels
+            LABELS & labels,
+            int num_threads = -1
     ) const;
 
     void set_alpha(MultiArrayView<1, double> const & new_alpha)
@@ -1189,9 +2020,10 @@ template <typename SVM>
 template <typename FEATURES, typename LABELS>
 void ClusteredTwoClassSVM<SVM>::predict(
         FEATURES const & features,
-        LABELS & labels
+        LABELS & labels,
+        int num_threads
 ) const {
-    final_svm_.predict(features, labels);
+    final_svm_.predict(features, labels, num_threads);
 }
 
 template <typename SVM>
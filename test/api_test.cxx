@@ -146,6 +146,43 @@ void test_binary_tree()
                      tree.neighbor(nf) == lemon::INVALID, "Error in BinaryTree::neighbor().");
     }
 
+    // Test compact.
+    {
+        Tree t;
+        std::vector<Node> n;
+        for (size_t i = 0; i < 7; ++i)
+            n.push_back(t.addNode());
+        t.addArc(n[6], n[3]);
+        t.addArc(n[6], n[1]);
+        t.addArc(n[3], n[0]);
+        t.addArc(n[3], n[5]);
+        t.addArc(n[1], n[2]);
+        t.addArc(n[1], n[4]);
+        t.erase(n[0]);
+        t.erase(n[5]);
+        Tree::NodeMap<int> map;
+        for (int i : {1, 2, 3, 4, 6})
+            map[n[i]] = i;
+
+        // The nodes are renumbered breadth-first from the root.
+        std::vector<Tree::index_type> const ids = t.compact();
+        std::vector<Tree::index_type> const expected {-1, 2, 3, 1, 4, -1, 0};
+        vigra_assert(ids == expected, "Error in BinaryTree::compact().");
+        vigra_assert(t.numNodes() == 5 && t.numArcs() == 4 && t.maxNodeId() == 4, "Error in BinaryTree::compact().");
+        vigra_assert(t.getRoot() == Node(0) && t.getChild(Node(0), 0) == Node(1) && t.getChild(Node(0), 1) == Node(2) &&
+                     t.getChild(Node(2), 0) == Node(3) && t.getChild(Node(2), 1) == Node(4) && t.getParent(Node(4)) == Node(2),
+                     "Error in BinaryTree::compact().");
+        vigra_assert(t.numLeaves() == 3 && t.getLeafNode(0) == Node(1) && t.getLeafIndex(Node(4)) == 2,
+                     "Error in BinaryTree::compact().");
+
+        remap_node_map(map, ids);
+        vigra_assert(map.at(Node(0)) == 6 && map.at(Node(1)) == 3 && map.at(Node(2)) == 1 &&
+                     map.at(Node(3)) == 2 && map.at(Node(4)) == 4, "Error in remap_node_map().");
+
+        // The free list is empty.
+        vigra_assert(t.addNode() == Node(5), "Error in BinaryTree::compact().");
+    }
+
     std::cout << "test_binary_tree(): Success!" << std::endl;
 }
 
@@ -2,8 +2,11 @@
 #include <vector>
 #include <utility>
 #include <algorithm>
+#include <tuple>
+#include <numeric>
 
 #include <vigra/dagraph.hxx>
+#include <vigra/dagraph_algorithms.hxx>
 
 
 
@@ -22,42 +25,42 @@ bool equal_after_sort(CONTAINER const & v0, CONTAINER const & v1)
     return true;
 }
 
-void test_dagraph0()
-{
+/// \brief Test the query functions and the iterators of a graph with the arcs e0 = (a, b), e1 = (b, c), e2 = (b, d) and e3 = (e, d).
+template <typename GRAPH>
+void test_graph_queries(
+        GRAPH const & g,
+        typename GRAPH::Node const & a,
+        typename GRAPH::Node const & b,
+        typename GRAPH::Node const & c,
+        typename GRAPH::Node const & d,
+        typename GRAPH::Node const & e,
+        typename GRAPH::Arc const & e0,
+        typename GRAPH::Arc const & e1,
+        typename GRAPH::Arc const & e2,
+        typename GRAPH::Arc const & e3
+){
     using namespace vigra;
 
-    typedef DAGraph0 Graph;
-    typedef Graph::Node Node;
-    typedef Graph::Arc Arc;
-    typedef Graph::NodeIt NodeIt;
-    typedef Graph::RootNodeIt RootNodeIt;
-    typedef Graph::LeafNodeIt LeafNodeIt;
-    typedef Graph::ArcIt ArcIt;
-    typedef Graph::OutArcIt OutArcIt;
-    typedef Graph::InArcIt InArcIt;
-    typedef Graph::ParentIt ParentIt;
-    typedef Graph::ChildIt ChildIt;
-
-    // Create the graph.
-    Graph g;
-    Node a = g.addNode();
-    Node b = g.addNode();
-    Node c = g.addNode();
-    Node d = g.addNode();
-    Node e = g.addNode();
-    Arc e0 = g.addArc(a, b);
-    Arc e1 = g.addArc(b, c);
-    Arc e2 = g.addArc(b, d);
-    Arc e3 = g.addArc(e, d);
+    typedef GRAPH Graph;
+    typedef typename Graph::Node Node;
+    typedef typename Graph::Arc Arc;
+    typedef typename Graph::NodeIt NodeIt;
+    typedef typename Graph::RootNodeIt RootNodeIt;
+    typedef typename Graph::LeafNodeIt LeafNodeIt;
+    typedef typename Graph::ArcIt ArcIt;
+    typedef typename Graph::OutArcIt OutArcIt;
+    typedef typename Graph::InArcIt InArcIt;
+    typedef typename Graph::ParentIt ParentIt;
+    typedef typename Graph::ChildIt ChildIt;
 
     // Test the graph functions maxNodeId, maxArcId, source and target.
     {
-        vigra_assert(g.maxNodeId() == 4, "Error in DAGraph0::maxNodeId().");
-        vigra_assert(g.maxArcId() == 3, "Error in DAGraph0::maxArcId().");
+        vigra_assert(g.maxNodeId() == 4, "Error in maxNodeId().");
+        vigra_assert(g.maxArcId() == 3, "Error in maxArcId().");
         vigra_assert(g.source(e0) == a && g.source(e1) == b && g.source(e2) == b && g.source(e3) == e,
-                     "Error in DAGraph0::source().");
+                     "Error in source().");
         vigra_assert(g.target(e0) == b && g.target(e1) == c && g.target(e2) == d && g.target(e3) == d,
-                     "Error in DAGraph0::target().");
+                     "Error in target().");
     }
 
     // Check that the node iterator walks over all nodes.
@@ -185,6 +188,31 @@ void test_dagraph0()
         g.child(tmp);
         vigra_assert(tmp == d, "Error in child().");
     }
+}
+
+void test_dagraph0()
+{
+    using namespace vigra;
+
+    typedef DAGraph0 Graph;
+    typedef Graph::Node Node;
+    typedef Graph::Arc Arc;
+    typedef Graph::NodeIt NodeIt;
+    typedef Graph::ArcIt ArcIt;
+
+    // Create the graph.
+    Graph g;
+    Node a = g.addNode();
+    Node b = g.addNode();
+    Node c = g.addNode();
+    Node d = g.addNode();
+    Node e = g.addNode();
+    Arc e0 = g.addArc(a, b);
+    Arc e1 = g.addArc(b, c);
+    Arc e2 = g.addArc(b, d);
+    Arc e3 = g.addArc(e, d);
+
+    test_graph_queries(g, a, b, c, d, e, e0, e1, e2, e3);
 
     // Test the erase function for nodes.
     {
@@ -219,25 +247,99 @@ void test_dagraph0()
             iter_arcs.push_back(Arc(*it));
         vigra_assert(equal_after_sort(arcs, iter_arcs), "Error in erase(Arc).");
 
+        // The target of the erased arc is a new root node.
+        std::vector<Node> roots {a, b, e};
+        std::vector<Node> iter_roots;
+        for (Graph::RootNodeIt it(g); it != lemon::INVALID; ++it)
+            iter_roots.push_back(Node(*it));
+        vigra_assert(equal_after_sort(roots, iter_roots), "Error in erase(Arc).");
+
         // Re-add the arc for the other tests.
         e0 = g.addArc(a, b);
    }
 
+    // Check that the root and leaf nodes were updated during the changes.
+    test_graph_queries(g, a, b, c, d, e, e0, e1, e2, e3);
+
     std::cout << "test_dagraph0(): Success!" << std::endl;
 }
 
-void test_forest1()
+void test_static_dagraph0()
 {
     using namespace vigra;
 
-    typedef DAGraph0 Graph;
-    typedef Forest1<Graph> Forest;
-    typedef Forest::Node Node;
-    typedef Forest::Arc Arc;
-    typedef Forest::NodeIt NodeIt;
-    typedef Forest::ArcIt ArcIt;
-    typedef Forest::RootNodeIt RootNodeIt;
-    typedef Forest::LeafNodeIt LeafNodeIt;
+    typedef StaticDAGraph0 Graph;
+    typedef Graph::Node Node;
+    typedef Graph::Arc Arc;
+    typedef Graph::NodeIt NodeIt;
+    typedef Graph::ChildIt ChildIt;
+
+    // Test the snapshot of a DAGraph0.
+    {
+        DAGraph0 gr;
+        Node a = gr.addNode();
+        Node b = gr.addNode();
+        Node c = gr.addNode();
+        Node d = gr.addNode();
+        Node e = gr.addNode();
+        Arc e0 = gr.addArc(a, b);
+        Arc e1 = gr.addArc(b, c);
+        Arc e2 = gr.addArc(b, d);
+        Arc e3 = gr.addArc(e, d);
+
+        Graph const g = gr.freeze();
+        vigra_assert(g.numNodes() == 5 && g.numArcs() == 4, "Error in StaticDAGraph0(DAGraph0).");
+        test_graph_queries(g, a, b, c, d, e, e0, e1, e2, e3);
+
+        // The children are a contiguous range in the same order as in the original graph.
+        std::vector<Node> children;
+        for (DAGraph0::ChildIt it(gr, b); it != lemon::INVALID; ++it)
+            children.push_back(Node(*it));
+        vigra_assert(std::equal(children.begin(), children.end(), g.children_begin(b)) &&
+                     g.children_end(b) - g.children_begin(b) == 2, "Error in StaticDAGraph0::children_begin().");
+        std::vector<Node> iter_children;
+        for (ChildIt it(g, b); it != lemon::INVALID; ++it)
+            iter_children.push_back(Node(*it));
+        vigra_assert(children == iter_children, "Error in StaticDAGraph0::ChildIt.");
+
+        // Erased nodes and arcs are not part of the snapshot, the ids of the others are kept.
+        gr.erase(c);
+        Graph const g2 = gr.freeze();
+        vigra_assert(!g2.valid(c) && !g2.valid(e1) && g2.valid(d) && g2.valid(e2), "Error in StaticDAGraph0(DAGraph0) after erase.");
+        std::vector<Node> nodes {a, b, d, e};
+        std::vector<Node> iter_nodes;
+        for (NodeIt it(g2); it != lemon::INVALID; ++it)
+            iter_nodes.push_back(Node(*it));
+        vigra_assert(equal_after_sort(nodes, iter_nodes), "Error in StaticDAGraph0(DAGraph0) after erase.");
+        vigra_assert(g2.outDegree(b) == 1 && g2.isLeafNode(d) && g2.numArcs() == 3, "Error in StaticDAGraph0(DAGraph0) after erase.");
+    }
+
+    // Test the bulk construction from an arc list.
+    {
+        std::vector<std::pair<Graph::index_type, Graph::index_type> > arcs {{0, 1}, {1, 2}, {1, 3}, {4, 3}};
+        Graph const g(5, arcs);
+        test_graph_queries(g, Node(0), Node(1), Node(2), Node(3), Node(4), Arc(0), Arc(1), Arc(2), Arc(3));
+        vigra_assert(g.children_end(Node(1)) - g.children_begin(Node(1)) == 2 &&
+                     g.children_begin(Node(1))[0] == Node(2) && g.children_begin(Node(1))[1] == Node(3),
+                     "Error in StaticDAGraph0(): The outgoing arcs must keep the order of the arc list.");
+    }
+
+    std::cout << "test_static_dagraph0(): Success!" << std::endl;
+}
+
+template <typename FOREST>
+void test_forest1_type()
+{
+    using namespace vigra;
+
+    typedef FOREST Forest;
+    typedef typename Forest::Parent Graph;
+    typedef typename Forest::Node Node;
+    typedef typename Forest::Arc Arc;
+    typedef typename Forest::NodeIt NodeIt;
+    typedef typename Forest::ArcIt ArcIt;
+    typedef typename Forest::RootNodeIt RootNodeIt;
+    typedef typename Forest::LeafNodeIt LeafNodeIt;
 
     Forest g;
     Node a = g.addNode();
@@ -371,12 +473,414 @@ void test_forest1()
             iter_leaves.push_back(Node(*it));
         vigra_assert(equal_after_sort(leaves, iter_leaves), "Error in constructor from graph.");
     }
+}
+
+void test_forest1()
+{
+    using namespace vigra;
+
+    // DAGraph0 maintains the root and leaf nodes itself, the second forest keeps its own sets.
+    test_forest1_type<Forest1<DAGraph0> >();
+    test_forest1_type<Forest1<DAGraph0, false> >();
+    static_assert(sizeof(Forest1<DAGraph0>) == sizeof(DAGraph0), "Forest1 must use the sets of the graph.");
 
     std::cout << "test_forest1(): Success!" << std::endl;
 }
 
+/// \brief Check the topological algorithms on the given graph, which has the nodes 0, ..., num_nodes-1.
+template <typename GRAPH>
+void test_topological_graph(GRAPH const & g, size_t const num_nodes)
+{
+    using namespace vigra;
+
+    typedef typename GRAPH::Node Node;
+    typedef typename GRAPH::template NodeMap<size_t> SizeMap;
+
+    // Each node must come after its parents.
+    std::vector<Node> const order = topological_sort(g);
+    vigra_assert(order.size() == num_nodes, "Error in topological_sort().");
+    std::vector<size_t> position(num_nodes);
+    for (size_t i = 0; i < order.size(); ++i)
+        position[order[i].id()] = i;
+    for (typename GRAPH::ArcIt it(g); it != lemon::INVALID; ++it)
+        vigra_assert(position[g.source(*it).id()] < position[g.target(*it).id()], "Error in topological_sort().");
+
+    // The levels are the lengths of the longest paths from a root node.
+    SizeMap levels;
+    size_t const num_levels = topological_levels(g, levels);
+    size_t max_level = 0;
+    for (Node const & n : order)
+    {
+        size_t expected = 0;
+        for (typename GRAPH::ParentIt it(g, n); it != lemon::INVALID; ++it)
+            expected = std::max(expected, levels.at(Node(*it))+1);
+        vigra_assert(levels.at(n) == expected, "Error in topological_levels().");
+        max_level = std::max(max_level, expected);
+    }
+    vigra_assert(num_levels == max_level+1, "Error in topological_levels().");
+
+    // Count the paths from the root nodes to each node in parallel and compare with the serial result.
+    SizeMap serial_paths;
+    for (Node const & n : order)
+    {
+        size_t count = g.isRootNode(n) ? 1 : 0;
+        for (typename GRAPH::ParentIt it(g, n); it != lemon::INVALID; ++it)
+            count += serial_paths.at(Node(*it));
+        serial_paths[n] = count;
+    }
+    for (int num_threads : {1, 4})
+    {
+        SizeMap paths;
+        parallel_topological_evaluate(g, paths,
+                [& g](Node const & n, SizeMap const & results)
+                {
+                    size_t count = g.isRootNode(n) ? 1 : 0;
+                    for (typename GRAPH::ParentIt it(g, n); it != lemon::INVALID; ++it)
+                        count += results.at(Node(*it));
+                    return count;
+                },
+                num_threads
+        );
+        for (Node const & n : order)
+            vigra_assert(paths.at(n) == serial_paths.at(n), "Error in parallel_topological_evaluate().");
+    }
+}
+
+void test_topological()
+{
+    using namespace vigra;
+
+    typedef DAGraph0 Graph;
+    typedef Graph::Node Node;
+
+    // Create a random DAG, where arcs always point from a node with smaller index to one with larger index.
+    size_t const num_nodes = 300;
+    std::vector<std::pair<Graph::index_type, Graph::index_type> > arcs;
+    size_t r = 1;
+    for (size_t j = 1; j < num_nodes; ++j)
+    {
+        for (size_t k = 0; k < 3; ++k)
+        {
+            r = (r * 1103515245 + 12345) % 2147483648;
+            if (r % 4 != 0)
+                arcs.push_back({(r/4) % j, j});
+        }
+    }
+    std::sort(arcs.begin(), arcs.end());
+    arcs.erase(std::unique(arcs.begin(), arcs.end()), arcs.end());
+
+    Graph g;
+    for (size_t i = 0; i < num_nodes; ++i)
+        g.addNode();
+    for (auto const & a : arcs)
+        g.addArc(Node(a.first), Node(a.second));
+
+    test_topological_graph(g, num_nodes);
+    test_topological_graph(g.freeze(), num_nodes);
+
+    // Exceptions in the functor are passed to the caller.
+    bool thrown = false;
+    try
+    {
+        parallel_topological_for_each(g, [](Node const & n) { if (n.id() == 100) throw std::runtime_error("test"); }, 4);
+    }
+    catch (std::runtime_error const &)
+    {
+        thrown = true;
+    }
+    vigra_assert(thrown, "Error in parallel_topological_for_each(): The exception was not passed.");
+
+    // A cycle is detected.
+    Graph c;
+    Node const c0 = c.addNode();
+    Node const c1 = c.addNode();
+    Node const c2 = c.addNode();
+    c.addArc(c0, c1);
+    c.addArc(c1, c2);
+    c.addArc(c2, c1);
+    thrown = false;
+    try
+    {
+        parallel_topological_for_each(c, [](Node const &) {}, 2);
+    }
+    catch (PreconditionViolation const &)
+    {
+        thrown = true;
+    }
+    vigra_assert(thrown, "Error in parallel_topological_for_each(): The cycle was not detected.");
+
+    std::cout << "test_topological(): Success!" << std::endl;
+}
+
+/// \brief Check that the compacted graph has the same structure as the original one, using the node labels old_id.
+template <typename GRAPH>
+void test_compact_graph(GRAPH & g)
+{
+    using namespace vigra;
+
+    typedef typename GRAPH::Node Node;
+    typedef typename GRAPH::NodeIt NodeIt;
+    typedef typename GRAPH::ArcIt ArcIt;
+    typedef typename GRAPH::OutArcIt OutArcIt;
+    typedef typename GRAPH::RootNodeIt RootNodeIt;
+    typedef typename GRAPH::LeafNodeIt LeafNodeIt;
+
+    // Label each node with its old id and collect the structure.
+    typename GRAPH::template NodeMap<int> old_id;
+    size_t num_nodes = 0;
+    for (NodeIt it(g); it != lemon::INVALID; ++it)
+    {
+        old_id[Node(*it)] = g.id(Node(*it));
+        ++num_nodes;
+    }
+    auto structure = [& g, & old_id]()
+    {
+        std::vector<std::pair<int, int> > arcs;
+        for (ArcIt it(g); it != lemon::INVALID; ++it)
+            arcs.push_back(std::make_pair(old_id.at(g.source(*it)), old_id.at(g.target(*it))));
+        std::vector<int> roots;
+        for (RootNodeIt it(g); it != lemon::INVALID; ++it)
+            roots.push_back(old_id.at(Node(*it)));
+        std::vector<int> leaves;
+        for (LeafNodeIt it(g); it != lemon::INVALID; ++it)
+            leaves.push_back(old_id.at(Node(*it)));
+        std::sort(arcs.begin(), arcs.end());
+        std::sort(roots.begin(), roots.end());
+        std::sort(leaves.begin(), leaves.end());
+        return std::make_tuple(arcs, roots, leaves);
+    };
+    auto const old_structure = structure();
+    size_t const num_arcs = std::get<0>(old_structure).size();
+
+    // Compact the graph and relabel the nodes.
+    std::vector<int> arc_ids;
+    std::vector<int> const node_ids = g.compact(arc_ids);
+    remap_node_map(old_id, node_ids);
+    vigra_assert(g.maxNodeId()+1 == static_cast<int>(num_nodes) && g.maxArcId()+1 == static_cast<int>(num_arcs),
+                 "Error in DAGraph0::compact(): The ids have holes.");
+    vigra_assert(structure() == old_structure, "Error in DAGraph0::compact(): The structure changed.");
+    for (NodeIt it(g); it != lemon::INVALID; ++it)
+    {
+        Node const node(*it);
+        vigra_assert(node_ids[old_id.at(node)] == g.id(node), "Error in DAGraph0::compact(): Wrong node id mapping.");
+
+        // The out arcs of each node are adjacent.
+        std::vector<int> out_ids;
+        for (OutArcIt ait(g, node); ait != lemon::INVALID; ++ait)
+            out_ids.push_back(g.id(*ait));
+        std::sort(out_ids.begin(), out_ids.end());
+        for (size_t k = 1; k < out_ids.size(); ++k)
+            vigra_assert(out_ids[k] == out_ids[k-1]+1, "Error in DAGraph0::compact(): The out arcs are not adjacent.");
+    }
+
+    // The free lists are empty.
+    Node const n = g.addNode();
+    vigra_assert(g.id(n) == static_cast<int>(num_nodes), "Error in DAGraph0::compact(): The free list is not empty.");
+}
+
+void test_compact()
+{
+    using namespace vigra;
+
+    {
+        typedef DAGraph0 Graph;
+        typedef Graph::Node Node;
+
+        Graph g;
+        std::vector<Node> n;
+        for (size_t i = 0; i < 9; ++i)
+            n.push_back(g.addNode());
+        g.addArc(n[7], n[3]);
+        g.addArc(n[7], n[5]);
+        g.addArc(n[3], n[1]);
+        g.addArc(n[5], n[1]);
+        g.addArc(n[1], n[0]);
+        g.addArc(n[5], n[6]);
+        g.addArc(n[2], n[4]);
+        g.addArc(n[2], n[8]);
+        g.erase(n[6]);
+        g.erase(n[0]);
+        g.erase(g.addArc(n[3], n[8]));
+        test_compact_graph(g);
+    }
+    {
+        typedef Forest1<DAGraph0> Forest;
+        typedef Forest::Node Node;
+
+        Forest g;
+        std::vector<Node> n;
+        for (size_t i = 0; i < 6; ++i)
+            n.push_back(g.addNode());
+        g.addArc(n[5], n[2]);
+        g.addArc(n[5], n[0]);
+        g.addArc(n[2], n[4]);
+        g.addArc(n[2], n[1]);
+        g.erase(n[3]);
+        g.erase(n[4]);
+        test_compact_graph(g);
+    }
+
+    std::cout << "test_compact(): Success!" << std::endl;
+}
+
+/// \brief Compare all queries of the reachability index with a DFS from each node.
+template <typename GRAPH>
+void test_reachability_queries(GRAPH const & g, vigra::ReachabilityIndex<GRAPH> const & index)
+{
+    using namespace vigra;
+
+    typedef typename GRAPH::Node Node;
+
+    std::vector<Node> nodes;
+    for (typename GRAPH::NodeIt it(g); it != lemon::INVALID; ++it)
+        nodes.push_back(Node(*it));
+    std::vector<std::vector<bool> > reached(g.maxNodeId()+1, std::vector<bool>(g.maxNodeId()+1, false));
+    for (Node const & n : nodes)
+    {
+        std::vector<Node> stack {n};
+        while (!stack.empty())
+        {
+            Node const x = stack.back();
+            stack.pop_back();
+            for (typename GRAPH::ChildIt it(g, x); it != lemon::INVALID; ++it)
+            {
+                Node const c(*it);
+                if (!reached[g.id(n)][g.id(c)])
+                {
+                    reached[g.id(n)][g.id(c)] = true;
+                    stack.push_back(c);
+                }
+            }
+        }
+    }
+
+    for (Node const & u : nodes)
+    {
+        std::vector<int> expected_descendants;
+        std::vector<int> expected_ancestors;
+        for (Node const & v : nodes)
+        {
+            bool const expected = reached[g.id(u)][g.id(v)];
+            vigra_assert(index.reachable(u, v) == (expected || u == v), "Error in ReachabilityIndex::reachable().");
+            vigra_assert(index.is_ancestor(u, v) == expected, "Error in ReachabilityIndex::is_ancestor().");
+            if (expected)
+                expected_descendants.push_back(g.id(v));
+            if (reached[g.id(v)][g.id(u)])
+                expected_ancestors.push_back(g.id(v));
+        }
+        std::vector<int> descendants;
+        for (Node const & v : index.descendants(u))
+            descendants.push_back(g.id(v));
+        std::vector<int> ancestors;
+        for (Node const & v : index.ancestors(u))
+            ancestors.push_back(g.id(v));
+        vigra_assert(equal_after_sort(descendants, expected_descendants), "Error in ReachabilityIndex::descendants().");
+        vigra_assert(equal_after_sort(ancestors, expected_ancestors), "Error in ReachabilityIndex::ancestors().");
+    }
+}
+
+void test_reachability()
+{
+    using namespace vigra;
+
+    typedef DAGraph0 Graph;
+    typedef Graph::Node Node;
+    typedef Forest1<Graph> Forest;
+
+    // Create random arcs from a node with larger index to one with smaller index.
+    size_t const num_nodes = 200;
+    std::vector<std::pair<Graph::index_type, Graph::index_type> > arcs;
+    size_t r = 1;
+    for (size_t j = 1; j < num_nodes; ++j)
+    {
+        for (size_t k = 0; k < 3; ++k)
+        {
+            r = (r * 1103515245 + 12345) % 2147483648;
+            if (r % 4 != 0)
+                arcs.push_back({j, (r/4) % j});
+        }
+    }
+    std::sort(arcs.begin(), arcs.end());
+    arcs.erase(std::unique(arcs.begin(), arcs.end()), arcs.end());
+
+    // Build the index on the complete graph.
+    {
+        Graph g;
+        for (size_t i = 0; i < num_nodes; ++i)
+            g.addNode();
+        for (auto const & a : arcs)
+            g.addArc(Node(a.first), Node(a.second));
+        ReachabilityIndex<Graph> index(g);
+        test_reachability_queries(g, index);
+    }
+
+    // Insert the arcs in random order, so the topological order must be repaired, and add new nodes.
+    {
+        std::vector<size_t> perm(arcs.size());
+        std::iota(perm.begin(), perm.end(), 0);
+        for (size_t i = perm.size(); i > 1; --i)
+        {
+            r = (r * 1103515245 + 12345) % 2147483648;
+            std::swap(perm[i-1], perm[(r/4) % i]);
+        }
+        Graph g;
+        for (size_t i = 0; i < num_nodes; ++i)
+            g.addNode();
+        ReachabilityIndex<Graph> index(g);
+        for (size_t i = 0; i < perm.size(); ++i)
+        {
+            auto const & a = arcs[perm[i]];
+            g.addArc(Node(a.first), Node(a.second));
+            index.insert_arc(Node(a.first), Node(a.second));
+            if (i == perm.size()/2)
+                test_reachability_queries(g, index);
+        }
+        Node const x = g.addNode();
+        Node const y = g.addNode();
+        g.addArc(Node(0), x);
+        index.insert_arc(Node(0), x);
+        g.addArc(y, Node(num_nodes-1));
+        index.insert_arc(y, Node(num_nodes-1));
+        test_reachability_queries(g, index);
+
+        // An arc that closes a cycle is detected.
+        g.addArc(x, y);
+        bool thrown = false;
+        try
+        {
+            index.insert_arc(x, y);
+        }
+        catch (PreconditionViolation const &)
+        {
+            thrown = true;
+        }
+        vigra_assert(thrown, "Error in ReachabilityIndex::insert_arc(): The cycle was not detected.");
+    }
+
+    // On a forest, the index is built the same way.
+    {
+        Forest f;
+        std::vector<Node> nodes;
+        for (size_t j = 0; j < num_nodes; ++j)
+        {
+            nodes.push_back(f.addNode());
+            r = (r * 1103515245 + 12345) % 2147483648;
+            if (j > 0 && r % 8 != 0)
+                f.addArc(nodes[(r/8) % j], nodes[j]);
+        }
+        ReachabilityIndex<Forest> index(f);
+        test_reachability_queries(f, index);
+    }
+
+    std::cout << "test_reachability(): Success!" << std::endl;
+}
+
 int main()
 {
     test_dagraph0();
+    test_static_dagraph0();
     test_forest1();
+    test_topological();
+    test_compact();
+    test_reachability();
 }
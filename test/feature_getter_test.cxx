@@ -120,6 +120,72 @@ void test_featuregetter()
         vigra_assert(feats == expected, "Error in SparseFeatureGetter::unsafe_insert().");
     }
 
+    // Test BinarySparseFeatureGetter.
+    {
+        BinarySparseFeatureGetter<int> features(Shape2(3, 4));
+        std::vector<UInt32> const row0 {1, 3};
+        std::vector<UInt32> const row1;
+        std::vector<UInt32> const row2 {0, 1, 2};
+        features.append_instance(row0.begin(), row0.end());
+        features.append_instance(row1.begin(), row1.end());
+        features.append_instance(row2.begin(), row2.end());
+        vigra_assert(features.num_instances() == 3 && features.count_nonzero() == 5 && features.count_nonzero(2) == 3,
+                     "Error in BinarySparseFeatureGetter::append_instance().");
+
+        std::vector<int> expected {
+            0, 1, 0, 1, 0, 0, 0, 0, 1, 1, 1, 0
+        };
+
+        std::vector<int> feats;
+        for (size_t i = 0; i < features.shape()[0]; ++i)
+        {
+            for (size_t j = 0; j < features.shape()[1]; ++j)
+            {
+                feats.push_back(features(i, j));
+            }
+        }
+        vigra_assert(feats == expected, "Error in BinarySparseFeatureGetter::operator().");
+
+        std::vector<std::pair<size_t, int> > res;
+        for (auto it = features.begin_instance_nonzero(2); it != features.end_instance_nonzero(2); ++it)
+        {
+            res.push_back(std::make_pair((*it).first, (*it).second));
+        }
+        std::vector<std::pair<size_t, int> > const expected_nonzero {
+            {0, 1}, {1, 1}, {2, 1}
+        };
+        vigra_assert(res == expected_nonzero, "Error in BinarySparseFeatureGetter::ConstNonZeroIter.");
+    }
+
+    // Test SparseColumnFeatureGetter.
+    {
+        MultiArray<2, int> feature_array(Shape2(3, 4));
+        feature_array(0, 1) = 5;
+        feature_array(0, 3) = 2;
+        feature_array(2, 1) = 7;
+        feature_array(2, 2) = 1;
+        SparseFeatureGetter<int> const sparse_features(feature_array);
+        SparseColumnFeatureGetter<int> const features(sparse_features);
+        SparseColumnFeatureGetter<int> const features_from_array(feature_array);
+        vigra_assert(features.shape() == feature_array.shape() && features.count_nonzero() == 4 &&
+                     features.count_nonzero(0) == 0 && features.count_nonzero(1) == 2,
+                     "Error in SparseColumnFeatureGetter(SparseFeatureGetter const &).");
+
+        for (size_t i = 0; i < features.shape()[0]; ++i)
+        {
+            for (size_t j = 0; j < features.shape()[1]; ++j)
+            {
+                vigra_assert(features(i, j) == feature_array(i, j) && features_from_array(i, j) == feature_array(i, j),
+                             "Error in SparseColumnFeatureGetter::operator().");
+            }
+        }
+
+        std::vector<size_t> const instances(features.begin_column_instances(1), features.end_column_instances(1));
+        std::vector<int> const values(features.begin_column_values(1), features.end_column_values(1));
+        vigra_assert(instances == std::vector<size_t>({0, 2}) && values == std::vector<int>({5, 7}),
+                     "Error in SparseColumnFeatureGetter column iterators.");
+    }
+
     std::cout << "test_featuregetter(): Success!" << std::endl;
 }
 
@@ -3,8 +3,10 @@
 #include <vigra/hdf5impex.hxx>
 #include <unordered_set>
 #include <chrono>
+#include <sstream>
 
 #include <vigra/randomforest.hxx>
+#include <vigra/randomforest_multiprocess.hxx>
 #include "data_utility.hxx"
 
 
@@ -126,6 +128,1041 @@ void test_randomforest0()
     std::cout << "test_randomforest0(): Success!" << std::endl;
 }
 
+/// \brief Fill x with uniform random features and y with the labels 3 and 8 (depending on the first feature), where the given fraction of labels is flipped.
+template <typename FEATURES, typename LABELS>
+void make_toy_data(size_t n, FEATURES & x, LABELS & y, double noise, vigra::MersenneTwister const & randengine)
+{
+    using namespace vigra;
+    x.reshape(Shape2(n, 4));
+    y.reshape(Shape1(n));
+    for (size_t i = 0; i < n; ++i)
+    {
+        for (size_t j = 0; j < 4; ++j)
+            x(i, j) = randengine.uniform();
+        bool c = x(i, 0) + 0.5*x(i, 1) > 0.75;
+        if (randengine.uniform() < noise)
+            c = !c;
+        y(i) = c ? 8 : 3;
+    }
+}
+
+/// \brief The types and the toy data that are shared by the random forest tests.
+namespace toy
+{
+
+typedef double FeatureType;
+typedef vigra::UInt8 LabelType;
+typedef vigra::FeatureGetter<FeatureType> Features;
+typedef vigra::LabelGetter<LabelType> Labels;
+typedef vigra::BootstrapSampler Sampler;
+typedef vigra::RandomForest0<FeatureType, LabelType> RandomForest;
+
+/// \brief Noisy training data and noise-free test data from make_toy_data(), drawn with a fixed seed.
+struct Data
+{
+    Data(double noise, size_t num_train = 500, size_t num_test = 500)
+        : randengine(42)
+    {
+        make_toy_data(num_train, train_x, train_y, noise, randengine);
+        make_toy_data(num_test, test_x, test_y, 0., randengine);
+    }
+
+    vigra::MersenneTwister randengine;
+    vigra::MultiArray<2, FeatureType> train_x, test_x;
+    vigra::MultiArray<1, LabelType> train_y, test_y;
+};
+
+}
+
+/// \brief Return the depth of the given tree.
+template <typename TREE>
+size_t tree_depth(TREE const & tree)
+{
+    typedef typename TREE::Graph::Node Node;
+    auto const & g = tree.get_graph();
+    std::vector<std::pair<Node, size_t> > stack {{g.getRoot(), 0}};
+    size_t depth = 0;
+    while (!stack.empty())
+    {
+        auto const p = stack.back();
+        stack.pop_back();
+        depth = std::max(depth, p.second);
+        for (size_t i = 0; i < g.outDegree(p.first); ++i)
+            stack.push_back({g.getChild(p.first, i), p.second+1});
+    }
+    return depth;
+}
+
+template <typename T>
+void test_radix_sort_type(vigra::MersenneTwister & randengine, double low, double high)
+{
+    using namespace vigra;
+    typedef detail::SplitBufferItem<T> Item;
+
+    for (size_t n : {10, 1000})
+    {
+        std::vector<Item> items, tmp;
+        for (size_t i = 0; i < n; ++i)
+        {
+            T const value = static_cast<T>(low + (high - low) * randengine.uniform());
+            items.push_back({detail::radix_key(value), value, i, 1.});
+        }
+        std::vector<Item> expected(items);
+        std::stable_sort(expected.begin(), expected.end(), [](Item const & a, Item const & b) { return a.value < b.value; });
+        detail::radix_sort(items, tmp);
+        for (size_t i = 0; i < n; ++i)
+        {
+            vigra_assert(items[i].value == expected[i].value && items[i].label == expected[i].label,
+                         "Error in radix_sort().");
+        }
+    }
+}
+
+void test_radix_sort()
+{
+    using namespace vigra;
+
+    MersenneTwister randengine(42);
+    test_radix_sort_type<float>(randengine, -1e3, 1e3);
+    test_radix_sort_type<double>(randengine, -1e-3, 1e-3);
+    test_radix_sort_type<Int32>(randengine, -1e3, 1e3);
+    test_radix_sort_type<UInt8>(randengine, 0, 200);
+
+    std::cout << "test_radix_sort(): Success!" << std::endl;
+}
+
+void test_termination()
+{
+    using namespace vigra;
+    using namespace toy;
+
+    typedef RandomSplit<GiniScorer> SplitFunctor;
+
+    Data data(0.2);
+    Features train_feats(data.train_x);
+    Labels train_labels(data.train_y);
+
+    // Grow full trees for comparison.
+    size_t full_leaves = 0;
+    {
+        RandomForest rf(data.randengine);
+        rf.train<Features, Labels, Sampler, PurityTermination, SplitFunctor>(train_feats, train_labels, 5);
+        for (auto const & tree : rf.trees())
+            full_leaves = std::max(full_leaves, tree.num_leaves());
+    }
+
+    // Test the maximum depth.
+    {
+        typedef CombinedTermination<PurityTermination, MaxDepthTermination> Termination;
+        RandomForest rf(data.randengine);
+        rf.train<Features, Labels, Sampler, Termination, SplitFunctor>(
+                    train_feats, train_labels, 5, -1, Sampler(), Termination(PurityTermination(), MaxDepthTermination(4)));
+        for (auto const & tree : rf.trees())
+            vigra_assert(tree_depth(tree) <= 4 && tree.num_leaves() <= 16, "Error in MaxDepthTermination.");
+    }
+
+    // Test the minimum leaf size.
+    {
+        typedef CombinedTermination<PurityTermination, MinSamplesTermination> Termination;
+        RandomForest rf(data.randengine);
+        rf.train<Features, Labels, Sampler, Termination, SplitFunctor>(
+                    train_feats, train_labels, 5, -1, Sampler(), Termination(PurityTermination(), MinSamplesTermination(20, 10)));
+        for (auto const & tree : rf.trees())
+            for (auto const & p : tree.instance_count())
+                vigra_assert(p.second >= 10, "Error in MinSamplesTermination.");
+    }
+
+    // Test the maximum number of leaves (best-first growth).
+    {
+        typedef CombinedTermination<PurityTermination, MaxLeavesTermination> Termination;
+        RandomForest rf(data.randengine);
+        rf.train<Features, Labels, Sampler, Termination, SplitFunctor>(
+                    train_feats, train_labels, 5, -1, Sampler(), Termination(PurityTermination(), MaxLeavesTermination(12)));
+        for (auto const & tree : rf.trees())
+            vigra_assert(tree.num_leaves() == 12 && tree.num_leaves() < full_leaves, "Error in MaxLeavesTermination.");
+
+        // The small forest should still be better than guessing.
+        MultiArray<1, LabelType> pred_y(data.test_y.shape());
+        Features test_feats(data.test_x);
+        rf.predict(test_feats, pred_y);
+        size_t count = 0;
+        for (size_t i = 0; i < data.test_y.size(); ++i)
+            if (pred_y[i] == data.test_y[i])
+                ++count;
+        vigra_assert(count > 0.8*data.test_y.size(), "Error in MaxLeavesTermination: Bad performance.");
+    }
+
+    // Test the minimum impurity decrease.
+    {
+        typedef CombinedTermination<PurityTermination, MinImpurityDecreaseTermination> Termination;
+        RandomForest rf(data.randengine);
+        rf.train<Features, Labels, Sampler, Termination, SplitFunctor>(
+                    train_feats, train_labels, 5, -1, Sampler(), Termination(PurityTermination(), MinImpurityDecreaseTermination(0.01)));
+        for (auto const & tree : rf.trees())
+            vigra_assert(tree.num_leaves() < full_leaves, "Error in MinImpurityDecreaseTermination.");
+    }
+
+    std::cout << "test_termination(): Success!" << std::endl;
+}
+
+/// \brief Sampler that uses every instance exactly once, so the grown trees do not depend on the random engine.
+class FullSampler : public vigra::BootstrapSampler
+{
+public:
+    template <typename RANDENGINE>
+    void bootstrap_sample(
+            size_t const num_instances,
+            RANDENGINE const &,
+            std::vector<size_t> & instances,
+            vigra::BootstrapWeights & instance_weights
+    ) const {
+        instances.resize(num_instances);
+        std::iota(instances.begin(), instances.end(), 0);
+        instance_weights.reset(num_instances);
+        for (size_t i = 0; i < num_instances; ++i)
+            instance_weights.push_back(i, 1);
+    }
+};
+
+template <typename SPLITFUNCTOR>
+void test_split_order_type()
+{
+    using namespace vigra;
+
+    typedef double FeatureType;
+    typedef UInt8 LabelType;
+    typedef FeatureGetter<FeatureType> Features;
+    typedef LabelGetter<LabelType> Labels;
+    typedef CombinedTermination<PurityTermination, MaxLeavesTermination> Termination;
+    typedef RandomForest0<FeatureType, LabelType> RandomForest;
+
+    // The root splits the data into a small node with a pure 10/10 split (impurity decrease 0.5)
+    // and a large node of 200 instances whose best split is impure (impurity decrease 0.065).
+    // Weighted with the node sizes, the split of the large node removes more impurity (13 > 10),
+    // so it must be the one that gets the third leaf.
+    size_t const num_small = 20;
+    size_t const num_large = 200;
+    MultiArray<2, FeatureType> train_x(Shape2(num_small+num_large, 1));
+    MultiArray<1, LabelType> train_y(num_small+num_large);
+    for (size_t i = 0; i < num_small; ++i)
+    {
+        train_x(i, 0) = i;
+        train_y(i) = (i < num_small/2) ? 0 : 1;
+    }
+    for (size_t i = 0; i < num_large; ++i)
+    {
+        bool const majority = (i*37) % 100 < 68;
+        train_x(num_small+i, 0) = 100 + i;
+        train_y(num_small+i) = ((i < num_large/2) == majority) ? 2 : 3;
+    }
+    Features train_feats(train_x);
+    Labels train_labels(train_y);
+
+    MersenneTwister randengine(42);
+    RandomForest rf(randengine);
+    rf.train<Features, Labels, FullSampler, Termination, SPLITFUNCTOR>(
+                train_feats, train_labels, 1, 1, FullSampler(), Termination(PurityTermination(), MaxLeavesTermination(3)));
+    auto const & tree = rf.trees()[0];
+    vigra_assert(tree.num_leaves() == 3, "Error in the split order: Wrong number of leaves.");
+    bool small_leaf = false;
+    for (auto const & p : tree.instance_count())
+        if (p.second == num_small)
+            small_leaf = true;
+    vigra_assert(small_leaf, "Error in the split order: The small pure split was chosen before the large split.");
+}
+
+void test_split_order()
+{
+    test_split_order_type<vigra::RandomSplit<vigra::GiniScorer> >();
+    test_split_order_type<vigra::LevelwiseSplit<vigra::GiniScorer> >();
+    std::cout << "test_split_order(): Success!" << std::endl;
+}
+
+void test_oob()
+{
+    using namespace vigra;
+    using namespace toy;
+
+    typedef RandomSplit<GiniScorer> SplitFunctor;
+
+    Data data(0.05);
+    Features train_feats(data.train_x);
+    Labels train_labels(data.train_y);
+
+    RandomForest rf(data.randengine);
+    rf.train<Features, Labels, Sampler, PurityTermination, SplitFunctor>(train_feats, train_labels, 32);
+
+    // Each tree leaves roughly a third of the instances out-of-bag.
+    for (auto const & tree : rf.trees())
+    {
+        size_t const num_oob = std::count(tree.oob_instances().begin(), tree.oob_instances().end(), true);
+        vigra_assert(num_oob > 100 && num_oob < 270, "Error in the out-of-bag bitset.");
+    }
+
+    // The out-of-bag error must not depend on the number of threads.
+    double const err = rf.oob_error(train_feats, train_labels, 1);
+    vigra_assert(err < 0.2, "The out-of-bag error is too large.");
+    vigra_assert(err == rf.oob_error(train_feats, train_labels, 4), "The out-of-bag error depends on the number of threads.");
+
+    // Only the features 0 and 1 carry information.
+    auto const gini = rf.gini_importance();
+    vigra_assert(gini.size() == 4, "Error in gini_importance().");
+    vigra_assert(std::min(gini[0], gini[1]) > std::max(gini[2], gini[3]), "Error in gini_importance().");
+
+    for (int num_threads : {1, 4})
+    {
+        std::vector<double> perm;
+        rf.permutation_importance(train_feats, train_labels, perm, num_threads);
+        vigra_assert(perm.size() == 4, "Error in permutation_importance().");
+        vigra_assert(std::min(perm[0], perm[1]) > std::max(perm[2], perm[3]), "Error in permutation_importance().");
+    }
+
+    std::cout << "test_oob(): Success!" << std::endl;
+}
+
+/// \brief Return the fraction of equal entries in a and b.
+template <typename ARR>
+double accuracy(ARR const & a, ARR const & b)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < a.size(); ++i)
+        if (a[i] == b[i])
+            ++count;
+    return count / static_cast<double>(a.size());
+}
+
+void test_incremental()
+{
+    using namespace vigra;
+
+    typedef double FeatureType;
+    typedef UInt8 LabelType;
+    typedef FeatureGetter<FeatureType> Features;
+    typedef LabelGetter<LabelType> Labels;
+    typedef BootstrapSampler Sampler;
+    typedef PurityTermination Termination;
+    typedef RandomSplit<GiniScorer> SplitFunctor;
+    typedef RandomForest0<FeatureType, LabelType> RandomForest;
+
+    MersenneTwister randengine(42);
+    MultiArray<2, FeatureType> train_x, new_x, test_x;
+    MultiArray<1, LabelType> train_y, new_y, test_y;
+    make_toy_data(300, train_x, train_y, 0.05, randengine);
+    make_toy_data(300, new_x, new_y, 0.05, randengine);
+    make_toy_data(300, test_x, test_y, 0., randengine);
+    Features train_feats(train_x), new_feats(new_x), test_feats(test_x);
+    Labels train_labels(train_y), new_labels(new_y);
+    MultiArray<1, LabelType> pred_y(test_y.shape());
+
+    // Add, replace and retire trees.
+    {
+        RandomForest rf(randengine);
+        rf.train<Features, Labels, Sampler, Termination, SplitFunctor>(train_feats, train_labels, 8);
+        auto const first_tree = rf.trees()[8-1].get_graph();
+        size_t const first_tree_nodes = first_tree.numNodes();
+
+        rf.add_trees<Features, Labels, Sampler, Termination, SplitFunctor>(new_feats, new_labels, 4);
+        vigra_assert(rf.num_trees() == 12 && rf.num_classes() == 2, "Error in add_trees().");
+        vigra_assert(rf.trees()[8-1].get_graph().numNodes() == first_tree_nodes, "add_trees() changed an existing tree.");
+
+        rf.replace_trees<Features, Labels, Sampler, Termination, SplitFunctor>(new_feats, new_labels, 4);
+        vigra_assert(rf.num_trees() == 12, "Error in replace_trees().");
+        vigra_assert(rf.trees()[8-1-4].get_graph().numNodes() == first_tree_nodes, "replace_trees() retired the wrong trees.");
+
+        rf.retire_trees(4);
+        vigra_assert(rf.num_trees() == 8, "Error in retire_trees().");
+        rf.predict(test_feats, pred_y);
+        vigra_assert(accuracy(pred_y, test_y) > 0.9, "Bad performance after retire_trees().");
+    }
+
+    // New labels are appended, so the label ids of the old trees stay valid.
+    {
+        RandomForest rf(randengine);
+        rf.train<Features, Labels, Sampler, Termination, SplitFunctor>(train_feats, train_labels, 8);
+        MultiArray<1, LabelType> extra_y(new_y);
+        for (size_t i = 0; i < extra_y.size(); i += 10)
+            extra_y[i] = 5;
+        Labels extra_labels(extra_y);
+        rf.add_trees<Features, Labels, Sampler, Termination, SplitFunctor>(new_feats, extra_labels, 2);
+        vigra_assert(rf.num_classes() == 3, "Error in add_trees(): Labels were not merged.");
+        rf.predict(test_feats, pred_y);
+        vigra_assert(accuracy(pred_y, test_y) > 0.9, "Bad performance after merging the labels.");
+    }
+
+    // The globally refined forest only refines the new trees.
+    {
+        RandomForest rf(randengine);
+        rf.train<Features, Labels, Sampler, Termination, SplitFunctor>(train_feats, train_labels, 8);
+        GloballyRefinedRandomForest<RandomForest> grf(rf);
+        grf.train(train_feats, train_labels);
+        grf.add_trees<Features, Labels, Sampler, Termination, SplitFunctor>(new_feats, new_labels, 4);
+        grf.retire_trees(4);
+        vigra_assert(rf.num_trees() == 8, "Error in GloballyRefinedRandomForest::retire_trees().");
+        grf.predict(test_feats, pred_y);
+        vigra_assert(accuracy(pred_y, test_y) > 0.75, "Bad performance of the incrementally refined forest.");
+
+        // After retiring the remaining old trees, the new block is the whole forest and gets its full weight back.
+        auto const new_weights = grf.leaf_weights().back();
+        grf.retire_trees(4);
+        vigra_assert(rf.num_trees() == 4, "Error in GloballyRefinedRandomForest::retire_trees().");
+        for (auto const & p : grf.leaf_weights().back())
+            vigra_assert(std::abs(p.second - 2.*new_weights.at(p.first)) < 1e-9, "Error in GloballyRefinedRandomForest::retire_trees(): Wrong rescaling.");
+    }
+
+    std::cout << "test_incremental(): Success!" << std::endl;
+}
+
+void test_levelwise()
+{
+    using namespace vigra;
+    using namespace toy;
+
+    typedef LevelwiseSplit<GiniScorer> SplitFunctor;
+
+    Data data(0.2);
+    Features train_feats(data.train_x);
+    Labels train_labels(data.train_y);
+    Features test_feats(data.test_x);
+    MultiArray<1, LabelType> pred_y(data.test_y.shape());
+
+    // Grow full trees: The leaves are pure and the result does not depend on the number of threads.
+    {
+        MersenneTwister randengine0(7);
+        MersenneTwister randengine1(7);
+        RandomForest rf0(randengine0);
+        RandomForest rf1(randengine1);
+        rf0.train<Features, Labels, Sampler, PurityTermination, SplitFunctor>(
+                    train_feats, train_labels, 5, 1, Sampler(), PurityTermination(), SplitFunctor(1));
+        rf1.train<Features, Labels, Sampler, PurityTermination, SplitFunctor>(
+                    train_feats, train_labels, 5, 1, Sampler(), PurityTermination(), SplitFunctor(4));
+        for (size_t t = 0; t < rf0.num_trees(); ++t)
+        {
+            vigra_assert(rf0.trees()[t].num_leaves() == rf1.trees()[t].num_leaves(), "Error in LevelwiseSplit: The result depends on the number of threads.");
+            for (auto const & p : rf0.trees()[t].label_probs())
+                vigra_assert(*std::max_element(p.second.begin(), p.second.end()) == 1., "Error in LevelwiseSplit: Impure leaf.");
+        }
+        rf0.predict(test_feats, pred_y);
+        vigra_assert(accuracy(pred_y, data.test_y) > 0.8, "Bad performance of the level-wise grown forest.");
+    }
+
+    // Test the maximum depth.
+    {
+        typedef CombinedTermination<PurityTermination, MaxDepthTermination> Termination;
+        RandomForest rf(data.randengine);
+        rf.train<Features, Labels, Sampler, Termination, SplitFunctor>(
+                    train_feats, train_labels, 5, -1, Sampler(), Termination(PurityTermination(), MaxDepthTermination(4)), SplitFunctor(2));
+        for (auto const & tree : rf.trees())
+            vigra_assert(tree_depth(tree) <= 4 && tree.num_leaves() <= 16, "Error in LevelwiseSplit with MaxDepthTermination.");
+    }
+
+    // Test the maximum number of leaves: The levels are filled one after another.
+    {
+        typedef CombinedTermination<PurityTermination, MaxLeavesTermination> Termination;
+        RandomForest rf(data.randengine);
+        rf.train<Features, Labels, Sampler, Termination, SplitFunctor>(
+                    train_feats, train_labels, 5, -1, Sampler(), Termination(PurityTermination(), MaxLeavesTermination(12)), SplitFunctor(2));
+        for (auto const & tree : rf.trees())
+            vigra_assert(tree.num_leaves() == 12 && tree_depth(tree) <= 4, "Error in LevelwiseSplit with MaxLeavesTermination.");
+        rf.predict(test_feats, pred_y);
+        vigra_assert(accuracy(pred_y, data.test_y) > 0.8, "Bad performance of the level-wise grown forest with MaxLeavesTermination.");
+    }
+
+    std::cout << "test_levelwise(): Success!" << std::endl;
+}
+
+void test_extratrees()
+{
+    using namespace vigra;
+    using namespace toy;
+
+    typedef ExtraTreesSplit<GiniScorer> SplitFunctor;
+
+    Data data(0.2);
+    Features train_feats(data.train_x);
+    Labels train_labels(data.train_y);
+    Features test_feats(data.test_x);
+    MultiArray<1, LabelType> pred_y(data.test_y.shape());
+
+    // Grow full trees with the default and with a configured number of candidate features.
+    for (size_t num_candidates : {0, 2})
+    {
+        RandomForest rf(data.randengine);
+        rf.train<Features, Labels, Sampler, PurityTermination, SplitFunctor>(
+                    train_feats, train_labels, 20, -1, Sampler(), PurityTermination(), SplitFunctor(num_candidates));
+        for (auto const & tree : rf.trees())
+            for (auto const & p : tree.label_probs())
+                vigra_assert(*std::max_element(p.second.begin(), p.second.end()) == 1., "Error in ExtraTreesSplit: Impure leaf.");
+        rf.predict(test_feats, pred_y);
+        vigra_assert(accuracy(pred_y, data.test_y) > 0.8, "Bad performance of the extremely randomized trees.");
+    }
+
+    // The minimum leaf size must be respected.
+    {
+        typedef CombinedTermination<PurityTermination, MinSamplesTermination> Termination;
+        RandomForest rf(data.randengine);
+        rf.train<Features, Labels, Sampler, Termination, SplitFunctor>(
+                    train_feats, train_labels, 5, -1, Sampler(), Termination(PurityTermination(), MinSamplesTermination(20, 10)));
+        for (auto const & tree : rf.trees())
+            for (auto const & p : tree.instance_count())
+                vigra_assert(p.second >= 10, "Error in ExtraTreesSplit with MinSamplesTermination.");
+    }
+
+    // Integer features: The thresholds are drawn from (min, max].
+    {
+        typedef ExtraTreesSplit<GiniScorer> Split;
+        MultiArray<2, UInt8> x(Shape2(4, 1));
+        MultiArray<1, UInt8> y(4);
+        for (size_t i = 0; i < 4; ++i)
+        {
+            x(i, 0) = 3 + (i % 2);
+            y(i) = i % 2;
+        }
+        std::vector<size_t> instances {0, 1, 2, 3};
+        std::vector<double> weights(4, 1.);
+        size_t feat;
+        UInt8 thresh;
+        std::vector<size_t>::iterator split_iter;
+        double impurity_decrease;
+        bool const found = Split().split(instances.begin(), instances.end(), x, y, weights, 2, data.randengine,
+                                         feat, thresh, split_iter, impurity_decrease);
+        vigra_assert(found && thresh == 4 && split_iter - instances.begin() == 2 && impurity_decrease > 0.49,
+                     "Error in ExtraTreesSplit with integer features.");
+    }
+
+    std::cout << "test_extratrees(): Success!" << std::endl;
+}
+
+void test_sparse()
+{
+    using namespace vigra;
+
+    typedef double FeatureType;
+    typedef UInt8 LabelType;
+    typedef FeatureGetter<FeatureType> Features;
+    typedef SparseColumnFeatureGetter<FeatureType> SparseFeatures;
+    typedef LabelGetter<LabelType> Labels;
+    typedef BootstrapSampler Sampler;
+    typedef RandomSplit<GiniScorer> SplitFunctor;
+    typedef RandomForest0<FeatureType, LabelType> RandomForest;
+
+    // Sparse data with small integer values, where the label depends on the first three features.
+    MersenneTwister randengine(42);
+    size_t const num_instances = 600;
+    size_t const num_features = 50;
+    MultiArray<2, FeatureType> x(Shape2(num_instances, num_features));
+    MultiArray<1, LabelType> y(num_instances);
+    for (size_t i = 0; i < num_instances; ++i)
+    {
+        for (size_t j = 0; j < num_features; ++j)
+            if (randengine.uniform() < ((j < 3) ? 0.5 : 0.1))
+                x(i, j) = 1 + randengine.uniformInt(5);
+        y(i) = (x(i, 0) + x(i, 1) > x(i, 2) + 2) ? 1 : 0;
+    }
+    Features dense_feats(x);
+    SparseFeatureGetter<FeatureType> const row_feats(x);
+    SparseFeatures sparse_feats(row_feats);
+    Labels labels(y);
+
+    // The sparse split search treats the zeros as one block and finds the same splits as the dense one.
+    MersenneTwister dense_randengine(7);
+    MersenneTwister sparse_randengine(7);
+    RandomForest dense_rf(dense_randengine);
+    RandomForest sparse_rf(sparse_randengine);
+    dense_rf.train<Features, Labels, Sampler, PurityTermination, SplitFunctor>(dense_feats, labels, 10);
+    sparse_rf.train<SparseFeatures, Labels, Sampler, PurityTermination, SplitFunctor>(sparse_feats, labels, 10);
+    for (size_t t = 0; t < dense_rf.trees().size(); ++t)
+    {
+        vigra_assert(dense_rf.trees()[t].num_leaves() == sparse_rf.trees()[t].num_leaves(),
+                     "Error in RandomSplit on sparse features: Different trees.");
+    }
+
+    // Predict on dense, sparse row and sparse column features.
+    MultiArray<1, LabelType> dense_pred(y.shape());
+    MultiArray<1, LabelType> row_pred(y.shape());
+    MultiArray<1, LabelType> column_pred(y.shape());
+    dense_rf.predict(dense_feats, dense_pred);
+    sparse_rf.predict(row_feats, row_pred);
+    sparse_rf.predict(sparse_feats, column_pred);
+    vigra_assert(accuracy(dense_pred, row_pred) == 1. && accuracy(dense_pred, column_pred) == 1.,
+                 "Error in RandomForest0::predict() on sparse features.");
+    vigra_assert(accuracy(column_pred, y) > 0.95, "Bad performance of the random forest on sparse features.");
+
+    std::cout << "test_sparse(): Success!" << std::endl;
+}
+
+void test_bootstrap_sampler()
+{
+    using namespace vigra;
+    using namespace toy;
+
+    typedef PurityTermination Termination;
+    typedef RandomSplit<GiniScorer> SplitFunctor;
+
+    Data data(0.05, 500, 300);
+    size_t const n = 1000;
+
+    // Create a named lambda that sums the weights and checks that exactly the in-bag instances have a weight.
+    auto weight_sum = [n](std::vector<size_t> const & instances, BootstrapWeights const & weights) {
+        vigra_assert(std::is_sorted(instances.begin(), instances.end()) && weights.num_inbag() == instances.size(),
+                     "Error in the bootstrap sample.");
+        std::vector<bool> inbag(n, false);
+        for (size_t i : instances)
+            inbag[i] = true;
+        double sum = 0.;
+        for (size_t i = 0; i < n; ++i)
+        {
+            vigra_assert((weights[i] > 0) == inbag[i], "Error in the bootstrap weights.");
+            sum += weights[i];
+        }
+        return sum;
+    };
+
+    // The multinomial sampler draws exactly ratio*n instances.
+    {
+        std::vector<size_t> instances;
+        BootstrapWeights weights;
+        Sampler(Sampler::Multinomial, 0.5).bootstrap_sample(n, data.randengine, instances, weights);
+        vigra_assert(weight_sum(instances, weights) == n/2, "Error in the multinomial sampler.");
+        vigra_assert(instances.size() > 0.35*n && instances.size() < 0.44*n, "Error in the multinomial sampler.");
+    }
+
+    // The Poisson sampler draws ratio*n instances in expectation.
+    {
+        std::vector<size_t> instances;
+        BootstrapWeights weights;
+        Sampler(Sampler::Poisson, 1.).bootstrap_sample(n, data.randengine, instances, weights);
+        double const sum = weight_sum(instances, weights);
+        vigra_assert(sum > 0.9*n && sum < 1.1*n, "Error in the Poisson sampler.");
+        vigra_assert(instances.size() > 0.55*n && instances.size() < 0.7*n, "Error in the Poisson sampler.");
+    }
+
+    // Negative sample weights are rejected.
+    {
+        bool thrown = false;
+        try
+        {
+            Sampler(Sampler::Multinomial, 1., std::vector<double>(n, -1.));
+        }
+        catch (PreconditionViolation const &)
+        {
+            thrown = true;
+        }
+        vigra_assert(thrown, "The bootstrap sampler accepted negative sample weights.");
+    }
+
+    // Instances with zero sample weight are never used in training.
+    Features train_feats(data.train_x), test_feats(data.test_x);
+    Labels train_labels(data.train_y);
+    std::vector<double> sample_weights(data.train_y.size(), 1.);
+    for (size_t i = 0; i < sample_weights.size(); i += 2)
+        sample_weights[i] = 0.;
+    for (auto mode : {Sampler::Multinomial, Sampler::Poisson})
+    {
+        RandomForest rf(data.randengine);
+        rf.train<Features, Labels, Sampler, Termination, SplitFunctor>(
+                    train_feats, train_labels, 10, -1, Sampler(mode, 1., sample_weights));
+        for (auto const & tree : rf.trees())
+            for (size_t i = 0; i < sample_weights.size(); i += 2)
+                vigra_assert(tree.is_oob(i), "An instance with zero weight was used in training.");
+
+        MultiArray<1, LabelType> pred_y(data.test_y.shape());
+        rf.predict(test_feats, pred_y);
+        vigra_assert(accuracy(pred_y, data.test_y) > 0.85, "Bad performance with the weighted bootstrap sampler.");
+    }
+
+    std::cout << "test_bootstrap_sampler(): Success!" << std::endl;
+}
+
+void test_quantized()
+{
+    using namespace vigra;
+    using namespace toy;
+
+    typedef PurityTermination Termination;
+    typedef RandomSplit<GiniScorer> SplitFunctor;
+
+    Data data(0.05);
+    Features train_feats(data.train_x), test_feats(data.test_x);
+    Labels train_labels(data.train_y);
+
+    RandomForest rf(data.randengine);
+    rf.train<Features, Labels, Sampler, Termination, SplitFunctor>(train_feats, train_labels, 10);
+    GloballyRefinedRandomForest<RandomForest> grf(rf);
+    grf.train(train_feats, train_labels);
+    MultiArray<1, LabelType> pred_y(data.test_y.shape());
+    grf.predict(test_feats, pred_y);
+
+    // The quantized models must (almost) agree with the refined forest.
+    MultiArray<1, LabelType> pred_q16(data.test_y.shape());
+    auto const q16 = grf.quantize<Int16>();
+    q16.predict(test_feats, pred_q16);
+    vigra_assert(accuracy(pred_q16, pred_y) > 0.99, "Error in the 16 bit quantized forest.");
+
+    MultiArray<1, LabelType> pred_q8(data.test_y.shape());
+    auto const q8 = grf.quantize<Int8>();
+    q8.predict(test_feats, pred_q8);
+    vigra_assert(accuracy(pred_q8, pred_y) > 0.97, "Error in the 8 bit quantized forest.");
+    vigra_assert(q8.num_trees() == rf.num_trees() && q8.memory_size() < q16.memory_size(), "Error in the 8 bit quantized forest.");
+
+    // The weights of an incrementally refined block have a different magnitude, so they share the common scale.
+    grf.add_trees<Features, Labels, Sampler, Termination, SplitFunctor>(train_feats, train_labels, 5);
+    grf.predict(test_feats, pred_y);
+    auto const q16_added = grf.quantize<Int16>();
+    q16_added.predict(test_feats, pred_q16);
+    vigra_assert(accuracy(pred_q16, pred_y) > 0.99, "Error in the 16 bit quantized forest with added trees.");
+
+    std::cout << "test_quantized(): Success!" << std::endl;
+}
+
+void test_merged()
+{
+    using namespace vigra;
+    using namespace toy;
+
+    typedef MaxDepthTermination Termination;
+    typedef RandomSplit<GiniScorer> SplitFunctor;
+
+    Data data(0.05);
+    Features train_feats(data.train_x), test_feats(data.test_x);
+    Labels train_labels(data.train_y);
+
+    RandomForest rf(data.randengine);
+    rf.train<Features, Labels, Sampler, Termination, SplitFunctor>(train_feats, train_labels, 10, -1, Sampler(), Termination(6));
+    auto const merged = rf.merge();
+    auto const & dag = merged.get_dag();
+
+    // The merged forest must give exactly the same predictions with less nodes.
+    MultiArray<1, LabelType> pred_rf(data.test_y.shape());
+    MultiArray<1, LabelType> pred_merged(data.test_y.shape());
+    rf.predict(test_feats, pred_rf);
+    merged.predict(test_feats, pred_merged);
+    vigra_assert(accuracy(pred_rf, pred_merged) == 1., "Error in the merged forest prediction.");
+    vigra_assert(dag.num_trees() == rf.num_trees(), "Error in the merged forest.");
+    vigra_assert(dag.num_nodes() < dag.num_tree_nodes(), "Error in the merged forest: No nodes were merged.");
+    for (size_t k = 0; k < dag.num_nodes(); ++k)
+    {
+        typedef MergedForest<FeatureType, LabelType>::Node Node;
+        Node const n(k);
+        vigra_assert(dag.is_leaf(n) || (dag.child(n, 0).id() < n.id() && dag.child(n, 1).id() < n.id()),
+                     "Error in the merged forest: The children must be created before their parents.");
+    }
+
+    // The leaves of the merged forest must have the labels and the probabilities of the original leaves.
+    MultiArray<2, size_t> rf_ids(Shape2(data.test_x.shape()[0], rf.num_trees()));
+    MultiArray<2, size_t> dag_ids(Shape2(data.test_x.shape()[0], rf.num_trees()));
+    rf.leaf_ids(data.test_x, rf_ids);
+    merged.leaf_ids(data.test_x, dag_ids);
+    for (size_t i = 0; i < rf_ids.shape()[0]; ++i)
+    {
+        for (size_t t = 0; t < rf.num_trees(); ++t)
+        {
+            typedef RandomForest::TreeNode TreeNode;
+            typedef MergedForest<FeatureType, LabelType>::Node Node;
+            size_t const label = rf.trees()[t].node_main_label().at(TreeNode(rf_ids(i, t)));
+            auto const & probs = rf.trees()[t].label_probs().at(TreeNode(rf_ids(i, t)));
+            vigra_assert(dag.is_leaf(Node(dag_ids(i, t))) && dag.leaf_value(Node(dag_ids(i, t))).first == label &&
+                         dag.leaf_value(Node(dag_ids(i, t))).second == probs,
+                         "Error in the merged forest leaf ids.");
+        }
+    }
+
+    // The merged forest must give the same probabilities as the single instance predictor.
+    {
+        auto const predictor = rf.predictor();
+        MultiArray<2, double> probs(Shape2(data.test_x.shape()[0], rf.num_classes()));
+        merged.predict_probabilities(test_feats, probs);
+        std::vector<FeatureType> row(data.test_x.shape()[1]);
+        std::vector<double> row_probs(rf.num_classes());
+        for (size_t i = 0; i < probs.shape()[0]; ++i)
+        {
+            for (size_t j = 0; j < row.size(); ++j)
+                row[j] = data.test_x(i, j);
+            predictor.predict_proba_one(row.data(), row_probs.data());
+            for (size_t k = 0; k < row_probs.size(); ++k)
+                vigra_assert(std::abs(probs(i, k) - row_probs[k]) < 1e-12, "Error in the merged forest probabilities.");
+        }
+    }
+
+    // The merged refined forest must give exactly the same predictions as the refined forest.
+    {
+        GloballyRefinedRandomForest<RandomForest> grf(rf);
+        grf.train(train_feats, train_labels);
+        auto const merged_refined = grf.merge();
+        MultiArray<1, LabelType> pred_grf(data.test_y.shape());
+        grf.predict(test_feats, pred_grf);
+        merged_refined.predict(test_feats, pred_merged);
+        vigra_assert(accuracy(pred_grf, pred_merged) == 1., "Error in the merged refined forest prediction.");
+        vigra_assert(merged_refined.num_trees() == rf.num_trees() &&
+                     merged_refined.get_dag().num_nodes() <= merged_refined.get_dag().num_tree_nodes(),
+                     "Error in the merged refined forest.");
+    }
+
+    std::cout << "test_merged(): Success!" << std::endl;
+}
+
+void test_jungle()
+{
+    using namespace vigra;
+    using namespace toy;
+
+    typedef CombinedTermination<PurityTermination, MaxDepthTermination> Termination;
+    typedef JungleSplit<GiniScorer> SplitFunctor;
+    typedef DecisionJungle0<FeatureType, size_t> Jungle;
+    typedef RandomForest0<FeatureType, LabelType, MersenneTwister, Jungle> JungleForest;
+
+    Data data(0.05);
+    Features train_feats(data.train_x), test_feats(data.test_x);
+    Labels train_labels(data.train_y);
+
+    size_t const max_width = 8;
+    size_t const max_depth = 12;
+    Termination const termination{PurityTermination(), MaxDepthTermination(max_depth)};
+
+    // The number of nodes is bounded by the width of each level.
+    MultiArray<1, size_t> label_ids(Shape1(data.train_y.size()));
+    for (size_t i = 0; i < data.train_y.size(); ++i)
+        label_ids(i) = (data.train_y(i) == 3) ? 0 : 1;
+    LabelGetter<size_t> train_label_ids(label_ids);
+    Jungle jungle(0);
+    jungle.set_num_labels(2);
+    jungle.train(train_feats, train_label_ids, Sampler(), termination, SplitFunctor(max_width));
+    vigra_assert(jungle.num_nodes() <= 1 + max_width * max_depth, "Error in the jungle: A level is too wide.");
+    vigra_assert(jungle.num_leaves() > 0 && jungle.num_leaves() < jungle.num_nodes(), "Error in the jungle leaves.");
+
+    // Some nodes must have more than one parent.
+    auto const & g = jungle.get_graph();
+    bool merged = false;
+    for (DAGraph0::NodeIt it(g); it != lemon::INVALID; ++it)
+    {
+        size_t num_parents = 0;
+        for (DAGraph0::ParentIt pit(g, *it); pit != lemon::INVALID; ++pit)
+            ++num_parents;
+        merged = merged || num_parents > 1;
+    }
+    vigra_assert(merged, "Error in the jungle: No nodes were merged.");
+
+    // The two children of a node must be different nodes.
+    for (DAGraph0::NodeIt it(g); it != lemon::INVALID; ++it)
+    {
+        std::vector<DAGraph0::Node> children;
+        for (DAGraph0::ChildIt cit(g, *it); cit != lemon::INVALID; ++cit)
+            children.push_back(*cit);
+        vigra_assert(children.empty() || (children.size() == 2 && children[0] != children[1]),
+                     "Error in the jungle: A node has two arcs to the same child.");
+    }
+
+    // Without a depth restriction the jungle must refuse to train.
+    {
+        Jungle unbounded(0);
+        unbounded.set_num_labels(2);
+        bool thrown = false;
+        try
+        {
+            unbounded.train(train_feats, train_label_ids, Sampler(), PurityTermination(), SplitFunctor(max_width));
+        }
+        catch (PreconditionViolation const &)
+        {
+            thrown = true;
+        }
+        vigra_assert(thrown, "Error in the jungle: Training without a depth restriction must fail.");
+    }
+
+    // A forest of jungles works with the usual forest api.
+    JungleForest jf(data.randengine);
+    jf.train<Features, Labels, Sampler, Termination, SplitFunctor>(train_feats, train_labels, 10, -1, Sampler(), termination, SplitFunctor(max_width));
+    MultiArray<1, LabelType> pred_y(data.test_y.shape());
+    jf.predict(test_feats, pred_y);
+    vigra_assert(accuracy(pred_y, data.test_y) > 0.9, "Error in the jungle forest prediction.");
+
+    MultiArray<2, size_t> ids(Shape2(data.test_x.shape()[0], jf.num_trees()));
+    jf.leaf_ids(data.test_x, ids);
+    for (size_t t = 0; t < jf.num_trees(); ++t)
+    {
+        Jungle const & j = jf.trees()[t];
+        for (size_t i = 0; i < ids.shape()[0]; ++i)
+            vigra_assert(j.get_graph().isLeafNode(Jungle::Node(ids(i, t))), "Error in the jungle leaf ids.");
+    }
+    vigra_assert(jf.oob_error(train_feats, train_labels) < 0.2, "Error in the jungle out-of-bag error.");
+
+    // The flat predictor shares the merged nodes and agrees with the jungle forest.
+    auto const predictor = jf.predictor();
+    size_t const num_features = data.test_x.shape()[1];
+    vigra_assert(predictor.num_features() == num_features, "Error in the jungle forest predictor.");
+    std::vector<FeatureType> row(num_features);
+    for (size_t i = 0; i < pred_y.size(); ++i)
+    {
+        for (size_t j = 0; j < num_features; ++j)
+            row[j] = data.test_x(i, j);
+        vigra_assert(predictor.predict_one(row.data()) == pred_y(i), "Error in the jungle forest predictor.");
+    }
+
+    // The merged forest visits the shared nodes of each jungle once and gives the same predictions.
+    auto const merged_jf = jf.merge();
+    MultiArray<1, LabelType> pred_merged(data.test_y.shape());
+    merged_jf.predict(test_feats, pred_merged);
+    vigra_assert(accuracy(pred_y, pred_merged) == 1., "Error in the merged jungle forest prediction.");
+    vigra_assert(merged_jf.get_dag().num_nodes() <= merged_jf.get_dag().num_tree_nodes(), "Error in the merged jungle forest.");
+
+    std::cout << "test_jungle(): Success!" << std::endl;
+}
+
+void test_predictor()
+{
+    using namespace vigra;
+    using namespace toy;
+
+    typedef MaxDepthTermination Termination;
+    typedef RandomSplit<GiniScorer> SplitFunctor;
+
+    Data data(0.05);
+
+    // Append a constant feature that is never used by a split, so the row stride differs from the used features.
+    size_t const num_instances = data.test_x.shape()[0];
+    size_t const num_features = data.test_x.shape()[1] + 1;
+    MultiArray<2, FeatureType> train_x(Shape2(data.train_x.shape()[0], num_features), 1.);
+    MultiArray<2, FeatureType> test_x(Shape2(num_instances, num_features), 1.);
+    for (size_t j = 0; j+1 < num_features; ++j)
+    {
+        train_x.bind<1>(j) = data.train_x.bind<1>(j);
+        test_x.bind<1>(j) = data.test_x.bind<1>(j);
+    }
+    Features train_feats(train_x), test_feats(test_x);
+    Labels train_labels(data.train_y);
+
+    // The predictor reads the instances row by row.
+    std::vector<FeatureType> rows(num_instances * num_features);
+    for (size_t i = 0; i < num_instances; ++i)
+        for (size_t j = 0; j < num_features; ++j)
+            rows[i*num_features + j] = test_x(i, j);
+
+    // The forest predictor must agree with the forest, also when it is shared by several threads.
+    RandomForest rf(data.randengine);
+    rf.train<Features, Labels, Sampler, Termination, SplitFunctor>(train_feats, train_labels, 10, -1, Sampler(), Termination(8));
+    auto const predictor = rf.predictor();
+    vigra_assert(predictor.num_features() == num_features && predictor.num_classes() == rf.num_classes(),
+                 "Error in the forest predictor.");
+    MultiArray<1, LabelType> pred_rf(data.test_y.shape());
+    MultiArray<1, LabelType> pred_one(data.test_y.shape());
+    rf.predict(test_feats, pred_rf);
+    detail::parallel_for(num_instances, 4,
+            [& predictor, & rows, & pred_one, num_features](size_t i)
+            {
+                pred_one(i) = predictor.predict_one(&rows[i*num_features]);
+            }
+    );
+    std::vector<LabelType> pred_batch(num_instances);
+    predictor.predict(rows.data(), num_instances, pred_batch.data());
+    vigra_assert(accuracy(pred_rf, pred_one) == 1., "Error in the forest predictor.");
+    for (size_t i = 0; i < num_instances; ++i)
+    {
+        vigra_assert(pred_batch[i] == pred_rf(i), "Error in the forest predictor batch prediction.");
+
+        // The probabilities are the mean of the leaf probabilities.
+        auto const feats = [& test_x, i](size_t j) { return test_x(i, j); };
+        std::vector<double> expected(rf.num_classes(), 0.);
+        for (auto const & tree : rf.trees())
+        {
+            auto const & leaf_probs = tree.label_probs().at(tree.leaf_node(feats));
+            for (size_t c = 0; c < leaf_probs.size(); ++c)
+                expected[c] += leaf_probs[c] / rf.num_trees();
+        }
+        std::vector<double> probs(rf.num_classes());
+        predictor.predict_proba_one(&rows[i*num_features], probs.data());
+        for (size_t c = 0; c < expected.size(); ++c)
+            vigra_assert(std::abs(probs[c] - expected[c]) < 1e-9, "Error in the forest predictor probabilities.");
+    }
+
+    // The refined forest predictor must agree with the refined forest.
+    GloballyRefinedRandomForest<RandomForest> grf(rf);
+    grf.train(train_feats, train_labels);
+    auto const refined_predictor = grf.predictor();
+    vigra_assert(refined_predictor.num_features() == num_features, "Error in the refined forest predictor.");
+    MultiArray<1, LabelType> pred_grf(data.test_y.shape());
+    grf.predict(test_feats, pred_grf);
+    std::vector<LabelType> pred_refined(num_instances);
+    std::vector<double> values(num_instances);
+    refined_predictor.predict(rows.data(), num_instances, pred_refined.data());
+    refined_predictor.decision_values(rows.data(), num_instances, values.data());
+    for (size_t i = 0; i < num_instances; ++i)
+    {
+        vigra_assert(pred_refined[i] == pred_grf(i), "Error in the refined forest predictor batch prediction.");
+        vigra_assert(refined_predictor.predict_one(&rows[i*num_features]) == pred_grf(i),
+                     "Error in the refined forest predictor.");
+        vigra_assert(std::abs(refined_predictor.decision_value_one(&rows[i*num_features]) - values[i]) < 1e-9,
+                     "Error in the refined forest predictor decision values.");
+    }
+
+    std::cout << "test_predictor(): Success!" << std::endl;
+}
+
+
+
+void test_multiprocess()
+{
+    using namespace vigra;
+    using namespace toy;
+
+    typedef MaxDepthTermination Termination;
+    typedef RandomSplit<GiniScorer> SplitFunctor;
+
+    Data data(0.05);
+    Features train_feats(data.train_x), test_feats(data.test_x);
+    Labels train_labels(data.train_y);
+
+    // Trees that were trained in worker processes must be the same as the trees of a single process.
+    MersenneTwister randengine_single(7);
+    MersenneTwister randengine_multi(7);
+    RandomForest rf_single(randengine_single);
+    RandomForest rf_multi(randengine_multi);
+    rf_single.train<Features, Labels, Sampler, Termination, SplitFunctor>(train_feats, train_labels, 10, -1, Sampler(), Termination(8));
+    add_trees_multiprocess<Features, Labels, Sampler, Termination, SplitFunctor>(rf_multi, train_feats, train_labels, 10, 3, Sampler(), Termination(8));
+    vigra_assert(rf_multi.num_trees() == rf_single.num_trees() && rf_multi.num_classes() == rf_single.num_classes(),
+                 "Error in the multiprocess training.");
+    MultiArray<2, size_t> ids_single(Shape2(data.test_x.shape()[0], rf_single.num_trees()));
+    MultiArray<2, size_t> ids_multi(Shape2(data.test_x.shape()[0], rf_multi.num_trees()));
+    rf_single.leaf_ids(data.test_x, ids_single);
+    rf_multi.leaf_ids(data.test_x, ids_multi);
+    for (size_t i = 0; i < ids_single.shape()[0]; ++i)
+        for (size_t t = 0; t < rf_single.num_trees(); ++t)
+            vigra_assert(ids_single(i, t) == ids_multi(i, t), "Error in the multiprocess training: The trees differ.");
+    MultiArray<1, LabelType> pred_single(data.test_y.shape());
+    MultiArray<1, LabelType> pred_multi(data.test_y.shape());
+    rf_single.predict(test_feats, pred_single);
+    rf_multi.predict(test_feats, pred_multi);
+    vigra_assert(accuracy(pred_single, pred_multi) == 1., "Error in the multiprocess training.");
+
+    // If the training fails, the forest must not be changed.
+    {
+        RandomForest rf_failed(randengine_multi);
+        bool thrown = false;
+        try
+        {
+            add_trees_multiprocess<Features, Labels, Sampler, Termination, SplitFunctor>(
+                    rf_failed, train_feats, train_labels, 2, 2, Sampler(), Termination(8), SplitFunctor(), "/nonexistent_directory");
+        }
+        catch (PreconditionViolation const &)
+        {
+            thrown = true;
+        }
+        vigra_assert(thrown && rf_failed.num_trees() == 0 && rf_failed.num_classes() == 0,
+                     "Error in the multiprocess training: A failed training changed the forest.");
+    }
+
+    // A serialized tree must be restored with the same node ids.
+    std::stringstream ss;
+    rf_single.trees()[0].serialize(ss);
+    RandomForest::Tree tree(0);
+    tree.deserialize(ss);
+    MultiArray<1, size_t> ids_restored(Shape1(data.test_x.shape()[0]));
+    tree.leaf_ids(data.test_x, ids_restored);
+    for (size_t i = 0; i < ids_restored.size(); ++i)
+        vigra_assert(ids_restored(i) == ids_single(i, 0), "Error in the tree serialization.");
+
+    std::cout << "test_multiprocess(): Success!" << std::endl;
+}
+
+
+
 void test_globallyrefinedrf()
 {
     using namespace vigra;
@@ -206,6 +1243,20 @@ void test_globallyrefinedrf()
 
 int main()
 {
+    test_radix_sort();
+    test_termination();
+    test_split_order();
+    test_oob();
+    test_incremental();
+    test_levelwise();
+    test_extratrees();
+    test_sparse();
+    test_bootstrap_sampler();
+    test_quantized();
+    test_merged();
+    test_jungle();
+    test_predictor();
+    test_multiprocess();
 //    test_randomforest0();
     test_globallyrefinedrf();
 }
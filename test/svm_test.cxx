@@ -201,8 +201,301 @@ void test_clustered_svm()
 }
 
 
+void test_svm_prediction()
+{
+    using namespace vigra;
+
+    typedef double FeatureType;
+    typedef UInt8 LabelType;
+    typedef TwoClassSVM<FeatureType, LabelType> SVM;
+
+    // Create sparse random data with a linear decision boundary.
+    size_t const num_instances = 1000;
+    size_t const num_features = 10;
+    MersenneTwister randengine(42);
+    MultiArray<2, FeatureType> x(Shape2(num_instances, num_features));
+    MultiArray<1, LabelType> y(num_instances);
+    for (size_t i = 0; i < num_instances; ++i)
+    {
+        for (size_t j = 0; j < num_features; ++j)
+            x(i, j) = (randengine.uniform() < 0.3) ? randengine.uniform() : 0.;
+        y(i) = (x(i, 0) + x(i, 1) - x(i, 2) > 0.2) ? 4 : 2;
+    }
+
+    // The decision values of the dense SVM must be the dot product with the normalized features.
+    SVM svm;
+    svm.train(x, y);
+    MultiArray<1, double> values(num_instances);
+    MultiArray<1, double> values_mt(num_instances);
+    MultiArray<1, LabelType> pred_y(num_instances);
+    svm.decision_values(x, values, 1);
+    svm.decision_values(x, values_mt, 4);
+    svm.predict(x, pred_y, 4);
+    size_t count = 0;
+    for (size_t i = 0; i < num_instances; ++i)
+    {
+        double v = svm.options().bias_value_ * svm.beta()(num_features);
+        for (size_t j = 0; j < num_features; ++j)
+            v += (x(i, j) - svm.mean()[j]) / svm.std_dev()[j] * svm.beta()(j);
+        vigra_assert(std::abs(values(i) - v) < 1e-9, "Error in the SVM decision values.");
+        vigra_assert(values(i) == values_mt(i), "Error in the multithreaded SVM decision values.");
+        vigra_assert(pred_y(i) == svm.distinct_labels()[(v >= 0) ? 0 : 1], "Error in the SVM prediction.");
+        if (pred_y(i) == y(i))
+            ++count;
+    }
+    vigra_assert(count > 0.9 * num_instances, "Bad performance of the SVM.");
+
+    // The single instance predictor must give the same decision values.
+    auto const predictor = svm.predictor();
+    std::vector<FeatureType> rows(num_instances * num_features);
+    for (size_t i = 0; i < num_instances; ++i)
+        for (size_t j = 0; j < num_features; ++j)
+            rows[i*num_features + j] = x(i, j);
+    std::vector<LabelType> pred_batch(num_instances);
+    predictor.predict(rows.data(), num_instances, pred_batch.data());
+    for (size_t i = 0; i < num_instances; ++i)
+    {
+        FeatureType const * row = &rows[i*num_features];
+        vigra_assert(std::abs(predictor.decision_value_one(row) - values(i)) < 1e-9, "Error in the SVM predictor decision values.");
+        vigra_assert(predictor.predict_one(row) == pred_y(i) && pred_batch[i] == pred_y(i), "Error in the SVM predictor.");
+    }
+
+    // The sparse SVM without normalization only uses the weights of the non-zero features.
+    SVM::Options opt;
+    opt.normalize_ = false;
+    SVM sparse_svm(opt);
+    SparseFeatureGetter<FeatureType> sparse_x(x);
+    sparse_svm.train(sparse_x, y);
+    MultiArray<1, LabelType> sparse_pred_y(num_instances);
+    sparse_svm.decision_values(sparse_x, values, 4);
+    sparse_svm.predict(sparse_x, sparse_pred_y, 4);
+    for (size_t i = 0; i < num_instances; ++i)
+    {
+        double v = 0.;
+        for (size_t j = 0; j < num_features; ++j)
+            v += x(i, j) * sparse_svm.beta()(j);
+        vigra_assert(std::abs(values(i) - v) < 1e-9, "Error in the sparse SVM decision values.");
+        vigra_assert(sparse_pred_y(i) == sparse_svm.distinct_labels()[(v >= 0) ? 0 : 1], "Error in the sparse SVM prediction.");
+    }
+
+    std::cout << "test_svm_prediction(): Success!" << std::endl;
+}
+
+void test_multiclass_svm()
+{
+    using namespace vigra;
+
+    typedef double FeatureType;
+    typedef UInt8 LabelType;
+    typedef MultiClassSVM<FeatureType, LabelType> SVM;
+
+    // Create data with three classes that are separated by the largest of the first three features.
+    size_t const num_instances = 900;
+    size_t const num_features = 6;
+    MersenneTwister randengine(42);
+    MultiArray<2, FeatureType> x(Shape2(num_instances, num_features));
+    MultiArray<1, LabelType> y(num_instances);
+    for (size_t i = 0; i < num_instances; ++i)
+    {
+        for (size_t j = 0; j < num_features; ++j)
+            x(i, j) = (randengine.uniform() < 0.5) ? randengine.uniform() : 0.;
+        size_t k = 0;
+        for (size_t j = 1; j < 3; ++j)
+            if (x(i, j) > x(i, k))
+                k = j;
+        x(i, k) += 0.5;
+        y(i) = 3 + 2*k;
+    }
+
+    // The result must not depend on the number of threads.
+    MersenneTwister randengine_mt(7);
+    MersenneTwister randengine_st(7);
+    SVM svm_mt(SVM::Options(), randengine_mt);
+    SVM svm_st(SVM::Options(), randengine_st);
+    svm_mt.train(x, y, 4);
+    svm_st.train(x, y, 1);
+    vigra_assert(svm_mt.num_classes() == 3, "Error in the multiclass SVM labels.");
+    for (size_t k = 0; k < 3; ++k)
+        for (size_t j = 0; j <= num_features; ++j)
+            vigra_assert(svm_mt.beta()(k, j) == svm_st.beta()(k, j), "Error in the multithreaded multiclass SVM training.");
+
+    // The decision values are the dot products with the normalized features.
+    MultiArray<2, double> values(Shape2(num_instances, 3));
+    MultiArray<1, LabelType> pred_y(num_instances);
+    svm_mt.decision_values(x, values, 4);
+    svm_mt.predict(x, pred_y, 4);
+    size_t count = 0;
+    for (size_t i = 0; i < num_instances; ++i)
+    {
+        if (pred_y(i) == y(i))
+            ++count;
+        size_t max_k = 0;
+        for (size_t k = 0; k < 3; ++k)
+        {
+            double v = svm_mt.options().bias_value_ * svm_mt.beta()(k, num_features);
+            for (size_t j = 0; j < num_features; ++j)
+                v += (x(i, j) - svm_mt.mean()[j]) / svm_mt.std_dev()[j] * svm_mt.beta()(k, j);
+            vigra_assert(std::abs(values(i, k) - v) < 1e-9, "Error in the multiclass SVM decision values.");
+            if (values(i, k) > values(i, max_k))
+                max_k = k;
+        }
+        vigra_assert(pred_y(i) == svm_mt.distinct_labels()[max_k], "Error in the multiclass SVM prediction.");
+    }
+    vigra_assert(count > 0.9 * num_instances, "Bad performance of the multiclass SVM.");
+
+    // The sparse features must give the same decision values.
+    SparseFeatureGetter<FeatureType> sparse_x(x);
+    MultiArray<2, double> sparse_values(Shape2(num_instances, 3));
+    svm_mt.decision_values(sparse_x, sparse_values, 4);
+    for (size_t i = 0; i < num_instances; ++i)
+        for (size_t k = 0; k < 3; ++k)
+            vigra_assert(std::abs(values(i, k) - sparse_values(i, k)) < 1e-9, "Error in the sparse multiclass SVM decision values.");
+
+    std::cout << "test_multiclass_svm(): Success!" << std::endl;
+}
+
+void test_binary_svm()
+{
+    using namespace vigra;
+
+    typedef UInt8 FeatureType;
+    typedef UInt8 LabelType;
+    typedef TwoClassSVM<FeatureType, LabelType> SVM;
+
+    // Create leaf-like binary data: Each instance has one active feature in each of 5 groups with 8 features.
+    size_t const num_instances = 500;
+    size_t const num_groups = 5;
+    size_t const group_size = 8;
+    MersenneTwister randengine(42);
+    SparseFeatureGetter<FeatureType> sparse_x(Shape2(num_instances, num_groups*group_size));
+    BinarySparseFeatureGetter<FeatureType> binary_x(Shape2(num_instances, num_groups*group_size));
+    MultiArray<1, LabelType> y(num_instances);
+    for (size_t i = 0; i < num_instances; ++i)
+    {
+        std::vector<UInt32> indices;
+        for (size_t g = 0; g < num_groups; ++g)
+        {
+            indices.push_back(g*group_size + randengine.uniformInt(group_size));
+            sparse_x.unsafe_insert(i, indices.back(), 1);
+        }
+        binary_x.append_instance(indices.begin(), indices.end());
+        y(i) = (indices[0] % 2 == 0 || indices[1] % group_size < 2) ? 1 : 0;
+    }
+
+    // The binary features must give the same SVM as the general sparse features.
+    SVM::Options opt;
+    opt.normalize_ = false;
+    opt.bias_value_ = 0.;
+    MersenneTwister randengine_sparse(7);
+    MersenneTwister randengine_binary(7);
+    SVM svm_sparse(opt, randengine_sparse);
+    SVM svm_binary(opt, randengine_binary);
+    svm_sparse.train(sparse_x, y);
+    svm_binary.train(binary_x, y);
+    for (size_t j = 0; j < svm_sparse.beta().size(); ++j)
+        vigra_assert(std::abs(svm_sparse.beta()(j) - svm_binary.beta()(j)) < 1e-12, "Error in the binary SVM training.");
+
+    MultiArray<1, double> sparse_values(num_instances);
+    MultiArray<1, double> binary_values(num_instances);
+    MultiArray<1, LabelType> pred_y(num_instances);
+    svm_sparse.decision_values(sparse_x, sparse_values, 1);
+    svm_binary.decision_values(binary_x, binary_values, 4);
+    svm_binary.predict(binary_x, pred_y, 4);
+    size_t count = 0;
+    for (size_t i = 0; i < num_instances; ++i)
+    {
+        vigra_assert(std::abs(sparse_values(i) - binary_values(i)) < 1e-9, "Error in the binary SVM decision values.");
+        if (pred_y(i) == y(i))
+            ++count;
+    }
+    vigra_assert(count > 0.9 * num_instances, "Bad performance of the binary SVM.");
+
+    std::cout << "test_binary_svm(): Success!" << std::endl;
+}
+
+void test_parallel_svm()
+{
+    using namespace vigra;
+
+    typedef UInt8 FeatureType;
+    typedef UInt8 LabelType;
+    typedef TwoClassSVM<FeatureType, LabelType> SVM;
+
+    // Create leaf-like binary data with few conflicts between the instances.
+    size_t const num_instances = 4000;
+    size_t const num_groups = 10;
+    size_t const group_size = 64;
+    MersenneTwister randengine(42);
+    BinarySparseFeatureGetter<FeatureType> x(Shape2(num_instances, num_groups*group_size));
+    MultiArray<1, LabelType> y(num_instances);
+    for (size_t i = 0; i < num_instances; ++i)
+    {
+        std::vector<UInt32> indices;
+        for (size_t g = 0; g < num_groups; ++g)
+            indices.push_back(g*group_size + randengine.uniformInt(group_size));
+        x.append_instance(indices.begin(), indices.end());
+        y(i) = (indices[0] % 2 == 0 || indices[1] % group_size < 16) ? 1 : 0;
+    }
+
+    // Train with one and with four threads.
+    SVM::Options opt;
+    opt.normalize_ = false;
+    opt.bias_value_ = 0.;
+    MersenneTwister randengine_st(7);
+    MersenneTwister randengine_mt(7);
+    SVM svm_st(opt, randengine_st);
+    opt.num_threads_ = 4;
+    SVM svm_mt(opt, randengine_mt);
+    svm_st.train(x, y);
+    svm_mt.train(x, y);
+
+    // After the final pass, beta must belong to alpha.
+    MultiArray<1, int> binary_labels(num_instances);
+    svm_mt.transform_external_labels(y, binary_labels);
+    std::vector<double> beta(svm_mt.beta().size(), 0.);
+    for (size_t i = 0; i < num_instances; ++i)
+        for (auto it = x.begin_instance_indices(i); it != x.end_instance_indices(i); ++it)
+            beta[*it] += svm_mt.alpha()(i) * binary_labels(i);
+    for (size_t j = 0; j < beta.size(); ++j)
+        vigra_assert(std::abs(beta[j] - svm_mt.beta()(j)) < 1e-9, "Error in the parallel SVM: Inconsistent beta.");
+
+    // Both solvers must reach almost the same dual objective and predictions.
+    auto const dual_objective = [](SVM const & svm)
+    {
+        double v = 0.;
+        for (auto a : svm.alpha())
+            v += a;
+        for (auto b : svm.beta())
+            v -= 0.5*b*b;
+        return v;
+    };
+    double const obj_st = dual_objective(svm_st);
+    double const obj_mt = dual_objective(svm_mt);
+    vigra_assert(std::abs(obj_st - obj_mt) < 1e-3 * std::abs(obj_st), "Error in the parallel SVM: Different objective.");
+
+    MultiArray<1, LabelType> pred_st(num_instances);
+    MultiArray<1, LabelType> pred_mt(num_instances);
+    svm_st.predict(x, pred_st);
+    svm_mt.predict(x, pred_mt);
+    size_t count = 0;
+    for (size_t i = 0; i < num_instances; ++i)
+    {
+        if (pred_st(i) == pred_mt(i))
+            ++count;
+    }
+    vigra_assert(count > 0.99 * num_instances, "Error in the parallel SVM: Different predictions.");
+
+    std::cout << "test_parallel_svm(): Success!" << std::endl;
+}
+
+
+
 int main()
 {
+    test_svm_prediction();
+    test_multiclass_svm();
+    test_binary_svm();
+    test_parallel_svm();
     test_svm();
     test_sparse_svm();
 //    test_clustered_svm();